@@ -19,27 +19,93 @@
 #include "ui_inventory.h"
 #include "cloud_llm.h"
 #include "cloud_asr.h"
+#include "cmd_trace.h"
 
 #include "esp_task_wdt.h"
+#include <stdatomic.h>
+#include <stdio.h>
 
 static const char *TAG = "app_sr";
 
 // Audio recording buffer for Cloud ASR
-#define RECORD_TIME_SEC 3
+// 录音长度由 VAD 端点检测决定：说完后静音 RECORD_SILENCE_END_MS 即结束，最长 RECORD_MAX_MS；
+// 开始录音后 RECORD_NO_SPEECH_MS 内一直没有说话也结束
+#define RECORD_MAX_MS 6000
+#define RECORD_SILENCE_END_MS 700
+#define RECORD_NO_SPEECH_MS 3000
+#define RECORD_PREROLL_MS 500       // 命令词识别前的音频，拼在录音开头，避免紧接命令词说出的前几个字被截掉
 #define RECORD_SAMPLE_RATE 16000
-#define RECORD_BUFFER_SIZE (RECORD_TIME_SEC * RECORD_SAMPLE_RATE * sizeof(int16_t))
-static int16_t *g_record_buffer = NULL;
-static int g_record_offset = 0;
-static bool g_is_recording = false;
-static volatile bool g_is_processing = false;
+#define RECORD_MS_TO_BYTES(ms) ((ms) * (RECORD_SAMPLE_RATE / 1000) * sizeof(int16_t))
+#define RECORD_PREROLL_SIZE RECORD_MS_TO_BYTES(RECORD_PREROLL_MS)
+#define RECORD_BUFFER_SIZE (RECORD_PREROLL_SIZE + RECORD_MS_TO_BYTES(RECORD_MAX_MS))
+#define RECORD_POOL_SIZE 2          // 录音缓冲池，app_sr_init 一次性分配，命令触发录音时不再 malloc
+#define RECORD_BYTES_TO_MS(b) ((int)((b) * 1000LL / (RECORD_SAMPLE_RATE * sizeof(int16_t))))
+#define RECORD_RING_SLOTS 4         // SPSC 指针环槽数，2 的幂且不小于 RECORD_POOL_SIZE
+
+// 一次录音。detect_Task（唯一生产者）追加 PCM 后以 release 语义发布 len，结束时置 done；
+// process_audio_task（唯一消费者）以 acquire 语义读取，只访问 [0, len) 的数据，边录边上传
+typedef struct {
+    int16_t *buf;               // RECORD_BUFFER_SIZE 字节，app_sr_init 时分配
+    atomic_int len;             // 已写入字节数
+    atomic_bool done;           // 录音结束，len 不再变化
+    llm_action_t action;
+    uint32_t trace_id;          // 该命令的 cmd_trace，识别完成后由 process_audio_task 结束
+} capture_t;
+
+// 无锁单生产者/单消费者指针环：head 只由生产者写，tail 只由消费者写
+typedef struct {
+    void *slot[RECORD_RING_SLOTS];
+    atomic_uint head;
+    atomic_uint tail;
+} sr_ring_t;
+
+static capture_t s_captures[RECORD_POOL_SIZE];
+static sr_ring_t s_capture_jobs;    // detect_Task -> process_audio_task：待识别的录音（按录音顺序）
+static sr_ring_t s_capture_free;    // process_audio_task -> detect_Task：识别完归还的录音缓冲
+static atomic_int s_captures_inflight;  // 已开始录音、尚未识别完的数量
+static capture_t *s_capture = NULL;     // 正在录音的 capture，仅 detect_Task 使用
+static uint32_t s_trace = 0;            // 正在等待/执行的命令的 trace，仅 detect_Task 使用；开始录音后交给 capture
 static TaskHandle_t s_process_task_handle = NULL;
-static llm_action_t g_current_action = LLM_ACTION_ADD;
+
+// 流水线统计（每项只有一个写者），每次识别完成后打印；I2S 接收溢出由 bsp_get_feed_overflows() 提供
+static struct {
+    atomic_uint fed;            // feed_Task 送入 AFE 的采样数（每通道）
+    atomic_uint fetched;        // detect_Task 取出的采样数
+    atomic_int lag_max;         // fed - fetched 的峰值（采样）。AFE 内部环形缓冲只有 afe_ringbuf_size 帧，
+                                // 积压超过它或持续增长说明 detect_Task 跟不上，AFE 在丢数据
+    atomic_uint no_buffer;      // 录音缓冲池已空而丢掉的录音命令数
+    atomic_uint truncated;      // 录音缓冲已满而被截断的录音数
+    atomic_int capture_max;     // 单次录音最大字节数
+    atomic_int inflight_max;    // 同时占用的录音缓冲数峰值
+} s_stats;
+
+#define SAMPLES_TO_MS(n) ((int)((n) * 1000LL / RECORD_SAMPLE_RATE))
+
+// 前端状态机，由 detect_Task 推进（PROCESSING -> IDLE 由 process_audio_task 完成最后一个识别时推进）：
+//   IDLE --唤醒词--> LISTENING --录音命令--> CAPTURING --端点--> PROCESSING/IDLE
+//   LISTENING --其它命令/超时--> IDLE 或 PROCESSING（仍有录音在识别）
+//   PROCESSING --唤醒词--> LISTENING：云端识别上一句的同时即可唤醒并录下一句
+static _Atomic sr_state_t s_sr_state = SR_STATE_IDLE;
+
+// VAD 端点检测状态（仅 detect_Task 使用），record_start 时清零
+typedef struct {
+    int speech_ms;      // 累计说话时长
+    int silence_ms;     // 当前连续静音时长
+    int total_ms;
+} record_endpoint_t;
+static record_endpoint_t s_endpoint;
+
+// 预录环形缓冲：空闲/等待命令词时 detect_Task 持续写入最近 RECORD_PREROLL_MS 的 AFE 输出，
+// record_start 时按时间顺序拷到录音缓冲开头。读写都在 detect_Task 中，无需加锁
+static uint8_t *s_preroll = NULL;
+static size_t s_preroll_pos = 0;    // 下一次写入位置
+static bool s_preroll_full = false; // 已绕回，整个缓冲都是有效数据
+static llm_action_t g_current_action = LLM_ACTION_ADD; // 最近一次录音命令的动作（“测试云端”沿用）
 
 srmodel_list_t *models = NULL;
 static esp_afe_sr_iface_t *afe_handle = NULL;
 static esp_afe_sr_data_t *afe_data = NULL;
 
-int detect_flag = 0;
 static volatile int task_flag = 0;
 
 // Background task to run cloud recipe recommendation without blocking AFE/multinet loop
@@ -50,32 +116,329 @@ static void llm_recipe_task(void *arg)
     vTaskDelete(NULL);
 }
 
+static bool sr_ring_push(sr_ring_t *r, void *p)
+{
+    unsigned head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+    if (head - tail == RECORD_RING_SLOTS) return false;
+    r->slot[head % RECORD_RING_SLOTS] = p;
+    atomic_store_explicit(&r->head, head + 1, memory_order_release);
+    return true;
+}
+
+static void *sr_ring_pop(sr_ring_t *r)
+{
+    unsigned tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&r->head, memory_order_acquire);
+    if (head == tail) return NULL;
+    void *p = r->slot[tail % RECORD_RING_SLOTS];
+    atomic_store_explicit(&r->tail, tail + 1, memory_order_release);
+    return p;
+}
+
+sr_state_t app_sr_get_state(void)
+{
+    return atomic_load(&s_sr_state);
+}
+
+// 回到等待唤醒：还有录音在识别时为 PROCESSING，否则 IDLE。
+// 先写 PROCESSING 再检查计数，与 process_audio_task 的“减计数后 CAS”配合，不会停在 PROCESSING
+static void sr_enter_wait_state(void)
+{
+    atomic_store(&s_sr_state, SR_STATE_PROCESSING);
+    if (atomic_load(&s_captures_inflight) == 0) {
+        sr_state_t expected = SR_STATE_PROCESSING;
+        atomic_compare_exchange_strong(&s_sr_state, &expected, SR_STATE_IDLE);
+    }
+}
+
+// 录音期间把 detect_Task 新写入的 PCM 推给流式连接；连接失败或中途出错时返回的 stream 为 NULL，
+// 录音结束后改走整段上传
+static cloud_asr_stream_t *stream_recording(capture_t *cap, cloud_asr_stream_t *stream)
+{
+    int sent = 0;
+    bool done;
+    do {
+        done = atomic_load_explicit(&cap->done, memory_order_acquire); // 先读 done 再读 len：结束后 len 不再变化
+        int avail = atomic_load_explicit(&cap->len, memory_order_acquire);
+        if (stream && avail > sent) {
+            if (cloud_asr_stream_write(stream, (const int16_t *)((const char *)cap->buf + sent), avail - sent) != 0) {
+                ESP_LOGW(TAG, "ASR stream broken, falling back to one-shot upload");
+                cloud_asr_stream_abort(stream);
+                stream = NULL;
+            }
+            sent = avail;
+        }
+        if (!done) ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100)); // detect_Task 每写入一帧通知一次
+    } while (!done);
+    return stream;
+}
+
 void process_audio_task(void *arg) {
     while(1) {
-        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
-        
+        capture_t *cap = sr_ring_pop(&s_capture_jobs);
+        if (!cap) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+
         // Do the heavy lifting
-        if (g_record_buffer) {
-             char *text = cloud_asr_send_audio(g_record_buffer, g_record_offset);
-             if (text) {
-                 ESP_LOGI(TAG, "ASR: %s", text);
-                 cloud_llm_parse_inventory(text, g_current_action);
-                 ui_inventory_refresh();
-                 // 根据当前动作播放对应提示音
-                 if (g_current_action == LLM_ACTION_ADD) {
-                     ui_play_prompt_add();
-                 } else if (g_current_action == LLM_ACTION_REMOVE) {
-                     ui_play_prompt_remove();
-                 }
-                 free(text);
-             }
-             free(g_record_buffer);
-             g_record_buffer = NULL;
+        // 录音一开始就建立连接，说话的同时上传，说完只需等服务端出结果
+        uint32_t tr = cap->trace_id;
+        cmd_trace_bind(tr); // 库存写入等阶段记到这条 trace
+        cmd_trace_span_begin(tr, CMD_TRACE_ASR_CONNECT);
+        cloud_asr_stream_t *stream = cloud_asr_stream_begin();
+        cmd_trace_span_end(tr, CMD_TRACE_ASR_CONNECT);
+        stream = stream_recording(cap, stream);
+        cmd_trace_span_begin(tr, CMD_TRACE_ASR);
+        char *text = stream ? cloud_asr_stream_finish(stream) : NULL;
+        if (!text) { // 流式失败（含 finish 阶段出错）时录音还在缓冲里，整段重发一次
+            if (stream) ESP_LOGW(TAG, "ASR stream finish failed, retrying with one-shot upload");
+            text = cloud_asr_send_audio(cap->buf, atomic_load(&cap->len));
+        }
+        cmd_trace_span_end(tr, CMD_TRACE_ASR);
+        if (text) {
+            ESP_LOGI(TAG, "ASR: %s", text);
+            cmd_trace_span_begin(tr, CMD_TRACE_LLM);
+            cloud_llm_parse_inventory(text, cap->action);
+            cmd_trace_span_end(tr, CMD_TRACE_LLM);
+            cmd_trace_span_begin(tr, CMD_TRACE_UI);
+            ui_inventory_refresh();
+            cmd_trace_span_end(tr, CMD_TRACE_UI);
+            // 根据当前动作播放对应提示音
+            cmd_trace_span_begin(tr, CMD_TRACE_PROMPT);
+            if (cap->action == LLM_ACTION_ADD) {
+                ui_play_prompt_add();
+            } else if (cap->action == LLM_ACTION_REMOVE) {
+                ui_play_prompt_remove();
+            }
+            cmd_trace_span_end(tr, CMD_TRACE_PROMPT);
+            free(text);
         }
-        
-        // Done
-        g_is_processing = false;
+        cmd_trace_end(tr);
+        unsigned fed = atomic_load(&s_stats.fed), fetched = atomic_load(&s_stats.fetched);
+        ESP_LOGI(TAG, "pipeline: fed=%dms afe_lag=%dms afe_lag_max=%dms i2s_overflows=%u no_buffer=%u truncated=%u "
+                 "capture_max=%dms buffers_max=%d/%d",
+                 SAMPLES_TO_MS(fed), SAMPLES_TO_MS((int)(fed - fetched)), SAMPLES_TO_MS(atomic_load(&s_stats.lag_max)),
+                 (unsigned)bsp_get_feed_overflows(), atomic_load(&s_stats.no_buffer), atomic_load(&s_stats.truncated),
+                 RECORD_BYTES_TO_MS(atomic_load(&s_stats.capture_max)),
+                 atomic_load(&s_stats.inflight_max), RECORD_POOL_SIZE);
+
+        // Done：归还缓冲；最后一个识别完成且前端仍在等待唤醒时回到 IDLE
+        sr_ring_push(&s_capture_free, cap);
+        if (atomic_fetch_sub(&s_captures_inflight, 1) == 1) {
+            sr_state_t expected = SR_STATE_PROCESSING;
+            atomic_compare_exchange_strong(&s_sr_state, &expected, SR_STATE_IDLE);
+        }
+    }
+}
+
+// 按 AFE 的 vad_state 逐帧更新端点状态；应结束录音时返回原因，否则返回 NULL
+static const char *record_endpoint_update(record_endpoint_t *ep, afe_vad_state_t vad, int frame_ms)
+{
+    ep->total_ms += frame_ms;
+    if (vad == AFE_VAD_SPEECH) {
+        ep->speech_ms += frame_ms;
+        ep->silence_ms = 0;
+    } else {
+        ep->silence_ms += frame_ms;
+    }
+    if (ep->speech_ms > 0 && ep->silence_ms >= RECORD_SILENCE_END_MS) return "end of speech";
+    if (ep->speech_ms == 0 && ep->total_ms >= RECORD_NO_SPEECH_MS) return "no speech";
+    if (ep->total_ms >= RECORD_MAX_MS) return "max length";
+    return NULL;
+}
+
+static void preroll_push(const void *data, size_t len)
+{
+    if (!s_preroll) return;
+    const uint8_t *p = data;
+    if (len >= RECORD_PREROLL_SIZE) {
+        p += len - RECORD_PREROLL_SIZE;
+        len = RECORD_PREROLL_SIZE;
+    }
+    size_t first = RECORD_PREROLL_SIZE - s_preroll_pos;
+    if (first > len) first = len;
+    memcpy(s_preroll + s_preroll_pos, p, first);
+    memcpy(s_preroll, p + first, len - first);
+    s_preroll_pos += len;
+    if (s_preroll_pos >= RECORD_PREROLL_SIZE) {
+        s_preroll_pos -= RECORD_PREROLL_SIZE;
+        s_preroll_full = true;
+    }
+}
+
+// 按时间顺序（最旧在前）取出预录数据并清空缓冲，返回字节数
+static size_t preroll_take(uint8_t *dst)
+{
+    if (!s_preroll) return 0;
+    size_t n = 0;
+    if (s_preroll_full) {
+        n = RECORD_PREROLL_SIZE - s_preroll_pos;
+        memcpy(dst, s_preroll + s_preroll_pos, n);
+    }
+    memcpy(dst + n, s_preroll, s_preroll_pos);
+    n += s_preroll_pos;
+    s_preroll_pos = 0;
+    s_preroll_full = false;
+    return n;
+}
+
+// 命令词触发录音：从缓冲池取一块缓冲，交给 process_audio_task 立即建立 ASR 连接
+static bool record_start(llm_action_t action)
+{
+    capture_t *cap = sr_ring_pop(&s_capture_free);
+    if (!cap) {
+        printf("No free record buffer!\n");
+        atomic_fetch_add(&s_stats.no_buffer, 1);
+        return false;
+    }
+    cap->action = action;
+    cap->trace_id = s_trace;
+    s_trace = 0;
+    cmd_trace_span_begin(cap->trace_id, CMD_TRACE_CAPTURE);
+    atomic_store_explicit(&cap->done, false, memory_order_relaxed);
+    atomic_store_explicit(&cap->len, (int)preroll_take((uint8_t *)cap->buf), memory_order_relaxed);
+    memset(&s_endpoint, 0, sizeof(s_endpoint));
+    s_capture = cap;
+    int inflight = atomic_fetch_add(&s_captures_inflight, 1) + 1;
+    if (inflight > atomic_load(&s_stats.inflight_max)) atomic_store(&s_stats.inflight_max, inflight);
+    atomic_store(&s_sr_state, SR_STATE_CAPTURING);
+    sr_ring_push(&s_capture_jobs, cap); // 槽数不小于缓冲数，不会满
+    xTaskNotifyGive(s_process_task_handle);
+    printf("Recording... Speak now!\n");
+    return true;
+}
+
+// 追加一帧 AFE 输出并更新端点；录音应结束时返回原因，否则返回 NULL
+static const char *record_append(capture_t *cap, const afe_fetch_result_t *res)
+{
+    int bytes = res->data_size; // data_size is in bytes
+    int len = atomic_load_explicit(&cap->len, memory_order_relaxed);
+    if (len + bytes > (int)RECORD_BUFFER_SIZE) {
+        atomic_fetch_add(&s_stats.truncated, 1);
+        return "buffer full";
+    }
+    memcpy((char *)cap->buf + len, res->data, bytes);
+    atomic_store_explicit(&cap->len, len + bytes, memory_order_release);
+    if (len + bytes > atomic_load(&s_stats.capture_max)) atomic_store(&s_stats.capture_max, len + bytes);
+    return record_endpoint_update(&s_endpoint, res->vad_state, RECORD_BYTES_TO_MS(bytes));
+}
+
+// ---- 命令词分发表 ----------------------------------------------------------
+// 新增命令只需写一个处理函数并在 s_commands 中登记一行
+
+// 处理完命令后的去向
+typedef enum {
+    SR_CMD_LISTEN,      // 继续等待下一条命令词
+    SR_CMD_IDLE,        // 回到等待唤醒
+    SR_CMD_CAPTURE,     // 已开始录音，录音结束后回到等待唤醒
+} sr_cmd_next_t;
+
+typedef struct {
+    int id;
+    const char *phrase;     // multinet 拼音
+    sr_cmd_next_t (*handler)(void);
+} sr_command_t;
+
+static sr_cmd_next_t cmd_record(llm_action_t action, const char *label)
+{
+    printf("Starting Voice Recording for Cloud ASR%s...\n", label);
+    g_current_action = action;
+    return record_start(action) ? SR_CMD_CAPTURE : SR_CMD_LISTEN;
+}
+
+static sr_cmd_next_t cmd_test_cloud(void)
+{
+    // 测试云端：沿用上一次的动作
+    return cmd_record(g_current_action, "");
+}
+
+static sr_cmd_next_t cmd_put_in(void)
+{
+    return cmd_record(LLM_ACTION_ADD, " (ADD)");
+}
+
+static sr_cmd_next_t cmd_take_out(void)
+{
+    return cmd_record(LLM_ACTION_REMOVE, " (REMOVE)");
+}
+
+static sr_cmd_next_t cmd_show_inventory(void)
+{
+    printf("Showing Inventory...\n");
+    inventory_print_all();
+    ui_inventory_refresh();
+    ui_play_prompt_show();
+    return SR_CMD_IDLE;
+}
+
+static sr_cmd_next_t cmd_clear(void)
+{
+    printf("Clearing Inventory...\n");
+    inventory_clear_all();
+    ui_inventory_refresh();
+    return SR_CMD_IDLE;
+}
+
+static sr_cmd_next_t cmd_recipe(void)
+{
+    printf("Recommending Recipes...\n");
+    // Run recipe recommendation in background to avoid blocking
+    // the AFE/multinet detection loop and causing rb_out slow.
+    xTaskCreatePinnedToCore(llm_recipe_task, "llm_recipe", 8*1024, NULL, 5, NULL, 1);
+    return SR_CMD_IDLE;
+}
+
+static sr_cmd_next_t cmd_back(void)
+{
+    printf("Return to home screen...\n");
+    // 回到初始界面：当前设计为库存列表
+    ui_inventory_refresh();
+    return SR_CMD_IDLE;
+}
+
+static sr_cmd_next_t cmd_volume_up(void)
+{
+    printf("Volume up...\n");
+    ai_volume_up();
+    return SR_CMD_LISTEN;
+}
+
+static sr_cmd_next_t cmd_volume_down(void)
+{
+    printf("Volume down...\n");
+    ai_volume_down();
+    return SR_CMD_LISTEN;
+}
+
+static const sr_command_t s_commands[] = {
+    {1, "ce shi yun duan",        cmd_test_cloud},     // 测试云端 (Test Cloud)
+    {2, "fang ru",                cmd_put_in},         // 放入
+    {3, "na chu",                 cmd_take_out},       // 拿出
+    {4, "xian shi ku cun",        cmd_show_inventory}, // 显示库存
+    {5, "qing kong",              cmd_clear},          // 清空
+    {6, "cai pu tui jian",        cmd_recipe},         // 菜谱推荐
+    {7, "fan hui",                cmd_back},           // 返回
+    {8, "sheng yin da yi dian",   cmd_volume_up},      // 声音大一点
+    {9, "sheng yin xiao yi dian", cmd_volume_down},    // 声音小一点
+};
+
+static const sr_command_t *sr_command_find(int id)
+{
+    for (size_t i = 0; i < sizeof(s_commands) / sizeof(s_commands[0]); i++) {
+        if (s_commands[i].id == id) return &s_commands[i];
     }
+    return NULL;
+}
+
+// 重新打开唤醒词识别，回到等待唤醒
+static void sr_back_to_idle(esp_afe_sr_data_t *afe_data)
+{
+    afe_handle->enable_wakenet(afe_data);
+    sr_enter_wait_state();
+    ai_gui_out(); // AI人退出
+    printf("\n-----------awaits to be waken up-----------\n");
 }
 
 void feed_Task(void *arg)
@@ -90,8 +453,8 @@ void feed_Task(void *arg)
 
     while (task_flag) {
         bsp_get_feed_data(false, i2s_buff, audio_chunksize * sizeof(int16_t) * feed_channel);  // 获取I2S数据
-
         afe_handle->feed(afe_data, i2s_buff); // 把获取到的I2S数据输入给afe_data
+        atomic_fetch_add(&s_stats.fed, audio_chunksize);
     }
     if (i2s_buff) {
         free(i2s_buff);
@@ -109,15 +472,9 @@ void detect_Task(void *arg)
     esp_mn_iface_t *multinet = esp_mn_handle_from_name(mn_name);
     model_iface_data_t *model_data = multinet->create(mn_name, 6000);  // 设置唤醒后等待事件 6000代表6000毫秒
     esp_mn_commands_clear(); // 清除当前的命令词列表
-    esp_mn_commands_add(1, "ce shi yun duan"); // 测试云端 (Test Cloud)
-    esp_mn_commands_add(2, "fang ru"); // 放入 (Trigger for demo)
-    esp_mn_commands_add(3, "na chu"); // 拿出
-    esp_mn_commands_add(4, "xian shi ku cun"); // 显示库存
-    esp_mn_commands_add(5, "qing kong"); // 清空
-    esp_mn_commands_add(6, "cai pu tui jian"); // 菜谱推荐
-    esp_mn_commands_add(7, "fan hui"); // 返回
-    esp_mn_commands_add(8, "sheng yin da yi dian");   // 声音大一点
-    esp_mn_commands_add(9, "sheng yin xiao yi dian"); // 声音小一点
+    for (size_t i = 0; i < sizeof(s_commands) / sizeof(s_commands[0]); i++) {
+        esp_mn_commands_add(s_commands[i].id, s_commands[i].phrase);
+    }
     esp_mn_commands_update(); // 更新命令词
     int mu_chunksize = multinet->get_samp_chunksize(model_data);  // 获取samp帧长度
     assert(mu_chunksize == afe_chunksize);
@@ -126,46 +483,35 @@ void detect_Task(void *arg)
     multinet->print_active_speech_commands(model_data);
     printf("------------detect start------------\n");
 
-    bool was_processing = false;
     while (task_flag) {
         afe_fetch_result_t* res = afe_handle->fetch(afe_data); // 获取模型输出结果
         if (!res || res->ret_value == ESP_FAIL) {
             printf("fetch error!\n");
             break;
         }
+        unsigned fetched = atomic_fetch_add(&s_stats.fetched, afe_chunksize) + afe_chunksize;
+        int lag = (int)(atomic_load(&s_stats.fed) - fetched);
+        if (lag > atomic_load(&s_stats.lag_max)) atomic_store(&s_stats.lag_max, lag);
 
         // Handle Recording Logic
-        if (g_is_recording) {
-            if (g_record_buffer && res->data) {
-                int chunk_bytes = res->data_size; // data_size is in bytes
-                if (g_record_offset + chunk_bytes < RECORD_BUFFER_SIZE) {
-                    memcpy((char*)g_record_buffer + g_record_offset, res->data, chunk_bytes);
-                    g_record_offset += chunk_bytes;
-                } else {
-                    // Buffer full, stop recording and process
-                    printf("Recording finished (buffer full). Processing...\n");
-                    g_is_recording = false;
-                    g_is_processing = true;
-                    was_processing = true;
-                    xTaskNotifyGive(s_process_task_handle);
+        if (atomic_load(&s_sr_state) == SR_STATE_CAPTURING) {
+            if (res->data) {
+                const char *stop = record_append(s_capture, res);
+                if (stop) {
+                    // 端点检测到说完（或达到上限），交给 process_audio_task 发送结尾并取结果，前端立即回到等待唤醒
+                    printf("Recording finished (%s, %d ms). Processing...\n", stop,
+                           RECORD_BYTES_TO_MS(atomic_load(&s_capture->len)));
+                    cmd_trace_span_end(s_capture->trace_id, CMD_TRACE_CAPTURE);
+                    atomic_store_explicit(&s_capture->done, true, memory_order_release);
+                    s_capture = NULL;
+                    sr_back_to_idle(afe_data);
                 }
+                xTaskNotifyGive(s_process_task_handle); // 新数据可上传 / 录音结束
             }
             continue; // Skip multinet detection while recording
         }
 
-        if (g_is_processing) {
-             // Just drain the buffer to prevent "rb_out slow"
-             continue;
-        }
-        
-        if (was_processing) {
-             // Transition from Processing -> Idle
-             was_processing = false;
-             afe_handle->enable_wakenet(afe_data);
-             detect_flag = 0;
-             ai_gui_out();
-             printf("-----------awaits to be waken up-----------\n");
-        }
+        if (res->data) preroll_push(res->data, res->data_size);
 
         if (res->wakeup_state == WAKENET_DETECTED) {
             printf("WAKEWORD DETECTED\n");
@@ -173,12 +519,15 @@ void detect_Task(void *arg)
         } else if (res->wakeup_state == WAKENET_CHANNEL_VERIFIED) {  // 检测到唤醒词
             // play_voice = -1;
             afe_handle->disable_wakenet(afe_data);  // 关闭唤醒词识别
-            detect_flag = 1; // 标记已检测到唤醒词
+            atomic_store(&s_sr_state, SR_STATE_LISTENING); // 标记已检测到唤醒词
+            cmd_trace_discard(s_trace);
+            s_trace = cmd_trace_begin();
+            cmd_trace_span_begin(s_trace, CMD_TRACE_COMMAND);
             ai_gui_in(); // AI人出现
             printf("AFE_FETCH_CHANNEL_VERIFIED, channel index: %d\n", res->trigger_channel_id);
         }
 
-        if (detect_flag == 1) {
+        if (atomic_load(&s_sr_state) == SR_STATE_LISTENING) {
             esp_mn_state_t mn_state = multinet->detect(model_data, res->data); // 检测命令词
 
             if (mn_state == ESP_MN_STATE_DETECTING) {
@@ -192,104 +541,23 @@ void detect_Task(void *arg)
                     i+1, mn_result->command_id[i], mn_result->phrase_id[i], mn_result->string, mn_result->prob[i]);
                 }
                 // 根据命令词 执行相应动作
-                switch (mn_result->command_id[0])
-                {
-                    case 1: // ce shi yun duan
-                        printf("Starting Voice Recording for Cloud ASR...\n");
-                        // Allocate buffer
-                        g_record_buffer = heap_caps_malloc(RECORD_BUFFER_SIZE, MALLOC_CAP_SPIRAM);
-                        if (g_record_buffer) {
-                            g_record_offset = 0;
-                            g_is_recording = true;
-                            printf("Recording... Speak now!\n");
-                        } else {
-                            printf("Failed to allocate record buffer!\n");
-                        }
-                        break;
-                    case 2: // fang ru
-                        printf("Starting Voice Recording for Cloud ASR (ADD)...\n");
-                        g_current_action = LLM_ACTION_ADD;
-                        // Allocate buffer
-                        g_record_buffer = heap_caps_malloc(RECORD_BUFFER_SIZE, MALLOC_CAP_SPIRAM);
-                        if (g_record_buffer) {
-                            g_record_offset = 0;
-                            g_is_recording = true;
-                            printf("Recording... Speak now!\n");
-                        } else {
-                            printf("Failed to allocate record buffer!\n");
-                        }
-                        break;
-                    case 3: // na chu
-                        printf("Starting Voice Recording for Cloud ASR (REMOVE)...\n");
-                        g_current_action = LLM_ACTION_REMOVE;
-                        // Allocate buffer
-                        g_record_buffer = heap_caps_malloc(RECORD_BUFFER_SIZE, MALLOC_CAP_SPIRAM);
-                        if (g_record_buffer) {
-                            g_record_offset = 0;
-                            g_is_recording = true;
-                            printf("Recording... Speak now!\n");
-                        } else {
-                            printf("Failed to allocate record buffer!\n");
-                        }
-                        break;
-                    case 4: // xian shi ku cun
-                        printf("Showing Inventory...\n");
-                        inventory_print_all();
-                        ui_inventory_refresh();
-                        ui_play_prompt_show();
-                        // Reset state to idle
-                        afe_handle->enable_wakenet(afe_data);
-                        detect_flag = 0;
-                        ai_gui_out();
-                        printf("\n-----------awaits to be waken up-----------\n");
-                        continue;
-                    case 5: // qing kong
-                        printf("Clearing Inventory...\n");
-                        inventory_clear_all();
-                        ui_inventory_refresh();
-                        // Reset state to idle
-                        afe_handle->enable_wakenet(afe_data);
-                        detect_flag = 0;
-                        ai_gui_out();
-                        printf("\n-----------awaits to be waken up-----------\n");
-                        continue;
-
-                    case 6: // cai pu tui jian
-                        printf("Recommending Recipes...\n");
-                        // Run recipe recommendation in background to avoid blocking
-                        // the AFE/multinet detection loop and causing rb_out slow.
-                        xTaskCreatePinnedToCore(llm_recipe_task, "llm_recipe", 8*1024, NULL, 5, NULL, 1);
-                        // Reset state to idle
-                        afe_handle->enable_wakenet(afe_data);
-                        detect_flag = 0;
-                        ai_gui_out();
-                        printf("\n-----------awaits to be waken up-----------\n");
-                        continue;
-
-                    case 7: // fan hui
-                        printf("Return to home screen...\n");
-                        // 回到初始界面：当前设计为库存列表
-                        ui_inventory_refresh();
-                        // Reset state to idle
-                        afe_handle->enable_wakenet(afe_data);
-                        detect_flag = 0;
-                        ai_gui_out();
-                        printf("\n-----------awaits to be waken up-----------\n");
-                        continue;
-
-                    case 8: // sheng yin da yi dian
-                        printf("Volume up...\\n");
-                        ai_volume_up();
-                        break;
-
-                    case 9: // sheng yin xiao yi dian
-                        printf("Volume down...\\n");
-                        ai_volume_down();
-                        break;
-
-                    default:
-                        break;
+                cmd_trace_span_end(s_trace, CMD_TRACE_COMMAND);
+                cmd_trace_set_command(s_trace, mn_result->command_id[0]);
+                const sr_command_t *cmd = sr_command_find(mn_result->command_id[0]);
+                cmd_trace_bind(s_trace);
+                sr_cmd_next_t next = cmd ? cmd->handler() : SR_CMD_LISTEN;
+                cmd_trace_bind(0);
+                if (next != SR_CMD_CAPTURE) {
+                    // 录音命令的 trace 已交给 capture，其余命令到此结束；继续等待命令词时开始下一条
+                    cmd_trace_end(s_trace);
+                    s_trace = next == SR_CMD_LISTEN ? cmd_trace_begin() : 0;
+                    cmd_trace_span_begin(s_trace, CMD_TRACE_COMMAND);
+                }
+                if (next == SR_CMD_IDLE) {
+                    sr_back_to_idle(afe_data);
+                    continue;
                 }
+                if (next == SR_CMD_CAPTURE) continue;
                 printf("\n-----------listening-----------\n");
             }
 
@@ -301,10 +569,9 @@ void detect_Task(void *arg)
                 } else {
                     printf("timeout, no valid command detected\n");
                 }
-                afe_handle->enable_wakenet(afe_data);  // 重新打开唤醒词识别
-                detect_flag = 0; // 清除标记
-                printf("\n-----------awaits to be waken up-----------\n");
-                ai_gui_out(); // AI人退出
+                cmd_trace_discard(s_trace);
+                s_trace = 0;
+                sr_back_to_idle(afe_data);
                 continue;
             }
         }
@@ -325,9 +592,22 @@ void app_sr_init(void)
     afe_config_t afe_config = AFE_CONFIG_DEFAULT(); // 配置afe
 
     afe_config.wakenet_model_name = esp_srmodel_filter(models, ESP_WN_PREFIX, NULL); // 配置唤醒模型 必须在create_from_config之前配置
+    afe_config.vad_init = true; // 录音端点检测依赖 fetch 结果中的 vad_state
     afe_data = afe_handle->create_from_config(&afe_config); // 创建afe_data
     ESP_LOGI(TAG, "wakenet:%s", afe_config.wakenet_model_name); // 打印唤醒名称
 
+    // 录音缓冲池：开机时一次性分配，之后录音不再申请内存（避免 PSRAM 碎片导致录音失败）
+    for (int i = 0; i < RECORD_POOL_SIZE; i++) {
+        s_captures[i].buf = heap_caps_malloc(RECORD_BUFFER_SIZE, MALLOC_CAP_SPIRAM);
+        if (!s_captures[i].buf) {
+            ESP_LOGE(TAG, "Failed to allocate record buffer %d/%d", i + 1, RECORD_POOL_SIZE);
+            break;
+        }
+        sr_ring_push(&s_capture_free, &s_captures[i]);
+    }
+    s_preroll = heap_caps_malloc(RECORD_PREROLL_SIZE, MALLOC_CAP_SPIRAM);
+    if (!s_preroll) ESP_LOGW(TAG, "No memory for pre-roll buffer, recordings start at command detection");
+
     task_flag = 1;
     xTaskCreatePinnedToCore(&detect_Task, "detect", 8 * 1024, (void*)afe_data, 5, NULL, 1); 
     xTaskCreatePinnedToCore(&feed_Task, "feed", 8 * 1024, (void*)afe_data, 5, NULL, 0);
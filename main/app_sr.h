@@ -2,9 +2,13 @@
 
 #include <stdbool.h>
 
-void app_sr_init(void);
-
-
-
-
+// 语音前端状态（见 app_sr.c 中的状态机说明）
+typedef enum {
+    SR_STATE_IDLE,          // 等待唤醒词
+    SR_STATE_LISTENING,     // 已唤醒，等待命令词
+    SR_STATE_CAPTURING,     // 正在录音
+    SR_STATE_PROCESSING,    // 等待唤醒词，同时有录音在云端识别
+} sr_state_t;
 
+void app_sr_init(void);
+sr_state_t app_sr_get_state(void);
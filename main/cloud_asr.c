@@ -4,6 +4,9 @@
 #include "esp_crt_bundle.h"
 #include "cJSON.h"
 #include "mbedtls/base64.h"
+#include "esp_heap_caps.h"
+#include <stdbool.h>
+#include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 
@@ -109,27 +112,86 @@ void cloud_asr_init(void)
     get_access_token();
 }
 
-static esp_err_t _asr_http_event_handler(esp_http_client_event_t *evt)
+// {"result":["..."]} -> strdup of the first result, NULL (and the error logged) otherwise
+static char *parse_asr_response(const char *response_buf)
 {
-    switch(evt->event_id) {
-        case HTTP_EVENT_ON_DATA:
-            if (evt->user_data) {
-                char *buf = (char *)evt->user_data;
-                int current_len = strlen(buf);
-                // Prevent buffer overflow (assuming 4096 size)
-                if (current_len + evt->data_len < 4095) {
-                    memcpy(buf + current_len, evt->data, evt->data_len);
-                    buf[current_len + evt->data_len] = 0; // Null terminate
-                }
+    char *result_text = NULL;
+    cJSON *resp = cJSON_Parse(response_buf);
+    if (resp) {
+        cJSON *res_arr = cJSON_GetObjectItem(resp, "result");
+        if (res_arr && cJSON_IsArray(res_arr)) {
+            cJSON *item = cJSON_GetArrayItem(res_arr, 0);
+            if (item && item->valuestring) {
+                result_text = strdup(item->valuestring);
             }
-            break;
-        default:
-            break;
+        } else {
+            cJSON *err_msg = cJSON_GetObjectItem(resp, "err_msg");
+            if (err_msg) ESP_LOGE(TAG, "ASR Error: %s", err_msg->valuestring);
+        }
+        cJSON_Delete(resp);
     }
-    return ESP_OK;
+    return result_text;
 }
 
-char* cloud_asr_send_audio(const int16_t *audio_data, int len)
+// ---- request body writer ---------------------------------------------------
+//
+// 请求体边编码边发送，不在内存中拼出完整的 base64 / JSON（一次 3s 录音原先要 ~450KB PSRAM）：
+//   {"format":"pcm","rate":16000,"channel":1,"cuid":..,"token":..,"speech":"<base64>","len":N}
+// "len" 放在 "speech" 之后（JSON 字段顺序无关），流式识别时录完才知道长度。
+// PCM 先攒进 ASR_B64_IN_SIZE 字节（3 的倍数）的小缓冲，每满一块编码成 base64 立即写出，额外内存约 2KB。
+// 两种发送方式：
+//   - 流式（cloud_asr_stream_begin）：检测到命令词即建立连接，chunked 传输，每块一个 HTTP chunk；
+//   - 整段（cloud_asr_send_audio）：长度已知，按 Content-Length 直接写出。
+
+#define ASR_B64_IN_SIZE 768                       // multiple of 3: full blocks encode without padding
+#define ASR_B64_OUT_SIZE (ASR_B64_IN_SIZE / 3 * 4 + 1)
+#define ASR_RESPONSE_BUF_SIZE 4096
+#define ASR_BODY_PREFIX_FMT "{\"format\":\"pcm\",\"rate\":16000,\"channel\":1,\"cuid\":\"esp32-s3-xiaobin\",\"token\":\"%s\",\"speech\":\""
+#define ASR_BODY_SUFFIX_FMT "\",\"len\":%d}"
+
+struct cloud_asr_stream {
+    esp_http_client_handle_t client;
+    bool chunked;
+    int expect_len;     // 整段模式下声明的 PCM 字节数
+    uint8_t in[ASR_B64_IN_SIZE];
+    size_t in_len;
+    char out[ASR_B64_OUT_SIZE];
+    int pcm_len;
+    bool error;
+};
+
+// chunked 模式下每段数据包成一个 chunk："<hex len>\r\n<data>\r\n"
+static void stream_emit(cloud_asr_stream_t *s, const char *data, size_t len)
+{
+    if (s->error || len == 0) return;
+    if (!s->chunked) {
+        if (esp_http_client_write(s->client, data, (int)len) != (int)len) {
+            ESP_LOGE(TAG, "ASR body write failed");
+            s->error = true;
+        }
+        return;
+    }
+    char hdr[12];
+    int n = snprintf(hdr, sizeof(hdr), "%x\r\n", (unsigned)len);
+    if (esp_http_client_write(s->client, hdr, n) != n ||
+        esp_http_client_write(s->client, data, (int)len) != (int)len ||
+        esp_http_client_write(s->client, "\r\n", 2) != 2) {
+        ESP_LOGE(TAG, "ASR stream write failed");
+        s->error = true;
+    }
+}
+
+static void stream_flush_b64(cloud_asr_stream_t *s)
+{
+    if (s->in_len == 0) return;
+    size_t olen = 0;
+    mbedtls_base64_encode((unsigned char *)s->out, sizeof(s->out), &olen, s->in, s->in_len);
+    s->in_len = 0;
+    stream_emit(s, s->out, olen);
+}
+
+// pcm_len < 0：长度未知，chunked 传输；否则按 Content-Length 发送
+static cloud_asr_stream_t *stream_open(int pcm_len)
 {
     if (!g_access_token) {
         get_access_token();
@@ -138,91 +200,114 @@ char* cloud_asr_send_audio(const int16_t *audio_data, int len)
             return NULL;
         }
     }
+    char prefix[256];
+    int n = snprintf(prefix, sizeof(prefix), ASR_BODY_PREFIX_FMT, g_access_token);
+    if (n <= 0 || n >= (int)sizeof(prefix)) return NULL;
 
-    ESP_LOGI(TAG, "Sending audio to Cloud ASR, len: %d bytes. Free Heap: %d", len, (int)esp_get_free_heap_size());
-
-    // 1. Base64 Encode Audio
-    size_t base64_len = 0;
-    mbedtls_base64_encode(NULL, 0, &base64_len, (const unsigned char*)audio_data, len);
-    char *base64_buf = heap_caps_malloc(base64_len + 1, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-    if (!base64_buf) {
-        ESP_LOGE(TAG, "OOM for base64");
-        return NULL;
-    }
-    mbedtls_base64_encode((unsigned char*)base64_buf, base64_len + 1, &base64_len, (const unsigned char*)audio_data, len);
-    base64_buf[base64_len] = 0;
-
-    // 2. Build JSON
-    cJSON *root = cJSON_CreateObject();
-    cJSON_AddStringToObject(root, "format", "pcm");
-    cJSON_AddNumberToObject(root, "rate", 16000);
-    cJSON_AddNumberToObject(root, "channel", 1);
-    cJSON_AddStringToObject(root, "cuid", "esp32-s3-xiaobin");
-    cJSON_AddStringToObject(root, "token", g_access_token);
-    cJSON_AddNumberToObject(root, "len", len);
-    cJSON_AddStringToObject(root, "speech", base64_buf);
-
-    char *post_data = cJSON_PrintUnformatted(root);
-    free(base64_buf); // Free base64 buffer early
-    cJSON_Delete(root);
-
-    if (!post_data) return NULL;
-
-    // 3. Send HTTP Request
-    char *result_text = NULL;
-    char *response_buf = heap_caps_calloc(1, 4096, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT); // Allocate buffer for response
-    if (!response_buf) {
-        free(post_data);
-        return NULL;
+    int content_len = -1; // esp_http_client_open: -1 -> Transfer-Encoding: chunked
+    if (pcm_len >= 0) {
+        char suffix[32];
+        content_len = n + (pcm_len + 2) / 3 * 4 + snprintf(suffix, sizeof(suffix), ASR_BODY_SUFFIX_FMT, pcm_len);
     }
 
+    cloud_asr_stream_t *s = heap_caps_calloc(1, sizeof(*s), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!s) return NULL;
+    s->chunked = pcm_len < 0;
+    s->expect_len = pcm_len;
     esp_http_client_config_t config = {
         .url = BAIDU_ASR_URL,
         .method = HTTP_METHOD_POST,
         .timeout_ms = 20000,
         .buffer_size = 4096,
         .buffer_size_tx = 2048,
-        .event_handler = _asr_http_event_handler,
-        .user_data = response_buf,
     };
-    esp_http_client_handle_t client = esp_http_client_init(&config);
-    
-    esp_http_client_set_header(client, "Content-Type", "application/json");
-    esp_http_client_set_post_field(client, post_data, strlen(post_data));
+    s->client = esp_http_client_init(&config);
+    if (!s->client) {
+        free(s);
+        return NULL;
+    }
+    esp_http_client_set_header(s->client, "Content-Type", "application/json");
+    esp_err_t err = esp_http_client_open(s->client, content_len);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "ASR Connect failed: %s", esp_err_to_name(err));
+        esp_http_client_cleanup(s->client);
+        free(s);
+        return NULL;
+    }
+    stream_emit(s, prefix, n);
+    return s;
+}
 
-    esp_err_t err = esp_http_client_perform(client);
+cloud_asr_stream_t *cloud_asr_stream_begin(void)
+{
+    cloud_asr_stream_t *s = stream_open(-1);
+    if (s) ESP_LOGI(TAG, "ASR stream opened");
+    return s;
+}
 
-    if (err == ESP_OK) {
-        int status_code = esp_http_client_get_status_code(client);
-        ESP_LOGI(TAG, "ASR Status: %d, Len: %lld", status_code, esp_http_client_get_content_length(client));
-        
-        if (status_code == 200) {
-            ESP_LOGI(TAG, "ASR Response: %s", response_buf);
-            cJSON *resp = cJSON_Parse(response_buf);
-            if (resp) {
-                cJSON *res_arr = cJSON_GetObjectItem(resp, "result");
-                if (res_arr && cJSON_IsArray(res_arr)) {
-                    cJSON *item = cJSON_GetArrayItem(res_arr, 0);
-                    if (item && item->valuestring) {
-                        result_text = strdup(item->valuestring);
-                    }
-                } else {
-                    cJSON *err_msg = cJSON_GetObjectItem(resp, "err_msg");
-                    if (err_msg) ESP_LOGE(TAG, "ASR Error: %s", err_msg->valuestring);
-                }
-                cJSON_Delete(resp);
+int cloud_asr_stream_write(cloud_asr_stream_t *s, const int16_t *pcm, int len)
+{
+    if (!s || s->error) return -1;
+    const uint8_t *p = (const uint8_t *)pcm;
+    s->pcm_len += len;
+    while (len > 0 && !s->error) {
+        size_t take = sizeof(s->in) - s->in_len;
+        if (take > (size_t)len) take = len;
+        memcpy(s->in + s->in_len, p, take);
+        s->in_len += take;
+        p += take;
+        len -= take;
+        if (s->in_len == sizeof(s->in)) stream_flush_b64(s);
+    }
+    return s->error ? -1 : 0;
+}
+
+void cloud_asr_stream_abort(cloud_asr_stream_t *s)
+{
+    if (!s) return;
+    esp_http_client_close(s->client);
+    esp_http_client_cleanup(s->client);
+    free(s);
+}
+
+char *cloud_asr_stream_finish(cloud_asr_stream_t *s)
+{
+    if (!s) return NULL;
+    stream_flush_b64(s); // the tail block carries the base64 padding
+    if (!s->chunked && s->pcm_len != s->expect_len) s->error = true; // Content-Length 已按声明长度发出
+    char suffix[32];
+    int n = snprintf(suffix, sizeof(suffix), ASR_BODY_SUFFIX_FMT, s->pcm_len);
+    stream_emit(s, suffix, n);
+    if (s->chunked && !s->error && esp_http_client_write(s->client, "0\r\n\r\n", 5) != 5) s->error = true;
+
+    char *result_text = NULL;
+    if (!s->error && esp_http_client_fetch_headers(s->client) >= 0) {
+        int status_code = esp_http_client_get_status_code(s->client);
+        char *response_buf = heap_caps_calloc(1, ASR_RESPONSE_BUF_SIZE, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (response_buf) {
+            int rlen = esp_http_client_read_response(s->client, response_buf, ASR_RESPONSE_BUF_SIZE - 1);
+            response_buf[rlen > 0 ? rlen : 0] = '\0';
+            ESP_LOGI(TAG, "ASR Status: %d, %d bytes of audio", status_code, s->pcm_len);
+            if (status_code == 200) {
+                ESP_LOGI(TAG, "ASR Response: %s", response_buf);
+                result_text = parse_asr_response(response_buf);
             }
+            free(response_buf);
         }
-    } else {
-        ESP_LOGE(TAG, "ASR Connect failed: %s", esp_err_to_name(err));
     }
-
-    free(response_buf);
-    free(post_data);
-    esp_http_client_cleanup(client);
+    cloud_asr_stream_abort(s);
     return result_text;
 }
 
+char* cloud_asr_send_audio(const int16_t *audio_data, int len)
+{
+    ESP_LOGI(TAG, "Sending audio to Cloud ASR, len: %d bytes. Free Heap: %d", len, (int)esp_get_free_heap_size());
+    cloud_asr_stream_t *s = stream_open(len);
+    if (!s) return NULL;
+    cloud_asr_stream_write(s, audio_data, len);
+    return cloud_asr_stream_finish(s);
+}
+
 const char *cloud_asr_get_token(void)
 {
     // Ensure token exists (simple check)
@@ -15,6 +15,15 @@ void cloud_asr_init(void);
 // Returns malloc'd string (caller must free) or NULL on failure
 char *cloud_asr_send_audio(const int16_t *audio_data, int len);
 
+// 流式识别：检测到命令词时 begin 建立连接，录音期间每收到一段 PCM 就 write（len 为字节数，攒满一块即编码发出），
+// 录音结束后 finish 发送结尾并等待识别结果（返回值需 free，失败为 NULL），finish/abort 之后句柄失效。
+// begin 失败返回 NULL；write 失败后应 abort 并改用 cloud_asr_send_audio 整段重发
+typedef struct cloud_asr_stream cloud_asr_stream_t;
+cloud_asr_stream_t *cloud_asr_stream_begin(void);
+int cloud_asr_stream_write(cloud_asr_stream_t *s, const int16_t *pcm, int len);
+char *cloud_asr_stream_finish(cloud_asr_stream_t *s);
+void cloud_asr_stream_abort(cloud_asr_stream_t *s);
+
 // Get current valid Access Token (or NULL)
 const char *cloud_asr_get_token(void);
 
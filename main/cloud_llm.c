@@ -15,9 +15,129 @@
 
 static const char *TAG = "cloud_llm";
 
+// Multi-item replies are longer than the single-object ones
+#define LLM_RESPONSE_BUF_SIZE 8192
+
 // IAM Bearer Token for Qianfan LLM (V2 API)
 #define QIANFAN_BEARER_TOKEN "bce-v3/ALTAK-qV035uKpslFPqXnfHWzFd/8017c9c36f6a9555e4b9b6f4b0898b787c71c7a9"
 
+// Apply one extracted item object (add or remove)
+static bool apply_llm_item(const cJSON *item_json, llm_action_t action)
+{
+    if (!cJSON_IsObject(item_json)) return false;
+    cJSON *name = cJSON_GetObjectItem(item_json, "name");
+    cJSON *qty = cJSON_GetObjectItem(item_json, "quantity");
+    if (!name || !cJSON_IsString(name) || !name->valuestring || name->valuestring[0] == '\0') return false;
+
+    if (action == LLM_ACTION_REMOVE) {
+        if (!qty) return false;
+        return inventory_remove_item(name->valuestring, qty->valueint) == 0;
+    }
+
+    // ADD
+    inventory_item_t item;
+    memset(&item, 0, sizeof(item));
+
+    cJSON *cat = cJSON_GetObjectItem(item_json, "category");
+    cJSON *unit = cJSON_GetObjectItem(item_json, "unit");
+    cJSON *loc = cJSON_GetObjectItem(item_json, "location");
+    cJSON *notes = cJSON_GetObjectItem(item_json, "notes");
+    cJSON *exp = cJSON_GetObjectItem(item_json, "expiry_date");
+    cJSON *shelf = cJSON_GetObjectItem(item_json, "shelf_life_days");
+
+    // string fields borrow from item_json; inventory_add_item copies them
+    item.name = name->valuestring;
+    if (cat && cat->valuestring) item.category = cat->valuestring;
+    if (qty) item.quantity = qty->valueint;
+    if (unit && unit->valuestring) item.unit = unit->valuestring;
+    if (loc && loc->valuestring) item.location = loc->valuestring;
+    if (notes && notes->valuestring) item.notes = notes->valuestring;
+
+    // Use shelf_life_days when provided
+    if (shelf && cJSON_IsNumber(shelf) && shelf->valueint > 0) {
+        item.default_shelf_life_days = shelf->valueint;
+    }
+
+    // Handle expiry date parsing (YYYY-MM-DD) when it's a non-empty and valid string
+    if (exp && cJSON_IsString(exp) && exp->valuestring && exp->valuestring[0] != '\0') {
+        const char *exp_str = exp->valuestring;
+        // Treat "未知" / "不详" / "unknown" 等为未知日期，交给下方 shelf_life_days 逻辑
+        if (strcmp(exp_str, "未知") != 0 && strcmp(exp_str, "不详") != 0 &&
+            strcasecmp(exp_str, "unknown") != 0 && strcasecmp(exp_str, "unk") != 0) {
+            struct tm tmv = {0};
+            if (sscanf(exp_str, "%d-%d-%d", &tmv.tm_year, &tmv.tm_mon, &tmv.tm_mday) == 3) {
+                tmv.tm_year -= 1900;
+                tmv.tm_mon -= 1;
+                item.calculated_expiry_date = mktime(&tmv);
+            }
+        }
+    }
+
+    // If expiry_date is missing or parsing failed but we have shelf_life_days,
+    // derive a reasonable expiry date from shelf_life_days.
+    if (item.calculated_expiry_date == 0 && item.default_shelf_life_days > 0) {
+        item.calculated_expiry_date = time(NULL) + (int64_t)item.default_shelf_life_days * 24 * 3600;
+    }
+
+    item.added_time = time(NULL);
+    if (item.quantity <= 0) item.quantity = 1;
+    if (inventory_add_item(&item) != 0) return false;
+    ESP_LOGI(TAG, "Item added via Cloud LLM: %s", item.name);
+    return true;
+}
+
+// Extract the JSON payload from the model's text reply and apply every item in it.
+// Accepts an array of items (current prompt contract), {"items":[...]}, or a single object.
+static int apply_llm_content(const char *content, llm_action_t action)
+{
+    const char *obj = strchr(content, '{');
+    const char *arr = strchr(content, '[');
+    const char *start, *end;
+    if (arr && (!obj || arr < obj)) {
+        start = arr;
+        end = strrchr(content, ']');
+    } else {
+        start = obj;
+        end = strrchr(content, '}');
+    }
+    if (!start || !end || end <= start) {
+        ESP_LOGW(TAG, "No JSON found in LLM content");
+        return 0;
+    }
+
+    char *json_str = strndup(start, end - start + 1);
+    if (!json_str) return 0;
+    ESP_LOGI(TAG, "Extracted Item JSON: %s", json_str);
+    cJSON *parsed = cJSON_Parse(json_str);
+    free(json_str);
+    if (!parsed) {
+        ESP_LOGE(TAG, "Failed to parse extracted item JSON");
+        return 0;
+    }
+
+    const cJSON *list = parsed;
+    if (cJSON_IsObject(parsed)) {
+        cJSON *items = cJSON_GetObjectItem(parsed, "items");
+        if (items && cJSON_IsArray(items)) list = items;
+    }
+
+    // 一句话里的多个物品作为一个事务写入：一次日志追加、一次同步队列写入、一次界面刷新
+    int applied = 0;
+    inventory_txn_begin();
+    if (cJSON_IsArray(list)) {
+        const cJSON *it = NULL;
+        cJSON_ArrayForEach(it, list) {
+            if (apply_llm_item(it, action)) applied++;
+        }
+    } else if (apply_llm_item(list, action)) {
+        applied++;
+    }
+    inventory_txn_commit();
+    cJSON_Delete(parsed);
+    ESP_LOGI(TAG, "Applied %d item(s) from LLM response", applied);
+    return applied;
+}
+
 // Helper to parse LLM response
 static void process_llm_response(const char *json_str, llm_action_t action)
 {
@@ -30,80 +150,14 @@ static void process_llm_response(const char *json_str, llm_action_t action)
 
     // Handle OpenAI-compatible format: choices[0].message.content
     // Also handle Baidu ERNIE format: "result": "..."
+    // The content itself should be a JSON string (as requested in prompt)
     cJSON *result_node = cJSON_GetObjectItem(root, "result");
     if (result_node && cJSON_IsString(result_node)) {
-         // Baidu ERNIE response
-         ESP_LOGI(TAG, "Baidu ERNIE Result: %s", result_node->valuestring);
-         // The content itself should be a JSON string (as requested in prompt)
-         char *content_str = result_node->valuestring;
-         char *start = strchr(content_str, '{');
-         char *end = strrchr(content_str, '}');
-         if (start && end && end > start) {
-             char *item_json_str = strndup(start, end - start + 1);
-             ESP_LOGI(TAG, "Extracted Item JSON: %s", item_json_str);
-             
-             cJSON *item_json = cJSON_Parse(item_json_str);
-             if (item_json) {
-                 // ... (Same parsing logic as before) ...
-                 cJSON *name = cJSON_GetObjectItem(item_json, "name");
-                 cJSON *qty = cJSON_GetObjectItem(item_json, "quantity");
-                 
-                 if (action == LLM_ACTION_REMOVE) {
-                     if (name && name->valuestring && qty) {
-                         inventory_remove_item(name->valuestring, qty->valueint);
-                     }
-                 } else {
-                     // ADD
-                     inventory_item_t item;
-                     memset(&item, 0, sizeof(item));
-                     
-                     cJSON *cat = cJSON_GetObjectItem(item_json, "category");
-                     cJSON *unit = cJSON_GetObjectItem(item_json, "unit");
-                     cJSON *loc = cJSON_GetObjectItem(item_json, "location");
-                     cJSON *notes = cJSON_GetObjectItem(item_json, "notes");
-                     cJSON *exp = cJSON_GetObjectItem(item_json, "expiry_date");
-                     cJSON *shelf = cJSON_GetObjectItem(item_json, "shelf_life_days");
-
-                     if (name && name->valuestring) strncpy(item.name, name->valuestring, sizeof(item.name)-1);
-                     if (cat && cat->valuestring) strncpy(item.category, cat->valuestring, sizeof(item.category)-1);
-                     if (qty) item.quantity = qty->valueint;
-                     if (unit && unit->valuestring) strncpy(item.unit, unit->valuestring, sizeof(item.unit)-1);
-                     if (loc && loc->valuestring) strncpy(item.location, loc->valuestring, sizeof(item.location)-1);
-                     if (notes && notes->valuestring) strncpy(item.notes, notes->valuestring, sizeof(item.notes)-1);
-                     
-                     // Use shelf_life_days when provided
-                     if (shelf && cJSON_IsNumber(shelf) && shelf->valueint > 0) {
-                         item.default_shelf_life_days = shelf->valueint;
-                     }
-
-                     // Handle expiry date parsing (YYYY-MM-DD) when it's a non-empty string
-                     if (exp && cJSON_IsString(exp) && exp->valuestring && exp->valuestring[0] != '\0') {
-                         struct tm tmv = {0};
-                         if (sscanf(exp->valuestring, "%d-%d-%d", &tmv.tm_year, &tmv.tm_mon, &tmv.tm_mday) == 3) {
-                             tmv.tm_year -= 1900;
-                             tmv.tm_mon -= 1;
-                             item.calculated_expiry_date = mktime(&tmv);
-                         }
-                     }
-
-                     // If expiry_date is missing or parsing failed but we have shelf_life_days,
-                     // derive a reasonable expiry date from shelf_life_days.
-                     if (item.calculated_expiry_date == 0 && item.default_shelf_life_days > 0) {
-                         item.calculated_expiry_date = time(NULL) + (int64_t)item.default_shelf_life_days * 24 * 3600;
-                     }
-
-                     // Add to inventory
-                     item.added_time = time(NULL);
-                     if (item.quantity <= 0) item.quantity = 1;
-                     inventory_add_item(&item);
-                     ESP_LOGI(TAG, "Item added via Cloud LLM: %s", item.name);
-                 }
-                 cJSON_Delete(item_json);
-             }
-             free(item_json_str);
-         }
-         cJSON_Delete(root);
-         return;
+        // Baidu ERNIE response
+        ESP_LOGI(TAG, "Baidu ERNIE Result: %s", result_node->valuestring);
+        apply_llm_content(result_node->valuestring, action);
+        cJSON_Delete(root);
+        return;
     }
 
     cJSON *choices = cJSON_GetObjectItem(root, "choices");
@@ -112,77 +166,7 @@ static void process_llm_response(const char *json_str, llm_action_t action)
         cJSON *message = cJSON_GetObjectItem(choice, "message");
         cJSON *content = cJSON_GetObjectItem(message, "content");
         if (content && cJSON_IsString(content)) {
-            // The content itself should be a JSON string (as requested in prompt)
-            // We need to find the JSON block in the content
-            char *start = strchr(content->valuestring, '{');
-            char *end = strrchr(content->valuestring, '}');
-            if (start && end && end > start) {
-                char *item_json_str = strndup(start, end - start + 1);
-                ESP_LOGI(TAG, "Extracted Item JSON: %s", item_json_str);
-                
-                cJSON *item_json = cJSON_Parse(item_json_str);
-                if (item_json) {
-                    cJSON *name = cJSON_GetObjectItem(item_json, "name");
-                    cJSON *qty = cJSON_GetObjectItem(item_json, "quantity");
-                    
-                    if (action == LLM_ACTION_REMOVE) {
-                        if (name && name->valuestring && qty) {
-                            inventory_remove_item(name->valuestring, qty->valueint);
-                        }
-                    } else {
-                        // ADD
-                        inventory_item_t item;
-                        memset(&item, 0, sizeof(item));
-
-                        cJSON *cat = cJSON_GetObjectItem(item_json, "category");
-                        cJSON *unit = cJSON_GetObjectItem(item_json, "unit");
-                        cJSON *loc = cJSON_GetObjectItem(item_json, "location");
-                        cJSON *notes = cJSON_GetObjectItem(item_json, "notes");
-                        cJSON *exp = cJSON_GetObjectItem(item_json, "expiry_date");
-                        cJSON *shelf = cJSON_GetObjectItem(item_json, "shelf_life_days");
-
-                        if (name && name->valuestring) strncpy(item.name, name->valuestring, sizeof(item.name)-1);
-                        if (cat && cat->valuestring) strncpy(item.category, cat->valuestring, sizeof(item.category)-1);
-                        if (qty) item.quantity = qty->valueint;
-                        if (unit && unit->valuestring) strncpy(item.unit, unit->valuestring, sizeof(item.unit)-1);
-                        if (loc && loc->valuestring) strncpy(item.location, loc->valuestring, sizeof(item.location)-1);
-                        if (notes && notes->valuestring) strncpy(item.notes, notes->valuestring, sizeof(item.notes)-1);
-                        
-                        // Use shelf_life_days when provided
-                        if (shelf && cJSON_IsNumber(shelf) && shelf->valueint > 0) {
-                            item.default_shelf_life_days = shelf->valueint;
-                        }
-
-                        // Handle expiry date parsing (YYYY-MM-DD) when it's a non-empty and valid string
-                        if (exp && cJSON_IsString(exp) && exp->valuestring && exp->valuestring[0] != '\0') {
-                            const char *exp_str = exp->valuestring;
-                            // Treat "未知" / "不详" / "unknown" 等为未知日期，交给下方 shelf_life_days 逻辑
-                            if (strcmp(exp_str, "未知") != 0 && strcmp(exp_str, "不详") != 0 &&
-                                strcasecmp(exp_str, "unknown") != 0 && strcasecmp(exp_str, "unk") != 0) {
-                                struct tm tmv = {0};
-                                if (sscanf(exp_str, "%d-%d-%d", &tmv.tm_year, &tmv.tm_mon, &tmv.tm_mday) == 3) {
-                                    tmv.tm_year -= 1900;
-                                    tmv.tm_mon -= 1;
-                                    item.calculated_expiry_date = mktime(&tmv);
-                                }
-                            }
-                        }
-
-                        // If expiry_date is missing or parsing failed but we have shelf_life_days,
-                        // derive a reasonable expiry date from shelf_life_days.
-                        if (item.calculated_expiry_date == 0 && item.default_shelf_life_days > 0) {
-                            item.calculated_expiry_date = time(NULL) + (int64_t)item.default_shelf_life_days * 24 * 3600;
-                        }
-
-                        item.added_time = time(NULL);
-                        if (item.quantity <= 0) item.quantity = 1;
-                        inventory_add_item(&item);
-                        ESP_LOGI(TAG, "Item added via Cloud LLM: %s", item.name);
-                    }
-                    cJSON_Delete(item_json);
-                }
-                free(item_json_str);
-            }
+            apply_llm_content(content->valuestring, action);
         }
     }
     cJSON_Delete(root);
@@ -234,13 +218,17 @@ bool cloud_llm_parse_inventory(const char *text, llm_action_t action)
     char system_prompt[2048];
     if (action == LLM_ACTION_REMOVE) {
         snprintf(system_prompt, sizeof(system_prompt),
-            "你是一个冰箱库存管理助手。用户希望移除一些物品。请从用户语音中抽取: name(名称), quantity(数量)。只返回 JSON，不要包含其他文字。示例: {\"name\":\"苹果\",\"quantity\":2}");
+            "你是一个冰箱库存管理助手。用户希望移除一些物品。请从用户语音中抽取每个物品的: name(名称), quantity(数量)。"
+            "用户可能一次说出多个物品, 每个物品输出一个对象。只返回 JSON 数组，不要包含其他文字, 即使只有一个物品也返回数组。"
+            "示例: [{\"name\":\"苹果\",\"quantity\":2},{\"name\":\"牛奶\",\"quantity\":1}]");
     } else {
         snprintf(system_prompt, sizeof(system_prompt),
-            "你是一个冰箱库存管理助手。请从用户语音中抽取以下字段: name(名称), category(类别), quantity(数量), unit(单位), expiry_date(保质期, YYYY-MM-DD), shelf_life_days(保质期天数, int), location(推荐存放区域), notes(备注)。"
+            "你是一个冰箱库存管理助手。用户可能一次说出多个物品, 请为每个物品抽取以下字段: name(名称), category(类别), quantity(数量), unit(单位), expiry_date(保质期, YYYY-MM-DD), shelf_life_days(保质期天数, int), location(推荐存放区域), notes(备注)。"
             "今天是 %s。如果用户没有明确说出具体保质期天数, 需要你根据食材类型和常见保存习惯智能推荐一个合理的 shelf_life_days(>0), 例如: 牛奶/酸奶≈7天, 生肉≈2-3天, 冷冻食品≈30天, 常温零食≈30天。"
             "location 字段如果用户没有明确说出存放位置, 需要你根据食材类型智能推荐, 例如: 牛奶/熟食/鸡蛋→冷藏区, 冷冻食品→冷冻室, 罐头/零食→常温储藏区。务必给出非空的 location 字符串。"
-            "只返回 JSON, 不要包含其他文字。示例: {\"name\":\"牛奶\",\"category\":\"乳制品\",\"quantity\":1,\"unit\":\"盒\",\"expiry_date\":\"2025-12-01\",\"shelf_life_days\":7,\"location\":\"冷藏区\",\"notes\":\"脱脂\"}",
+            "只返回 JSON 数组, 每个物品一个对象, 即使只有一个物品也返回数组, 不要包含其他文字。"
+            "示例: [{\"name\":\"牛奶\",\"category\":\"乳制品\",\"quantity\":1,\"unit\":\"盒\",\"expiry_date\":\"2025-12-01\",\"shelf_life_days\":7,\"location\":\"冷藏区\",\"notes\":\"脱脂\"},"
+            "{\"name\":\"苹果\",\"category\":\"水果\",\"quantity\":3,\"unit\":\"个\",\"expiry_date\":\"\",\"shelf_life_days\":14,\"location\":\"冷藏区\",\"notes\":\"\"}]",
             date_str);
     }
 
@@ -287,9 +275,10 @@ bool cloud_llm_parse_inventory(const char *text, llm_action_t action)
             ESP_LOGE(TAG, "HTTP client fetch headers failed");
         } else {
             int read_len;
-            char *buffer = heap_caps_malloc(4096, MALLOC_CAP_SPIRAM); // Allocate 4KB buffer in PSRAM
+            // 缓冲区放在 PSRAM；留 1 字节给结尾的 '\0'
+            char *buffer = heap_caps_malloc(LLM_RESPONSE_BUF_SIZE, MALLOC_CAP_SPIRAM);
             if (buffer) {
-                read_len = esp_http_client_read_response(client, buffer, 4096);
+                read_len = esp_http_client_read_response(client, buffer, LLM_RESPONSE_BUF_SIZE - 1);
                 if (read_len >= 0) {
                     buffer[read_len] = 0; // Null terminate
                     ESP_LOGI(TAG, "HTTP Response: %s", buffer);
@@ -311,34 +300,35 @@ bool cloud_llm_parse_inventory(const char *text, llm_action_t action)
     return success;
 }
 
+static bool append_inventory_item(const inventory_item_t *it, void *ctx)
+{
+    char *inv_str = ctx;
+    char item_buf[128];
+    snprintf(item_buf, sizeof(item_buf), "%s (%d %s), ", it->name, it->quantity, it->unit);
+    if (strlen(inv_str) + strlen(item_buf) < 2047) {
+        strcat(inv_str, item_buf);
+    }
+    return true;
+}
+
 bool cloud_llm_recommend_recipes(void)
 {
     ESP_LOGI(TAG, "Requesting Recipe Recommendation...");
 
-    // 1. Get Inventory
-    inventory_item_t **items = NULL;
-    int count = inventory_list_items(&items);
-    if (count <= 0) {
+    // 1. Check Inventory
+    if (inventory_count() == 0) {
         ESP_LOGW(TAG, "Inventory is empty, cannot recommend recipes.");
         printf("Inventory is empty. Please add items first.\n");
         return false;
     }
 
-    // 2. Build Inventory String
+    // 2. Build Inventory String (soonest-expiring first, no intermediate list)
     char *inv_str = heap_caps_malloc(2048, MALLOC_CAP_SPIRAM);
     if (!inv_str) {
-        inventory_free_list(items);
         return false;
     }
     strcpy(inv_str, "Current Inventory: ");
-    for (int i = 0; i < count; i++) {
-        char item_buf[128];
-        snprintf(item_buf, sizeof(item_buf), "%s (%d %s), ", items[i]->name, items[i]->quantity, items[i]->unit);
-        if (strlen(inv_str) + strlen(item_buf) < 2047) {
-            strcat(inv_str, item_buf);
-        }
-    }
-    inventory_free_list(items);
+    inventory_foreach_by_expiry(0, append_inventory_item, inv_str);
 
     // 3. Prepare LLM Request
     const char *url = "https://qianfan.baidubce.com/v2/chat/completions";
@@ -0,0 +1,214 @@
+// cmd_trace.c - 语音命令端到端耗时追踪
+#include "cmd_trace.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+static const char *const s_stage_names[CMD_TRACE_STAGE_COUNT] = {
+    "command", "capture", "asr_connect", "asr", "llm", "store", "ui", "prompt",
+};
+
+// 完成的 trace；dur_us 为 -1 表示未经过该阶段
+typedef struct {
+    uint32_t id;
+    int command;
+    int32_t total_us;
+    int32_t dur_us[CMD_TRACE_STAGE_COUNT];
+} trace_rec_t;
+
+typedef struct {
+    trace_rec_t rec;        // rec.id == 0 表示空闲槽
+    int64_t t0;
+    int64_t open_at[CMD_TRACE_STAGE_COUNT]; // 打开中的 span 的开始时刻，0 = 未打开
+    TaskHandle_t owner;     // cmd_trace_bind 绑定的任务
+} trace_active_t;
+
+// 各任务都会调用（detect_Task、process_audio_task、库存写入），临界区内只做几次比较和赋值
+static portMUX_TYPE s_trace_mux = portMUX_INITIALIZER_UNLOCKED;
+static trace_active_t s_active[CMD_TRACE_ACTIVE_MAX];
+static trace_rec_t s_ring[CMD_TRACE_RING_SIZE];
+static uint32_t s_ring_count = 0;   // 累计完成数；最近的在 (s_ring_count - 1) % CMD_TRACE_RING_SIZE
+static uint32_t s_next_id = 1;
+
+// 调用者持有 s_trace_mux
+static trace_active_t *find_active(uint32_t id)
+{
+    if (id == 0) return NULL;
+    for (int i = 0; i < CMD_TRACE_ACTIVE_MAX; i++) {
+        if (s_active[i].rec.id == id) return &s_active[i];
+    }
+    return NULL;
+}
+
+uint32_t cmd_trace_begin(void)
+{
+    int64_t now = esp_timer_get_time();
+    uint32_t id = 0;
+    portENTER_CRITICAL(&s_trace_mux);
+    for (int i = 0; i < CMD_TRACE_ACTIVE_MAX; i++) {
+        trace_active_t *a = &s_active[i];
+        if (a->rec.id != 0) continue;
+        memset(a, 0, sizeof(*a));
+        id = s_next_id++;
+        if (s_next_id == 0) s_next_id = 1;
+        a->rec.id = id;
+        a->t0 = now;
+        for (int s = 0; s < CMD_TRACE_STAGE_COUNT; s++) a->rec.dur_us[s] = -1;
+        break;
+    }
+    portEXIT_CRITICAL(&s_trace_mux);
+    return id;
+}
+
+void cmd_trace_set_command(uint32_t id, int command_id)
+{
+    portENTER_CRITICAL(&s_trace_mux);
+    trace_active_t *a = find_active(id);
+    if (a) a->rec.command = command_id;
+    portEXIT_CRITICAL(&s_trace_mux);
+}
+
+void cmd_trace_span_begin(uint32_t id, cmd_trace_stage_t stage)
+{
+    if (id == 0) return;
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&s_trace_mux);
+    trace_active_t *a = find_active(id);
+    if (a && a->open_at[stage] == 0) a->open_at[stage] = now;
+    portEXIT_CRITICAL(&s_trace_mux);
+}
+
+void cmd_trace_span_end(uint32_t id, cmd_trace_stage_t stage)
+{
+    if (id == 0) return;
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&s_trace_mux);
+    trace_active_t *a = find_active(id);
+    if (a && a->open_at[stage] != 0) {
+        int32_t d = (int32_t)(now - a->open_at[stage]);
+        a->rec.dur_us[stage] = (a->rec.dur_us[stage] < 0 ? 0 : a->rec.dur_us[stage]) + d;
+        a->open_at[stage] = 0;
+    }
+    portEXIT_CRITICAL(&s_trace_mux);
+}
+
+void cmd_trace_bind(uint32_t id)
+{
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    portENTER_CRITICAL(&s_trace_mux);
+    for (int i = 0; i < CMD_TRACE_ACTIVE_MAX; i++) {
+        if (s_active[i].owner == self) s_active[i].owner = NULL;
+    }
+    trace_active_t *a = find_active(id);
+    if (a) a->owner = self;
+    portEXIT_CRITICAL(&s_trace_mux);
+}
+
+uint32_t cmd_trace_current(void)
+{
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    uint32_t id = 0;
+    portENTER_CRITICAL(&s_trace_mux);
+    for (int i = 0; i < CMD_TRACE_ACTIVE_MAX; i++) {
+        if (s_active[i].rec.id != 0 && s_active[i].owner == self) {
+            id = s_active[i].rec.id;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&s_trace_mux);
+    return id;
+}
+
+static void print_rec(const trace_rec_t *r)
+{
+    char line[256];
+    int n = snprintf(line, sizeof(line), "TRACE id=%u cmd=%d", (unsigned)r->id, r->command);
+    for (int s = 0; s < CMD_TRACE_STAGE_COUNT && n < (int)sizeof(line); s++) {
+        if (r->dur_us[s] >= 0) n += snprintf(line + n, sizeof(line) - n, " %s=%d", s_stage_names[s], (int)(r->dur_us[s] / 1000));
+    }
+    if (n < (int)sizeof(line)) snprintf(line + n, sizeof(line) - n, " total=%d", (int)(r->total_us / 1000));
+    printf("%s\n", line);
+}
+
+// nearest-rank 分位数；v 会被排序
+static int32_t percentile(int32_t *v, int n, int pct)
+{
+    for (int i = 1; i < n; i++) { // n <= CMD_TRACE_RING_SIZE，插入排序足够
+        int32_t x = v[i];
+        int j = i - 1;
+        while (j >= 0 && v[j] > x) { v[j + 1] = v[j]; j--; }
+        v[j + 1] = x;
+    }
+    int rank = (pct * n + 99) / 100;
+    return v[rank > 0 ? rank - 1 : 0];
+}
+
+static void print_summary(const trace_rec_t *recs, int count)
+{
+    int32_t v[CMD_TRACE_RING_SIZE];
+    for (int s = 0; s <= CMD_TRACE_STAGE_COUNT; s++) { // 最后一轮统计 total
+        int n = 0;
+        for (int i = 0; i < count; i++) {
+            int32_t d = s < CMD_TRACE_STAGE_COUNT ? recs[i].dur_us[s] : recs[i].total_us;
+            if (d >= 0) v[n++] = d;
+        }
+        if (n == 0) continue;
+        int32_t p50 = percentile(v, n, 50);
+        int32_t p95 = percentile(v, n, 95);
+        printf("TRACE_SUMMARY stage=%s n=%d p50=%d p95=%d\n",
+               s < CMD_TRACE_STAGE_COUNT ? s_stage_names[s] : "total", n, (int)(p50 / 1000), (int)(p95 / 1000));
+    }
+}
+
+// 在临界区外打印：先拷贝一份
+static int copy_ring(trace_rec_t *out)
+{
+    portENTER_CRITICAL(&s_trace_mux);
+    int count = s_ring_count < CMD_TRACE_RING_SIZE ? (int)s_ring_count : CMD_TRACE_RING_SIZE;
+    uint32_t first = s_ring_count - count;
+    for (int i = 0; i < count; i++) out[i] = s_ring[(first + i) % CMD_TRACE_RING_SIZE];
+    portEXIT_CRITICAL(&s_trace_mux);
+    return count;
+}
+
+void cmd_trace_end(uint32_t id)
+{
+    if (id == 0) return;
+    int64_t now = esp_timer_get_time();
+    trace_rec_t rec;
+    bool summary = false;
+    portENTER_CRITICAL(&s_trace_mux);
+    trace_active_t *a = find_active(id);
+    if (!a) {
+        portEXIT_CRITICAL(&s_trace_mux);
+        return;
+    }
+    a->rec.total_us = (int32_t)(now - a->t0);
+    rec = a->rec;
+    s_ring[s_ring_count % CMD_TRACE_RING_SIZE] = rec;
+    s_ring_count++;
+    summary = s_ring_count % CMD_TRACE_SUMMARY_EVERY == 0;
+    a->rec.id = 0;
+    a->owner = NULL;
+    portEXIT_CRITICAL(&s_trace_mux);
+
+    print_rec(&rec);
+    if (summary) {
+        trace_rec_t recs[CMD_TRACE_RING_SIZE]; // ~1.4KB，调用者（detect/process 任务）栈为 8KB
+        print_summary(recs, copy_ring(recs));
+    }
+}
+
+void cmd_trace_discard(uint32_t id)
+{
+    portENTER_CRITICAL(&s_trace_mux);
+    trace_active_t *a = find_active(id);
+    if (a) {
+        a->rec.id = 0;
+        a->owner = NULL;
+    }
+    portEXIT_CRITICAL(&s_trace_mux);
+}
@@ -0,0 +1,44 @@
+// cmd_trace.h - 语音命令端到端耗时追踪
+//   每条命令（唤醒/上一条命令之后 -> 命令词 -> 录音 -> ASR -> LLM -> 入库 -> UI -> 提示音）一个 trace id，
+//   各阶段用 esp_timer 记录耗时；完成的 trace 进入环形缓冲，并以一行文本打印到串口：
+//     TRACE id=3 cmd=2 command=1210 capture=2460 asr_connect=180 asr=640 llm=2890 store=35 ui=48 prompt=820 total=7102
+//   每完成 CMD_TRACE_SUMMARY_EVERY 条打印一次各阶段的 p50/p95：
+//     TRACE_SUMMARY stage=asr n=8 p50=610 p95=1320
+//   时间单位均为 ms；未经过的阶段不出现。id 为 0 表示不追踪，所有接口都接受 0 并直接返回
+#ifndef _CMD_TRACE_H_
+#define _CMD_TRACE_H_
+
+#include <stdint.h>
+
+#define CMD_TRACE_ACTIVE_MAX    4   // 同时进行中的 trace 数
+#define CMD_TRACE_RING_SIZE     32  // 保留最近完成的 trace 数（用于统计分位数）
+#define CMD_TRACE_SUMMARY_EVERY 8
+
+typedef enum {
+    CMD_TRACE_COMMAND,      // 唤醒（或上一条命令）-> 命令词识别完成
+    CMD_TRACE_CAPTURE,      // 录音开始 -> 端点检测结束（流式上传与之重叠）
+    CMD_TRACE_ASR_CONNECT,  // 建立 ASR 连接
+    CMD_TRACE_ASR,          // 录音结束 -> 拿到识别文本
+    CMD_TRACE_LLM,          // LLM 解析并写入库存（含 store）
+    CMD_TRACE_STORE,        // 库存落盘（变更日志追加/快照）
+    CMD_TRACE_UI,           // 刷新库存界面
+    CMD_TRACE_PROMPT,       // 播放提示音
+    CMD_TRACE_STAGE_COUNT,
+} cmd_trace_stage_t;
+
+// 开始一条 trace；进行中的 trace 已满时返回 0
+uint32_t cmd_trace_begin(void);
+void cmd_trace_set_command(uint32_t id, int command_id);
+// 同一阶段可多次进出，耗时累加
+void cmd_trace_span_begin(uint32_t id, cmd_trace_stage_t stage);
+void cmd_trace_span_end(uint32_t id, cmd_trace_stage_t stage);
+// 把 trace 绑定到调用任务，之后该任务里的 cmd_trace_current() 返回它（用于库存等不知道 trace id 的模块）；
+// 传 0 解除绑定
+void cmd_trace_bind(uint32_t id);
+uint32_t cmd_trace_current(void);
+// 完成：打印记录并存入环形缓冲
+void cmd_trace_end(uint32_t id);
+// 放弃（如命令词超时），不记录
+void cmd_trace_discard(uint32_t id);
+
+#endif // _CMD_TRACE_H_
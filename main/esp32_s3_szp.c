@@ -1,5 +1,7 @@
 #include <stdio.h>
 #include "esp32_s3_szp.h"
+#include "esp_heap_caps.h"
+#include "feed_deinterleave.h"
 
 static const char *TAG = "esp32_s3_szp";
 
@@ -573,6 +575,20 @@ static i2s_chan_handle_t i2s_rx_chan = NULL; // 接收通道
 static const audio_codec_data_if_t *i2s_data_if = NULL;  /* Codec data interface */
 
 
+// 接收 DMA 队列溢出：feed 读取不及时，最旧的一块 DMA 缓冲被丢弃（中断里调用，只计数）
+static volatile uint32_t s_rx_overflows = 0;
+
+static bool IRAM_ATTR i2s_rx_overflow(i2s_chan_handle_t handle, i2s_event_data_t *event, void *user_ctx)
+{
+    s_rx_overflows++;
+    return false;
+}
+
+uint32_t bsp_get_feed_overflows(void)
+{
+    return s_rx_overflows;
+}
+
 // I2S总线初始化
 esp_err_t bsp_audio_init(void)
 {
@@ -606,6 +622,8 @@ esp_err_t bsp_audio_init(void)
     }
     if (i2s_rx_chan != NULL) {
         ESP_GOTO_ON_ERROR(i2s_channel_init_std_mode(i2s_rx_chan, &std_cfg_default), err, TAG, "I2S channel initialization failed");
+        i2s_event_callbacks_t rx_cbs = { .on_recv_q_ovf = i2s_rx_overflow };
+        ESP_GOTO_ON_ERROR(i2s_channel_register_event_callback(i2s_rx_chan, &rx_cbs, NULL), err, TAG, "I2S callback registration failed");
         ESP_GOTO_ON_ERROR(i2s_channel_enable(i2s_rx_chan), err, TAG, "I2S enabling failed");
     }
 
@@ -738,6 +756,37 @@ esp_err_t bsp_codec_set_fs(uint32_t rate, uint32_t bits_cfg, i2s_slot_mode_t ch)
     return ret;
 }
 
+// 通道重排基准：定义后 bsp_codec_init 测一次重排耗时（与 feed_Task 一样用 PSRAM 缓冲，一帧 AFE 输入 512 帧），
+// 打印打包版本与逐样本参考实现各自的 CPU 周期数。只在调试时打开，正常启动不跑
+// #define BSP_FEED_BENCH
+
+#ifdef BSP_FEED_BENCH
+#include "esp_cpu.h"
+
+#define FEED_BENCH_FRAMES 512
+#define FEED_BENCH_ROUNDS 16
+
+static void feed_deinterleave_bench(void)
+{
+    size_t bytes = FEED_BENCH_FRAMES * ADC_I2S_CHANNEL * sizeof(int16_t);
+    int16_t *buf = heap_caps_malloc(bytes, MALLOC_CAP_8BIT | MALLOC_CAP_SPIRAM);
+    if (!buf) return;
+    uint32_t cycles[2] = {0};
+    for (int k = 0; k < 2; k++) {
+        for (int r = 0; r < FEED_BENCH_ROUNDS; r++) {
+            for (int i = 0; i < FEED_BENCH_FRAMES * ADC_I2S_CHANNEL; i++) buf[i] = (int16_t)(i * 7 + r);
+            uint32_t t0 = esp_cpu_get_cycle_count();
+            if (k == 0) feed_deinterleave_scalar(buf, 0, FEED_BENCH_FRAMES);
+            else feed_deinterleave(buf, FEED_BENCH_FRAMES);
+            cycles[k] += esp_cpu_get_cycle_count() - t0;
+        }
+    }
+    heap_caps_free(buf);
+    ESP_LOGI(TAG, "feed deinterleave %d frames: scalar %u cycles, packed %u cycles",
+             FEED_BENCH_FRAMES, (unsigned)(cycles[0] / FEED_BENCH_ROUNDS), (unsigned)(cycles[1] / FEED_BENCH_ROUNDS));
+}
+#endif
+
 // 音频芯片初始化
 esp_err_t bsp_codec_init(void)
 {
@@ -748,6 +797,9 @@ esp_err_t bsp_codec_init(void)
     assert((record_dev_handle) && "record_dev_handle not initialized");
 
     bsp_codec_set_fs(CODEC_DEFAULT_SAMPLE_RATE, CODEC_DEFAULT_BIT_WIDTH, CODEC_DEFAULT_CHANNEL);
+#ifdef BSP_FEED_BENCH
+    feed_deinterleave_bench();
+#endif
 
     return ESP_OK;
 }
@@ -792,12 +844,7 @@ esp_err_t bsp_get_feed_data(bool is_get_raw_channel, int16_t *buffer, int buffer
     ret = esp_codec_dev_read(record_dev_handle, (void *)buffer, buffer_len);
     
     if (!is_get_raw_channel) {
-        for (int i = 0; i < audio_chunksize; i++) {
-            int16_t ref = buffer[4 * i + 0];
-            buffer[3 * i + 0] = buffer[4 * i + 1];
-            buffer[3 * i + 1] = buffer[4 * i + 3];
-            buffer[3 * i + 2] = ref;
-        }
+        feed_deinterleave(buffer, audio_chunksize);
     }
 
     return ret;
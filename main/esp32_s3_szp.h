@@ -284,6 +284,7 @@ esp_err_t bsp_codec_volume_set(int volume, int *volume_set);
 
 int bsp_get_feed_channel(void);
 esp_err_t bsp_get_feed_data(bool is_get_raw_channel, int16_t *buffer, int buffer_len);
+uint32_t bsp_get_feed_overflows(void);  // 麦克风 I2S 接收 DMA 队列溢出（丢掉一块 DMA 缓冲）的累计次数
 
 /*********************    音频 ↑   *************************/
 /***********************************************************/
\ No newline at end of file
@@ -0,0 +1,35 @@
+// feed_deinterleave.c - 麦克风 I2S 帧重排为 AFE 输入格式
+#include "feed_deinterleave.h"
+
+// 每次处理两帧：两帧 16 字节按 4 个 32 位字读入、拼成 3 个 32 位字写出，
+// 比逐样本的 16 位读写少一半以上的访存（缓冲在 PSRAM，访存是主要开销）。
+// 先读完两帧再写，写位置 6i 字节始终不超过读位置 8i，原地处理安全；i 为偶数时写地址 4 字节对齐
+typedef uint32_t __attribute__((may_alias)) feed_word_t;
+
+void feed_deinterleave_scalar(int16_t *buffer, int from, int frames)
+{
+    for (int i = from; i < frames; i++) {
+        int16_t ref = buffer[4 * i + 0];
+        buffer[3 * i + 0] = buffer[4 * i + 1];
+        buffer[3 * i + 1] = buffer[4 * i + 3];
+        buffer[3 * i + 2] = ref;
+    }
+}
+
+void feed_deinterleave(int16_t *buffer, int frames)
+{
+    int i = 0;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    if (((uintptr_t)buffer & 3) == 0) {
+        const feed_word_t *in = (const feed_word_t *)buffer;
+        feed_word_t *out = (feed_word_t *)buffer;
+        for (; i + 2 <= frames; i += 2, in += 4, out += 3) {
+            uint32_t a01 = in[0], a23 = in[1], b01 = in[2], b23 = in[3];
+            out[0] = (a01 >> 16) | (a23 & 0xffff0000u);      // a.mic1 | a.mic3
+            out[1] = (a01 & 0xffffu) | (b01 & 0xffff0000u);  // a.ref  | b.mic1
+            out[2] = (b23 >> 16) | (b01 << 16);               // b.mic3 | b.ref
+        }
+    }
+#endif
+    feed_deinterleave_scalar(buffer, i, frames); // 奇数帧的最后一帧 / 大端或未对齐时整段
+}
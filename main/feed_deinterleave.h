@@ -0,0 +1,15 @@
+// feed_deinterleave.h - 麦克风 I2S 帧重排为 AFE 输入格式
+//   4 通道 I2S 帧 [ref, mic1, mic2, mic3] 原地重排为 AFE 需要的 3 通道 [mic1, mic3, ref]，
+//   处理后 buffer 前 3 * frames 个样本有效。不依赖 IDF，主机测试（test/host）直接编译
+#ifndef _FEED_DEINTERLEAVE_H_
+#define _FEED_DEINTERLEAVE_H_
+
+#include <stdint.h>
+
+// 每次处理两帧的打包版本，bsp_get_feed_data 使用
+void feed_deinterleave(int16_t *buffer, int frames);
+
+// 逐样本的参考实现：处理 [from, frames) 帧，要求 [0, from) 帧已重排。打包版本用它处理尾帧
+void feed_deinterleave_scalar(int16_t *buffer, int from, int frames);
+
+#endif // _FEED_DEINTERLEAVE_H_
@@ -1,4 +1,4 @@
-// inventory.c - 简易库存链表与持久化接口（依赖 storage.c）
+// inventory.c - 库存存储（slab 槽位池 + 哈希索引）与持久化接口（依赖 storage.c）
 
 #include "inventory.h"
 #include "storage.h"
@@ -6,20 +6,62 @@
 #include "cJSON.h"
 #include "esp_log.h"
 #include "sync.h"
+#include "json_stream.h"
+#include "cmd_trace.h"
+#include "esp_rom_crc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include <string.h>
 #include <stdlib.h>
 #include <time.h>
 #include <stdio.h>
 #include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <ctype.h>
 
 static const char *TAG = "inventory";
-static inventory_item_t *g_head = NULL;
-static const char *INV_PATH = "/spiffs/inventory.json";
+static const char *INV_BIN_PATH = "/spiffs/inventory.bin";
+static const char *INV_BIN_TMP_PATH = "/spiffs/inventory.tmp";
+static const char *INV_PATH = "/spiffs/inventory.json"; // legacy snapshot, imported once then removed
+static const char *INV_LOG_PATH = "/spiffs/inventory.log";
+static int s_log_records = 0; // records appended since the last snapshot
+// the snapshot on flash could not be loaded for lack of memory: the store holds only part of it, so
+// inventory_save must not replace it (changes still go to the mutation log) until the next boot loads it
+static bool s_load_incomplete = false;
 
 // Maximum days we consider as a reasonable shelf life to
 // avoid absurd values from cloud parsing (e.g., year 3000).
 #define MAX_SHELF_LIFE_DAYS 365
 
+// Fold the mutation log back into the snapshot after this many records,
+// which bounds both replay time at boot and the size of the log file.
+#define INV_LOG_COMPACT_RECORDS 64
+
+// Sync events buffered per transaction before one sync_enqueue_batch() call
+#define INV_TXN_MAX_EVENTS 32
+
+static void log_add(const inventory_item_t *it);
+static void log_update(const inventory_item_t *it);
+static void log_delete(const char *item_id);
+static void txn_queue_event(const char *type, json_writer_t *ev);
+static void sync_item_state(const inventory_item_t *it);
+static void sync_item_removed(const inventory_item_t *it);
+static void txn_flush_events(void);
+static void txn_log_reset(void);
+
+// Transaction state (only touched while s_lock is held). Every public mutator runs
+// as a transaction; callers can widen it with inventory_txn_begin()/commit().
+static int s_txn_depth = 0;
+static bool s_txn_changed = false;    // fire the change callback on commit
+static char *s_txn_log = NULL;        // pending mutation log lines
+static size_t s_txn_log_len = 0;
+static size_t s_txn_log_cap = 0;
+static int s_txn_log_records = 0;
+static const char *s_txn_ev_types[INV_TXN_MAX_EVENTS];
+static char *s_txn_ev_payloads[INV_TXN_MAX_EVENTS];
+static int s_txn_ev_count = 0;
+
 // Simple id generator (timestamp + counter)
 static int s_id_counter = 0;
 const char *inventory_generate_id(void)
@@ -80,47 +122,531 @@ int inventory_compute_expiry(inventory_item_t *item)
     return item->remaining_days;
 }
 
+// ---- record store --------------------------------------------------------
+//
+// 条目存放在按块分配的槽位池（slab）里，删除后槽位挂回空闲链表复用，避免逐条 calloc/free 造成碎片。
+// s_live 是所有在用条目的紧凑数组，始终按过期时间升序排列（插入时二分定位），
+// 因此排序视图和“最先过期的 K 个”都无需 qsort 或额外分配；s_generation 在每次变更时递增。
+// 另有两张开放寻址哈希表，分别以 item_id 和规范化名称为键，查找/删除/去重都是 O(1)。
+
+#define INV_SLAB_ITEMS 32
+
+typedef struct {
+    inventory_item_t item; // must stay first: callers only ever see &slot->item
+    int live_idx;          // position in s_live, -1 while on the free list
+} inv_slot_t;
+
+typedef struct inv_slab_t {
+    struct inv_slab_t *next;
+    inv_slot_t slots[INV_SLAB_ITEMS];
+} inv_slab_t;
+
+typedef struct {
+    inv_slot_t **table;  // NULL = empty, INDEX_TOMBSTONE = deleted
+    uint32_t cap;        // power of two
+    uint32_t used;       // live entries + tombstones
+    uint32_t (*hash)(const char *key);
+    bool (*eq)(const char *a, const char *b);
+    const char *(*key)(const inventory_item_t *it);
+} inv_index_t;
+
+#define INDEX_TOMBSTONE ((inv_slot_t *)1)
+#define INDEX_MIN_CAP   32
+
+static inv_slab_t *s_slabs = NULL;
+static inv_slot_t *s_free = NULL; // free slots chained through item.next
+static inv_slot_t **s_live = NULL;
+static int s_live_count = 0;
+static int s_live_cap = 0;
+static uint32_t s_generation = 0;
+static void (*s_change_cb)(void) = NULL;
+
+static uint32_t str_hash(const char *s)
+{
+    uint32_t h = 2166136261u; // FNV-1a
+    while (*s) { h ^= (uint8_t)*s++; h *= 16777619u; }
+    return h;
+}
+
+static bool str_eq(const char *a, const char *b)
+{
+    return strcmp(a, b) == 0;
+}
+
+// 名称规范化：忽略 ASCII 空白、ASCII 大小写不敏感，中文字节原样比较
+static int norm_next(const char **p)
+{
+    while (**p && isspace((unsigned char)**p)) (*p)++;
+    if (!**p) return 0;
+    return tolower((unsigned char)*(*p)++);
+}
+
+static uint32_t norm_hash(const char *s)
+{
+    uint32_t h = 2166136261u;
+    int c;
+    while ((c = norm_next(&s)) != 0) { h ^= (uint8_t)c; h *= 16777619u; }
+    return h;
+}
+
+static bool norm_eq(const char *a, const char *b)
+{
+    int ca, cb;
+    do {
+        ca = norm_next(&a);
+        cb = norm_next(&b);
+        if (ca != cb) return false;
+    } while (ca);
+    return true;
+}
+
+static const char *key_item_id(const inventory_item_t *it) { return it->item_id; }
+static const char *key_name(const inventory_item_t *it) { return it->name; }
+
+static inv_index_t s_by_id = { .hash = str_hash, .eq = str_eq, .key = key_item_id };
+static inv_index_t s_by_name = { .hash = norm_hash, .eq = norm_eq, .key = key_name };
+
+static int index_rehash(inv_index_t *idx, uint32_t cap)
+{
+    inv_slot_t **table = calloc(cap, sizeof(inv_slot_t *));
+    if (!table) return -1;
+    for (uint32_t i = 0; i < idx->cap; ++i) {
+        inv_slot_t *sl = idx->table[i];
+        if (!sl || sl == INDEX_TOMBSTONE) continue;
+        uint32_t j = idx->hash(idx->key(&sl->item)) & (cap - 1);
+        while (table[j]) j = (j + 1) & (cap - 1);
+        table[j] = sl;
+    }
+    free(idx->table);
+    idx->table = table;
+    idx->cap = cap;
+    idx->used = s_live_count;
+    return 0;
+}
+
+// make room for one more entry; after this (and any index_remove) the next index_insert cannot fail
+static int index_reserve(inv_index_t *idx)
+{
+    // keep load (including tombstones) under 70%; grow only if live entries need it
+    if ((idx->used + 1) * 10 > idx->cap * 7) {
+        uint32_t cap = idx->cap ? idx->cap : INDEX_MIN_CAP;
+        while ((uint32_t)(s_live_count + 1) * 10 > cap * 5) cap <<= 1;
+        if (index_rehash(idx, cap) != 0) return -1;
+    }
+    return 0;
+}
+
+static int index_insert(inv_index_t *idx, inv_slot_t *sl)
+{
+    if (index_reserve(idx) != 0) return -1;
+    uint32_t mask = idx->cap - 1;
+    uint32_t i = idx->hash(idx->key(&sl->item)) & mask;
+    while (idx->table[i] && idx->table[i] != INDEX_TOMBSTONE) i = (i + 1) & mask;
+    if (!idx->table[i]) idx->used++;
+    idx->table[i] = sl;
+    return 0;
+}
+
+static void index_remove(inv_index_t *idx, inv_slot_t *sl)
+{
+    if (!idx->cap) return;
+    uint32_t mask = idx->cap - 1;
+    uint32_t i = idx->hash(idx->key(&sl->item)) & mask;
+    while (idx->table[i]) {
+        if (idx->table[i] == sl) { idx->table[i] = INDEX_TOMBSTONE; return; }
+        i = (i + 1) & mask;
+    }
+}
+
+static void index_clear(inv_index_t *idx)
+{
+    if (idx->table) memset(idx->table, 0, idx->cap * sizeof(inv_slot_t *));
+    idx->used = 0;
+}
+
+static inventory_item_t *find_by_id(const char *item_id)
+{
+    if (!item_id || item_id[0] == '\0' || !s_by_id.cap) return NULL;
+    uint32_t mask = s_by_id.cap - 1;
+    uint32_t i = str_hash(item_id) & mask;
+    while (s_by_id.table[i]) {
+        inv_slot_t *sl = s_by_id.table[i];
+        if (sl != INDEX_TOMBSTONE && strcmp(sl->item.item_id, item_id) == 0) return &sl->item;
+        i = (i + 1) & mask;
+    }
+    return NULL;
+}
+
+// exact (normalized) name match; with several batches of the same food, pick the one expiring first
+static inventory_item_t *find_by_name(const char *name)
+{
+    if (!name || !s_by_name.cap) return NULL;
+    inventory_item_t *best = NULL;
+    uint32_t mask = s_by_name.cap - 1;
+    uint32_t i = norm_hash(name) & mask;
+    while (s_by_name.table[i]) {
+        inv_slot_t *sl = s_by_name.table[i];
+        if (sl != INDEX_TOMBSTONE && norm_eq(sl->item.name, name)) {
+            if (!best || sl->item.calculated_expiry_date < best->calculated_expiry_date) best = &sl->item;
+        }
+        i = (i + 1) & mask;
+    }
+    return best;
+}
+
+// ---- strings -------------------------------------------------------------
+//
+// 类别/单位/位置的取值很少（"冷藏区"、"盒"、"蔬果"…），每个不同的字符串只在驻留池里存一份，条目只存指针。
+// 驻留池只增不减，字符串永不释放，因此快照和副本可以直接共享这些指针。
+// name/notes/photo_url 按实际长度连续存放在每条记录自己的一块堆内存里（起始地址即 name），
+// 条目本身因此只有约 100 字节，整块 slab 能放进内部 RAM 而不必落到 PSRAM。
+
+#define INTERN_BLOCK_SIZE 512
+
+typedef struct {
+    size_t used;
+    size_t cap;
+    char data[];
+} intern_block_t;
+
+static const char s_empty[] = "";
+static intern_block_t *s_intern_block = NULL; // current arena block; full blocks stay referenced by the table
+static const char **s_intern_table = NULL;    // open addressing, NULL = empty
+static uint32_t s_intern_cap = 0;
+static uint32_t s_intern_count = 0;
+
+#define STR_OR_EMPTY(s) ((s) ? (s) : s_empty)
+
+// returns the pooled copy of s ("" for NULL), or NULL on OOM; caller holds s_lock
+static const char *intern(const char *s)
+{
+    if (!s || !*s) return s_empty;
+    if ((s_intern_count + 1) * 10 > s_intern_cap * 7) {
+        uint32_t cap = s_intern_cap ? s_intern_cap * 2 : 32;
+        const char **table = calloc(cap, sizeof(*table));
+        if (!table) return NULL;
+        for (uint32_t i = 0; i < s_intern_cap; ++i) {
+            const char *e = s_intern_table[i];
+            if (!e) continue;
+            uint32_t j = str_hash(e) & (cap - 1);
+            while (table[j]) j = (j + 1) & (cap - 1);
+            table[j] = e;
+        }
+        free(s_intern_table);
+        s_intern_table = table;
+        s_intern_cap = cap;
+    }
+    uint32_t mask = s_intern_cap - 1;
+    uint32_t i = str_hash(s) & mask;
+    while (s_intern_table[i]) {
+        if (strcmp(s_intern_table[i], s) == 0) return s_intern_table[i];
+        i = (i + 1) & mask;
+    }
+    size_t n = strlen(s) + 1;
+    intern_block_t *b = s_intern_block;
+    if (!b || b->cap - b->used < n) {
+        size_t cap = n > INTERN_BLOCK_SIZE ? n : INTERN_BLOCK_SIZE;
+        b = malloc(sizeof(*b) + cap);
+        if (!b) return NULL;
+        b->used = 0;
+        b->cap = cap;
+        s_intern_block = b;
+    }
+    char *p = b->data + b->used;
+    memcpy(p, s, n);
+    b->used += n;
+    s_intern_table[i] = p;
+    s_intern_count++;
+    return p;
+}
+
+// bytes needed for the variable-length strings of it
+static size_t item_strings_len(const inventory_item_t *it)
+{
+    return strlen(STR_OR_EMPTY(it->name)) + strlen(STR_OR_EMPTY(it->notes)) +
+           strlen(STR_OR_EMPTY(it->photo_url)) + 3;
+}
+
+// copy src's variable-length strings to buf (name first) and point dst at them; returns the end of the copy
+static char *item_copy_strings(inventory_item_t *dst, const inventory_item_t *src, char *buf)
+{
+    const char *name = STR_OR_EMPTY(src->name);
+    const char *notes = STR_OR_EMPTY(src->notes);
+    const char *url = STR_OR_EMPTY(src->photo_url);
+    size_t n;
+    n = strlen(name) + 1;  memcpy(buf, name, n);  dst->name = buf;      buf += n;
+    n = strlen(notes) + 1; memcpy(buf, notes, n); dst->notes = buf;     buf += n;
+    n = strlen(url) + 1;   memcpy(buf, url, n);   dst->photo_url = buf; buf += n;
+    return buf;
+}
+
+// turn the borrowed strings of rec into storage owned by the record; -1 on OOM (rec untouched)
+static int item_own_strings(inventory_item_t *rec)
+{
+    const char *cat = intern(rec->category);
+    const char *unit = intern(rec->unit);
+    const char *loc = intern(rec->location);
+    if (!cat || !unit || !loc) return -1;
+    char *buf = malloc(item_strings_len(rec));
+    if (!buf) return -1;
+    item_copy_strings(rec, rec, buf);
+    rec->category = cat;
+    rec->unit = unit;
+    rec->location = loc;
+    return 0;
+}
+
+static inv_slot_t *slot_alloc(void)
+{
+    if (!s_free) {
+        inv_slab_t *slab = calloc(1, sizeof(inv_slab_t));
+        if (!slab) return NULL;
+        slab->next = s_slabs;
+        s_slabs = slab;
+        for (int i = INV_SLAB_ITEMS - 1; i >= 0; --i) {
+            slab->slots[i].live_idx = -1;
+            slab->slots[i].item.next = (inventory_item_t *)s_free;
+            s_free = &slab->slots[i];
+        }
+    }
+    inv_slot_t *sl = s_free;
+    s_free = (inv_slot_t *)sl->item.next;
+    return sl;
+}
+
+static void slot_release(inv_slot_t *sl)
+{
+    free((char *)sl->item.name); // the record's string block, NULL for a never-used slot
+    memset(&sl->item, 0, sizeof(sl->item));
+    sl->live_idx = -1;
+    sl->item.next = (inventory_item_t *)s_free;
+    s_free = sl;
+}
+
+// expiry order; item_id breaks ties so the order is total and stable across reloads
+static bool expires_before(const inventory_item_t *a, const inventory_item_t *b)
+{
+    if (a->calculated_expiry_date != b->calculated_expiry_date) {
+        return a->calculated_expiry_date < b->calculated_expiry_date;
+    }
+    return strcmp(a->item_id, b->item_id) < 0;
+}
+
+// caller guarantees s_live has room for one more entry
+static void live_insert(inv_slot_t *sl)
+{
+    int lo = 0, hi = s_live_count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (expires_before(&s_live[mid]->item, &sl->item)) lo = mid + 1;
+        else hi = mid;
+    }
+    memmove(&s_live[lo + 1], &s_live[lo], (s_live_count - lo) * sizeof(*s_live));
+    s_live[lo] = sl;
+    s_live_count++;
+    for (int i = lo; i < s_live_count; ++i) s_live[i]->live_idx = i;
+}
+
+static void live_remove(inv_slot_t *sl)
+{
+    int idx = sl->live_idx;
+    memmove(&s_live[idx], &s_live[idx + 1], (s_live_count - idx - 1) * sizeof(*s_live));
+    s_live_count--;
+    for (int i = idx; i < s_live_count; ++i) s_live[i]->live_idx = i;
+}
+
+// Insert a copy of src, or overwrite the existing record with the same item_id.
+// src's strings are only borrowed; the record gets its own copies.
+static inventory_item_t *store_upsert(const inventory_item_t *src)
+{
+    inventory_item_t rec = *src;
+    rec.next = NULL;
+    if (item_own_strings(&rec) != 0) return NULL;
+    inventory_item_t *existing = find_by_id(src->item_id);
+    if (existing) {
+        inv_slot_t *sl = (inv_slot_t *)existing;
+        // the name may change, so the record is re-inserted in the name index: grow it first, while a
+        // failure can still leave the old record untouched
+        if (index_reserve(&s_by_name) != 0) {
+            ESP_LOGE(TAG, "index insert failed (OOM)");
+            free((char *)rec.name);
+            return NULL;
+        }
+        index_remove(&s_by_name, sl);
+        live_remove(sl);
+        free((char *)sl->item.name);
+        sl->item = rec;
+        live_insert(sl);
+        index_insert(&s_by_name, sl); // cannot fail after index_reserve
+        s_generation++;
+        return &sl->item;
+    }
+    if (s_live_count == s_live_cap) {
+        int cap = s_live_cap ? s_live_cap * 2 : INV_SLAB_ITEMS;
+        inv_slot_t **nl = realloc(s_live, cap * sizeof(inv_slot_t *));
+        if (!nl) { free((char *)rec.name); return NULL; }
+        s_live = nl;
+        s_live_cap = cap;
+    }
+    inv_slot_t *sl = slot_alloc();
+    if (!sl) { free((char *)rec.name); return NULL; }
+    sl->item = rec;
+    if (index_insert(&s_by_id, sl) != 0 || index_insert(&s_by_name, sl) != 0) {
+        ESP_LOGE(TAG, "index insert failed (OOM)");
+        index_remove(&s_by_id, sl);
+        slot_release(sl);
+        return NULL;
+    }
+    live_insert(sl);
+    s_generation++;
+    return &sl->item;
+}
+
+static void store_remove(inventory_item_t *it)
+{
+    inv_slot_t *sl = (inv_slot_t *)it;
+    index_remove(&s_by_id, sl);
+    index_remove(&s_by_name, sl);
+    live_remove(sl);
+    slot_release(sl);
+    s_generation++;
+}
+
+static void store_clear(void)
+{
+    for (int i = 0; i < s_live_count; ++i) slot_release(s_live[i]);
+    s_live_count = 0;
+    index_clear(&s_by_id);
+    index_clear(&s_by_name);
+    s_generation++;
+}
+
+// ---- concurrency ---------------------------------------------------------
+//
+// 写者：所有修改都持有递归互斥锁 s_lock（递归是因为压缩日志时会在锁内调用 inventory_save）。
+// 读者：不碰活动数据，而是获取 s_snapshot —— 每次修改提交后重新发布的只读副本（RCU 风格）。
+// 获取/释放快照只在自旋锁里增减引用计数，不会等待写者的闪存 I/O；旧快照在最后一个读者释放后才 free。
+
+static SemaphoreHandle_t s_lock = NULL;
+static inventory_snapshot_t *s_snapshot = NULL;
+static portMUX_TYPE s_snap_mux = portMUX_INITIALIZER_UNLOCKED;
+
+#define INV_LOCK()   xSemaphoreTakeRecursive(s_lock, portMAX_DELAY)
+#define INV_UNLOCK() xSemaphoreGiveRecursive(s_lock)
+
+static void snapshot_unref(inventory_snapshot_t *snap)
+{
+    if (!snap) return;
+    portENTER_CRITICAL(&s_snap_mux);
+    bool last = (--snap->refs == 0);
+    portEXIT_CRITICAL(&s_snap_mux);
+    if (last) free(snap);
+}
+
+// Build and publish a new snapshot from the live store; caller holds s_lock.
+static void publish_snapshot(void)
+{
+    if (s_snapshot && s_snapshot->generation == s_generation) return;
+    // one block: header, item copies, then their variable-length strings (interned ones are shared)
+    size_t strs = 0;
+    for (int i = 0; i < s_live_count; ++i) strs += item_strings_len(&s_live[i]->item);
+    inventory_snapshot_t *snap = malloc(sizeof(*snap) + (size_t)s_live_count * sizeof(inventory_item_t) + strs);
+    if (!snap) {
+        ESP_LOGE(TAG, "snapshot OOM, readers keep generation %u", s_snapshot ? (unsigned)s_snapshot->generation : 0u);
+        return;
+    }
+    inventory_item_t *items = (inventory_item_t *)(snap + 1);
+    char *buf = (char *)(items + s_live_count);
+    for (int i = 0; i < s_live_count; ++i) {
+        items[i] = s_live[i]->item;
+        buf = item_copy_strings(&items[i], &s_live[i]->item, buf);
+        items[i].next = (i + 1 < s_live_count) ? &items[i + 1] : NULL;
+    }
+    snap->generation = s_generation;
+    snap->count = s_live_count;
+    snap->items = items;
+    snap->refs = 1; // reference held by s_snapshot itself
+
+    portENTER_CRITICAL(&s_snap_mux);
+    inventory_snapshot_t *old = s_snapshot;
+    s_snapshot = snap;
+    portEXIT_CRITICAL(&s_snap_mux);
+    snapshot_unref(old);
+}
+
+const inventory_snapshot_t *inventory_snapshot_acquire(void)
+{
+    portENTER_CRITICAL(&s_snap_mux);
+    inventory_snapshot_t *snap = s_snapshot;
+    if (snap) snap->refs++;
+    portEXIT_CRITICAL(&s_snap_mux);
+    return snap;
+}
+
+void inventory_snapshot_release(const inventory_snapshot_t *snap)
+{
+    snapshot_unref((inventory_snapshot_t *)snap);
+}
+
+void inventory_set_change_cb(void (*cb)(void))
+{
+    s_change_cb = cb;
+}
+
+static void fire_change_cb(void)
+{
+    if (s_change_cb) s_change_cb();
+}
+
+int inventory_days_left(const inventory_item_t *item)
+{
+    if (!item) return 0;
+    double diff_sec = difftime((time_t)item->calculated_expiry_date, time(NULL));
+    if (diff_sec <= 0) return 0;
+    int days = (int)ceil(diff_sec / (24.0 * 3600.0));
+    return days > MAX_SHELF_LIFE_DAYS ? MAX_SHELF_LIFE_DAYS : days;
+}
+
 void inventory_init(void)
 {
+    if (!s_lock) s_lock = xSemaphoreCreateRecursiveMutex();
+    configASSERT(s_lock);
     inventory_load();
 }
 
 int inventory_add_item(const inventory_item_t *item)
 {
     if (!item) return -1;
-    inventory_item_t *n = calloc(1, sizeof(inventory_item_t));
-    if (!n) return -1;
-    memcpy(n, item, sizeof(inventory_item_t));
-    // ensure id
-    if (n->item_id[0] == '\0') {
-        strncpy(n->item_id, inventory_generate_id(), sizeof(n->item_id)-1);
-    }
-    if (n->added_time == 0) n->added_time = time(NULL);
-    if (n->default_shelf_life_days == 0) n->default_shelf_life_days = category_default_days(n->category);
-    n->last_notified_remaining_days = -1;
-    inventory_compute_expiry(n);
-    n->next = g_head;
-    g_head = n;
+    inventory_item_t tmp;
+    memcpy(&tmp, item, sizeof(tmp));
+    // ensure id; a record with a known id replaces the existing one instead of duplicating it
+    if (tmp.item_id[0] == '\0') {
+        strncpy(tmp.item_id, inventory_generate_id(), sizeof(tmp.item_id)-1);
+    }
+    if (tmp.added_time == 0) tmp.added_time = time(NULL);
+    if (tmp.default_shelf_life_days == 0) tmp.default_shelf_life_days = category_default_days(tmp.category);
+    tmp.last_notified_remaining_days = -1;
+    inventory_compute_expiry(&tmp);
+    inventory_txn_begin();
+    inventory_item_t *prev = find_by_id(tmp.item_id);
+    tmp.version = prev ? prev->version + 1 : 1;
+    tmp.updated_time = time(NULL);
+    inventory_item_t *n = store_upsert(&tmp);
+    if (!n) { inventory_txn_commit(); return -1; }
     ESP_LOGI(TAG, "Added item: %s qty:%d %s loc:%s remaining:%d", n->name, n->quantity, n->unit, n->location, n->remaining_days);
-    inventory_save();
-    // enqueue sync event
-    cJSON *ev = cJSON_CreateObject();
-    cJSON_AddStringToObject(ev, "item_id", n->item_id);
-    cJSON_AddStringToObject(ev, "action", "add_item");
-    cJSON_AddStringToObject(ev, "name", n->name);
-    cJSON_AddNumberToObject(ev, "quantity", n->quantity);
-    cJSON_AddStringToObject(ev, "location", n->location);
-    char *s = cJSON_PrintUnformatted(ev);
-    if (s) { sync_enqueue_event("add_item", s); free(s); }
-    cJSON_Delete(ev);
+    log_add(n);
+    sync_item_state(n);
+    s_txn_changed = true;
+    inventory_txn_commit();
     return 0;
 }
 
 int inventory_add_item_from_text(const char *text)
 {
     inventory_item_t tmp;
+    parse_strings_t strs;
     memset(&tmp, 0, sizeof(tmp));
-    if (parse_add_command(text, &tmp) == 0) {
+    if (parse_add_command(text, &tmp, &strs) == 0) {
         if (tmp.added_time == 0) tmp.added_time = time(NULL);
         if (tmp.default_shelf_life_days == 0) tmp.default_shelf_life_days = category_default_days(tmp.category);
         return inventory_add_item(&tmp);
@@ -129,175 +655,959 @@ int inventory_add_item_from_text(const char *text)
     return -1;
 }
 
-void inventory_save(void)
+// ---- persistence -------------------------------------------------------
+//
+// inventory.bin 是完整快照（二进制格式见下）；每次变更只向 inventory.log 追加一行 JSON 记录：
+//   {"op":"add","item":{...}}                 新增（或覆盖同 item_id 的条目）
+//   {"op":"upd","item_id":"..","quantity":n,"last_notified_remaining_days":m}
+//   {"op":"del","item_id":".."}
+// 记录数达到 INV_LOG_COMPACT_RECORDS 后把当前内存状态写回快照并清空日志。
+// 所有记录都是幂等的，因此快照写完但日志未删除时重放也不会产生重复条目。
+
+static void item_write_json(json_writer_t *w, const inventory_item_t *it)
 {
-    cJSON *arr = cJSON_CreateArray();
-    inventory_item_t *it = g_head;
-    while (it) {
-        cJSON *o = cJSON_CreateObject();
-        cJSON_AddStringToObject(o, "item_id", it->item_id);
-        cJSON_AddStringToObject(o, "name", it->name);
-        cJSON_AddStringToObject(o, "category", it->category);
-        cJSON_AddStringToObject(o, "location", it->location);
-        cJSON_AddStringToObject(o, "unit", it->unit);
-        cJSON_AddNumberToObject(o, "quantity", it->quantity);
-        cJSON_AddNumberToObject(o, "added_time", (double)it->added_time);
-        cJSON_AddNumberToObject(o, "default_shelf_life_days", it->default_shelf_life_days);
-        cJSON_AddNumberToObject(o, "calculated_expiry_date", (double)it->calculated_expiry_date);
-        cJSON_AddNumberToObject(o, "remaining_days", it->remaining_days);
-        cJSON_AddNumberToObject(o, "last_notified_remaining_days", it->last_notified_remaining_days);
-        cJSON_AddStringToObject(o, "notes", it->notes);
-        cJSON_AddStringToObject(o, "photo_url", it->photo_url);
-        cJSON_AddItemToArray(arr, o);
-        it = it->next;
-    }
-    char *s = cJSON_PrintUnformatted(arr);
-    if (s) {
-        storage_write_file(INV_PATH, s);
-        free(s);
-    }
-    cJSON_Delete(arr);
+    json_w_obj_begin(w);
+    json_w_kv_str(w, "item_id", it->item_id);
+    json_w_kv_str(w, "name", it->name);
+    json_w_kv_str(w, "category", it->category);
+    json_w_kv_str(w, "location", it->location);
+    json_w_kv_str(w, "unit", it->unit);
+    json_w_kv_int(w, "quantity", it->quantity);
+    json_w_kv_int(w, "added_time", it->added_time);
+    json_w_kv_int(w, "default_shelf_life_days", it->default_shelf_life_days);
+    json_w_kv_int(w, "calculated_expiry_date", it->calculated_expiry_date);
+    json_w_kv_int(w, "remaining_days", it->remaining_days);
+    json_w_kv_int(w, "last_notified_remaining_days", it->last_notified_remaining_days);
+    json_w_kv_str(w, "notes", it->notes);
+    json_w_kv_str(w, "photo_url", it->photo_url);
+    json_w_kv_int(w, "version", it->version);
+    json_w_kv_int(w, "updated_time", it->updated_time);
+    json_w_obj_end(w);
 }
 
-void inventory_load(void)
+// string fields of it borrow from o, so o must outlive the store_upsert() of it
+static void item_from_json(const cJSON *o, inventory_item_t *it)
 {
-    char *s = storage_read_file(INV_PATH);
-    if (!s) return;
-    cJSON *arr = cJSON_Parse(s);
+    cJSON *v;
+    v = cJSON_GetObjectItem(o, "item_id"); if (v && cJSON_IsString(v)) strncpy(it->item_id, v->valuestring, sizeof(it->item_id)-1);
+    v = cJSON_GetObjectItem(o, "name"); if (v && cJSON_IsString(v)) it->name = v->valuestring;
+    v = cJSON_GetObjectItem(o, "category"); if (v && cJSON_IsString(v)) it->category = v->valuestring;
+    v = cJSON_GetObjectItem(o, "location"); if (v && cJSON_IsString(v)) it->location = v->valuestring;
+    v = cJSON_GetObjectItem(o, "unit"); if (v && cJSON_IsString(v)) it->unit = v->valuestring;
+    v = cJSON_GetObjectItem(o, "quantity"); if (v && cJSON_IsNumber(v)) it->quantity = v->valueint;
+    v = cJSON_GetObjectItem(o, "added_time"); if (v && cJSON_IsNumber(v)) it->added_time = (int64_t)v->valuedouble;
+    v = cJSON_GetObjectItem(o, "default_shelf_life_days"); if (v && cJSON_IsNumber(v)) it->default_shelf_life_days = v->valueint;
+    v = cJSON_GetObjectItem(o, "calculated_expiry_date"); if (v && cJSON_IsNumber(v)) it->calculated_expiry_date = (int64_t)v->valuedouble;
+    v = cJSON_GetObjectItem(o, "remaining_days"); if (v && cJSON_IsNumber(v)) it->remaining_days = v->valueint;
+    v = cJSON_GetObjectItem(o, "last_notified_remaining_days"); if (v && cJSON_IsNumber(v)) it->last_notified_remaining_days = v->valueint; else it->last_notified_remaining_days = -1;
+    v = cJSON_GetObjectItem(o, "notes"); if (v && cJSON_IsString(v)) it->notes = v->valuestring;
+    v = cJSON_GetObjectItem(o, "photo_url"); if (v && cJSON_IsString(v)) it->photo_url = v->valuestring;
+    v = cJSON_GetObjectItem(o, "version"); if (v && cJSON_IsNumber(v)) it->version = (uint32_t)v->valuedouble;
+    v = cJSON_GetObjectItem(o, "updated_time"); if (v && cJSON_IsNumber(v)) it->updated_time = (int64_t)v->valuedouble;
+}
+
+// Buffer one record for the current transaction; inventory_txn_commit() writes the
+// whole batch with a single append (or folds it into a snapshot)
+static void log_append(json_writer_t *rec)
+{
+    char *s = json_writer_take(rec);
+    if (!s) { inventory_save(); return; }
+    size_t len = strlen(s);
+    if (s_txn_log_len + len + 2 > s_txn_log_cap) {
+        size_t cap = s_txn_log_cap ? s_txn_log_cap : 512;
+        while (s_txn_log_len + len + 2 > cap) cap *= 2;
+        char *nb = realloc(s_txn_log, cap);
+        if (!nb) {
+            // out of memory: a full snapshot captures this change (and drops the pending batch)
+            free(s);
+            inventory_save();
+            return;
+        }
+        s_txn_log = nb;
+        s_txn_log_cap = cap;
+    }
+    memcpy(s_txn_log + s_txn_log_len, s, len);
+    s_txn_log_len += len;
+    s_txn_log[s_txn_log_len++] = '\n';
+    s_txn_log[s_txn_log_len] = '\0';
+    s_txn_log_records++;
     free(s);
-    if (!arr) return;
-    if (!cJSON_IsArray(arr)) { cJSON_Delete(arr); return; }
-    size_t n = cJSON_GetArraySize(arr);
-    for (size_t i = 0; i < n; ++i) {
-        cJSON *o = cJSON_GetArrayItem(arr, i);
-        if (!cJSON_IsObject(o)) continue;
-        inventory_item_t *it = calloc(1, sizeof(inventory_item_t));
+}
+
+static void txn_log_reset(void)
+{
+    s_txn_log_len = 0;
+    s_txn_log_records = 0;
+    // keep a small buffer around for the next command, drop anything large
+    if (s_txn_log_cap > 4096) {
+        free(s_txn_log);
+        s_txn_log = NULL;
+        s_txn_log_cap = 0;
+    }
+}
+
+static void txn_log_flush(void)
+{
+    if (s_txn_log_records == 0) return;
+    if (s_log_records + s_txn_log_records >= INV_LOG_COMPACT_RECORDS && !s_load_incomplete) {
+        ESP_LOGI(TAG, "compacting mutation log (%d records)", s_log_records + s_txn_log_records);
+        inventory_save();
+    } else if (storage_append_file(INV_LOG_PATH, s_txn_log) == 0) {
+        s_log_records += s_txn_log_records;
+    } else {
+        // append failed: fall back to a full snapshot so the change is not lost
+        ESP_LOGW(TAG, "log append failed, writing snapshot");
+        inventory_save();
+    }
+    txn_log_reset();
+}
+
+// Queue a sync event; events of one transaction reach the sync queue in a single write
+// Sync events carry the item's current state, so the queue can fold an item's events into the
+// last one: add_item is an upsert of the item, remove_item deletes it (see sync.c compaction).
+// version/updated_time let the server (and other devices pulling from it) resolve conflicts
+static void sync_item_state(const inventory_item_t *it)
+{
+    json_writer_t ev;
+    json_writer_init_mem(&ev);
+    json_w_obj_begin(&ev);
+    json_w_kv_str(&ev, "item_id", it->item_id);
+    json_w_kv_str(&ev, "action", "add_item");
+    json_w_kv_str(&ev, "name", it->name);
+    json_w_kv_int(&ev, "quantity", it->quantity);
+    json_w_kv_str(&ev, "location", it->location);
+    json_w_kv_str(&ev, "category", it->category);
+    json_w_kv_str(&ev, "unit", it->unit);
+    json_w_kv_int(&ev, "added_time", it->added_time);
+    json_w_kv_int(&ev, "default_shelf_life_days", it->default_shelf_life_days);
+    json_w_kv_int(&ev, "version", it->version);
+    json_w_kv_int(&ev, "updated_time", it->updated_time);
+    json_w_obj_end(&ev);
+    txn_queue_event("add_item", &ev);
+}
+
+// the deletion is the item's next version
+static void sync_item_removed(const inventory_item_t *it)
+{
+    json_writer_t ev;
+    json_writer_init_mem(&ev);
+    json_w_obj_begin(&ev);
+    json_w_kv_str(&ev, "item_id", it->item_id);
+    json_w_kv_str(&ev, "action", "remove_item");
+    json_w_kv_int(&ev, "version", it->version + 1);
+    json_w_kv_int(&ev, "updated_time", time(NULL));
+    json_w_obj_end(&ev);
+    txn_queue_event("remove_item", &ev);
+}
+
+static void txn_queue_event(const char *type, json_writer_t *ev)
+{
+    char *s = json_writer_take(ev);
+    if (!s) return;
+    if (s_txn_ev_count == INV_TXN_MAX_EVENTS) txn_flush_events();
+    s_txn_ev_types[s_txn_ev_count] = type;
+    s_txn_ev_payloads[s_txn_ev_count] = s;
+    s_txn_ev_count++;
+}
+
+static void txn_flush_events(void)
+{
+    if (s_txn_ev_count == 0) return;
+    sync_enqueue_batch(s_txn_ev_types, (const char *const *)s_txn_ev_payloads, s_txn_ev_count);
+    for (int i = 0; i < s_txn_ev_count; ++i) free(s_txn_ev_payloads[i]);
+    s_txn_ev_count = 0;
+}
+
+void inventory_txn_begin(void)
+{
+    INV_LOCK();
+    s_txn_depth++;
+}
+
+void inventory_txn_commit(void)
+{
+    if (s_txn_depth <= 0) return;
+    if (--s_txn_depth > 0) {
+        INV_UNLOCK();
+        return;
+    }
+    uint32_t trace = cmd_trace_current(); // 语音命令触发的写入计入该命令的 store 阶段
+    cmd_trace_span_begin(trace, CMD_TRACE_STORE);
+    txn_log_flush();
+    cmd_trace_span_end(trace, CMD_TRACE_STORE);
+    txn_flush_events();
+    publish_snapshot();
+    bool changed = s_txn_changed;
+    s_txn_changed = false;
+    INV_UNLOCK();
+    if (changed) fire_change_cb();
+}
+
+static void log_add(const inventory_item_t *it)
+{
+    json_writer_t w;
+    json_writer_init_mem(&w);
+    json_w_obj_begin(&w);
+    json_w_kv_str(&w, "op", "add");
+    json_w_key(&w, "item");
+    item_write_json(&w, it);
+    json_w_obj_end(&w);
+    log_append(&w);
+}
+
+static void log_update(const inventory_item_t *it)
+{
+    json_writer_t w;
+    json_writer_init_mem(&w);
+    json_w_obj_begin(&w);
+    json_w_kv_str(&w, "op", "upd");
+    json_w_kv_str(&w, "item_id", it->item_id);
+    json_w_kv_int(&w, "quantity", it->quantity);
+    json_w_kv_int(&w, "last_notified_remaining_days", it->last_notified_remaining_days);
+    json_w_kv_int(&w, "version", it->version);
+    json_w_kv_int(&w, "updated_time", it->updated_time);
+    json_w_obj_end(&w);
+    log_append(&w);
+}
+
+static void log_delete(const char *item_id)
+{
+    json_writer_t w;
+    json_writer_init_mem(&w);
+    json_w_obj_begin(&w);
+    json_w_kv_str(&w, "op", "del");
+    json_w_kv_str(&w, "item_id", item_id);
+    json_w_obj_end(&w);
+    log_append(&w);
+}
+
+// apply one log record to the in-memory list; returns 0 if the record was understood
+static int replay_record(const cJSON *rec)
+{
+    cJSON *op = cJSON_GetObjectItem(rec, "op");
+    if (!op || !cJSON_IsString(op)) return -1;
+    if (strcmp(op->valuestring, "add") == 0) {
+        cJSON *o = cJSON_GetObjectItem(rec, "item");
+        if (!cJSON_IsObject(o)) return -1;
+        inventory_item_t tmp;
+        memset(&tmp, 0, sizeof(tmp));
+        item_from_json(o, &tmp);
+        inventory_compute_expiry(&tmp);
+        return store_upsert(&tmp) ? 0 : -1;
+    }
+    cJSON *id = cJSON_GetObjectItem(rec, "item_id");
+    if (!id || !cJSON_IsString(id)) return -1;
+    inventory_item_t *it = find_by_id(id->valuestring);
+    if (strcmp(op->valuestring, "del") == 0) {
+        if (it) store_remove(it);
+        return 0;
+    }
+    if (strcmp(op->valuestring, "upd") == 0) {
+        if (!it) return 0;
         cJSON *v;
-        v = cJSON_GetObjectItem(o, "item_id"); if (v && cJSON_IsString(v)) strncpy(it->item_id, v->valuestring, sizeof(it->item_id)-1);
-        v = cJSON_GetObjectItem(o, "name"); if (v && cJSON_IsString(v)) strncpy(it->name, v->valuestring, sizeof(it->name)-1);
-        v = cJSON_GetObjectItem(o, "category"); if (v && cJSON_IsString(v)) strncpy(it->category, v->valuestring, sizeof(it->category)-1);
-        v = cJSON_GetObjectItem(o, "location"); if (v && cJSON_IsString(v)) strncpy(it->location, v->valuestring, sizeof(it->location)-1);
-        v = cJSON_GetObjectItem(o, "unit"); if (v && cJSON_IsString(v)) strncpy(it->unit, v->valuestring, sizeof(it->unit)-1);
-        v = cJSON_GetObjectItem(o, "quantity"); if (v && cJSON_IsNumber(v)) it->quantity = v->valueint;
-        v = cJSON_GetObjectItem(o, "added_time"); if (v && cJSON_IsNumber(v)) it->added_time = (int64_t)v->valuedouble;
-        v = cJSON_GetObjectItem(o, "default_shelf_life_days"); if (v && cJSON_IsNumber(v)) it->default_shelf_life_days = v->valueint;
-        v = cJSON_GetObjectItem(o, "calculated_expiry_date"); if (v && cJSON_IsNumber(v)) it->calculated_expiry_date = (int64_t)v->valuedouble;
-        v = cJSON_GetObjectItem(o, "remaining_days"); if (v && cJSON_IsNumber(v)) it->remaining_days = v->valueint;
-        v = cJSON_GetObjectItem(o, "last_notified_remaining_days"); if (v && cJSON_IsNumber(v)) it->last_notified_remaining_days = v->valueint; else it->last_notified_remaining_days = -1;
-        v = cJSON_GetObjectItem(o, "notes"); if (v && cJSON_IsString(v)) strncpy(it->notes, v->valuestring, sizeof(it->notes)-1);
-        v = cJSON_GetObjectItem(o, "photo_url"); if (v && cJSON_IsString(v)) strncpy(it->photo_url, v->valuestring, sizeof(it->photo_url)-1);
-        // ensure computed fields
-        inventory_compute_expiry(it);
-        it->next = g_head;
-        g_head = it;
-    }
-    cJSON_Delete(arr);
+        v = cJSON_GetObjectItem(rec, "quantity"); if (v && cJSON_IsNumber(v)) it->quantity = v->valueint;
+        v = cJSON_GetObjectItem(rec, "last_notified_remaining_days"); if (v && cJSON_IsNumber(v)) it->last_notified_remaining_days = v->valueint;
+        v = cJSON_GetObjectItem(rec, "version"); if (v && cJSON_IsNumber(v)) it->version = (uint32_t)v->valuedouble;
+        v = cJSON_GetObjectItem(rec, "updated_time"); if (v && cJSON_IsNumber(v)) it->updated_time = (int64_t)v->valuedouble;
+        return 0;
+    }
+    return -1;
+}
+
+static void log_replay(void)
+{
+    char *s = storage_read_file(INV_LOG_PATH);
+    if (!s) return;
+    size_t len = strlen(s);
+    if (len && s[len - 1] != '\n') {
+        // 最后一行没有换行符：说明追加时掉电，记录不完整，丢弃。
+        // 同时把它从文件里截掉，否则下一条追加会接在这半行后面，和它一起被当作坏记录丢掉
+        ESP_LOGW(TAG, "dropping torn log tail");
+        char *end = strrchr(s, '\n');
+        len = end ? (size_t)(end + 1 - s) : 0;
+        s[len] = '\0';
+        if (len) storage_write_file(INV_LOG_PATH, s);
+        else storage_remove_file(INV_LOG_PATH);
+    }
+    int applied = 0;
+    char *line = s;
+    while (line && *line) {
+        char *nl = strchr(line, '\n');
+        *nl = '\0';
+        cJSON *rec = cJSON_Parse(line);
+        if (rec) {
+            if (replay_record(rec) == 0) applied++;
+            cJSON_Delete(rec);
+        } else {
+            ESP_LOGW(TAG, "skipping corrupt log record");
+        }
+        line = nl + 1;
+    }
+    free(s);
+    s_log_records = applied;
+    ESP_LOGI(TAG, "replayed %d log records", applied);
+    if (s_log_records >= INV_LOG_COMPACT_RECORDS) inventory_save();
+}
+
+// ---- binary snapshot ---------------------------------------------------
+//
+// 布局: header | record[record_count] | string table[strtab_size]
+// 字符串以 '\0' 结尾存放在字符串表中，record 只保存偏移；相同字符串（类别/单位/位置）只存一份。
+// header 和每条 record 各带一个 CRC32；record 的 CRC 同时覆盖它引用的字符串，
+// 因此单条损坏只丢弃该条，不影响其余库存。
+// 后来加入的字段（同步版本号等）作为扩展追加在 record 的 CRC 之后、带自己的 CRC，header.record_size
+// 随之变大；旧固件按 record_size 跳过扩展仍能读取，新固件读到没有扩展的旧文件时这些字段取 0。
+
+#define INV_BIN_MAGIC   0x42564E49u // "INVB"
+#define INV_BIN_VERSION 1
+#define INV_BIN_NSTR    7
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t record_size;   // allows newer readers to skip appended fields
+    uint32_t record_count;
+    uint32_t strtab_size;
+    uint32_t crc;           // CRC32 of the fields above
+} inv_bin_header_t;
+
+typedef struct __attribute__((packed)) {
+    int64_t added_time;
+    int64_t calculated_expiry_date;
+    int32_t quantity;
+    int32_t default_shelf_life_days;
+    int32_t last_notified_remaining_days;
+    uint32_t str[INV_BIN_NSTR]; // item_id, name, category, unit, location, notes, photo_url
+    uint32_t crc;               // CRC32 of the fields above plus the referenced strings
+} inv_bin_record_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t version;
+    int64_t updated_time;
+    uint32_t crc;               // CRC32 of the extension fields above
+} inv_bin_record_ext_t;
+
+_Static_assert(sizeof(inv_bin_header_t) == 20, "inventory.bin header layout changed");
+_Static_assert(sizeof(inv_bin_record_t) == 60, "inventory.bin record layout changed");
+_Static_assert(sizeof(inv_bin_record_ext_t) == 16, "inventory.bin record extension layout changed");
+
+typedef struct {
+    char *buf;
+    uint32_t len;
+    uint32_t cap;
+    uint32_t *slots; // open-addressing dedup table, stores offset+1 (0 = empty)
+    uint32_t nslots;
+} strtab_t;
+
+static void item_string_fields(const inventory_item_t *it, const char *fields[INV_BIN_NSTR])
+{
+    fields[0] = it->item_id;
+    fields[1] = it->name;
+    fields[2] = it->category;
+    fields[3] = it->unit;
+    fields[4] = it->location;
+    fields[5] = it->notes;
+    fields[6] = it->photo_url;
+}
+
+// the strings stay borrowed from fields until store_upsert() copies them
+static void item_set_string_fields(inventory_item_t *it, const char *fields[INV_BIN_NSTR])
+{
+    strncpy(it->item_id, fields[0], sizeof(it->item_id)-1);
+    it->name = fields[1];
+    it->category = fields[2];
+    it->unit = fields[3];
+    it->location = fields[4];
+    it->notes = fields[5];
+    it->photo_url = fields[6];
+}
+
+static int strtab_init(strtab_t *t, uint32_t nstrings)
+{
+    memset(t, 0, sizeof(*t));
+    t->nslots = 16;
+    while (t->nslots < nstrings * 2) t->nslots <<= 1;
+    t->slots = calloc(t->nslots, sizeof(uint32_t));
+    t->cap = 256;
+    t->buf = malloc(t->cap);
+    if (!t->slots || !t->buf) { free(t->slots); free(t->buf); return -1; }
+    t->buf[0] = '\0'; // offset 0 is the shared empty string
+    t->len = 1;
+    return 0;
+}
+
+static void strtab_free(strtab_t *t)
+{
+    free(t->slots);
+    free(t->buf);
+}
+
+// returns offset of s in the table, or UINT32_MAX on OOM
+static uint32_t strtab_put(strtab_t *t, const char *s)
+{
+    if (s[0] == '\0') return 0;
+    uint32_t mask = t->nslots - 1;
+    uint32_t i = str_hash(s) & mask;
+    while (t->slots[i]) {
+        uint32_t off = t->slots[i] - 1;
+        if (strcmp(t->buf + off, s) == 0) return off;
+        i = (i + 1) & mask;
+    }
+    size_t n = strlen(s) + 1;
+    if (t->len + n > t->cap) {
+        uint32_t cap = t->cap;
+        while (t->len + n > cap) cap *= 2;
+        char *nb = realloc(t->buf, cap);
+        if (!nb) return UINT32_MAX;
+        t->buf = nb;
+        t->cap = cap;
+    }
+    uint32_t off = t->len;
+    memcpy(t->buf + off, s, n);
+    t->len += n;
+    t->slots[i] = off + 1;
+    return off;
+}
+
+static uint32_t record_crc(const inv_bin_record_t *r, const char *strtab)
+{
+    uint32_t crc = esp_rom_crc32_le(0, (const uint8_t *)r, offsetof(inv_bin_record_t, crc));
+    for (int i = 0; i < INV_BIN_NSTR; ++i) {
+        const char *str = strtab + r->str[i];
+        crc = esp_rom_crc32_le(crc, (const uint8_t *)str, strlen(str) + 1);
+    }
+    return crc;
+}
+
+static int bin_write(const char *path)
+{
+    uint32_t count = (uint32_t)s_live_count;
+
+    strtab_t st;
+    if (strtab_init(&st, count * INV_BIN_NSTR) != 0) return -1;
+    FILE *f = fopen(path, "wb");
+    if (!f) { strtab_free(&st); return -1; }
+
+    inv_bin_header_t hdr = {
+        .magic = INV_BIN_MAGIC,
+        .version = INV_BIN_VERSION,
+        .record_size = sizeof(inv_bin_record_t) + sizeof(inv_bin_record_ext_t),
+        .record_count = count,
+    };
+    int rc = (fwrite(&hdr, sizeof(hdr), 1, f) == 1) ? 0 : -1;
+
+    for (int n = 0; n < s_live_count && rc == 0; ++n) {
+        inventory_item_t *it = &s_live[n]->item;
+        inv_bin_record_t r = {
+            .added_time = it->added_time,
+            .calculated_expiry_date = it->calculated_expiry_date,
+            .quantity = it->quantity,
+            .default_shelf_life_days = it->default_shelf_life_days,
+            .last_notified_remaining_days = it->last_notified_remaining_days,
+        };
+        const char *fields[INV_BIN_NSTR];
+        item_string_fields(it, fields);
+        for (int i = 0; i < INV_BIN_NSTR; ++i) {
+            r.str[i] = strtab_put(&st, fields[i]);
+            if (r.str[i] == UINT32_MAX) { rc = -1; break; }
+        }
+        if (rc != 0) break;
+        r.crc = record_crc(&r, st.buf);
+        inv_bin_record_ext_t ext = { .version = it->version, .updated_time = it->updated_time };
+        ext.crc = esp_rom_crc32_le(0, (const uint8_t *)&ext, offsetof(inv_bin_record_ext_t, crc));
+        if (fwrite(&r, sizeof(r), 1, f) != 1 || fwrite(&ext, sizeof(ext), 1, f) != 1) rc = -1;
+    }
+
+    if (rc == 0 && fwrite(st.buf, 1, st.len, f) != st.len) rc = -1;
+    if (rc == 0) {
+        hdr.strtab_size = st.len;
+        hdr.crc = esp_rom_crc32_le(0, (const uint8_t *)&hdr, offsetof(inv_bin_header_t, crc));
+        if (fseek(f, 0, SEEK_SET) != 0 || fwrite(&hdr, sizeof(hdr), 1, f) != 1) rc = -1;
+    }
+    if (fclose(f) != 0) rc = -1;
+    strtab_free(&st);
+    return rc;
+}
+
+// Load a binary snapshot; returns number of items loaded, -1 if the file is missing/invalid, or -2 if it ran out
+// of memory part way (the records loaded so far stay in the store)
+static int bin_load(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) return -1;
+    inv_bin_header_t hdr;
+    if (fread(&hdr, sizeof(hdr), 1, f) != 1 ||
+        hdr.magic != INV_BIN_MAGIC ||
+        hdr.crc != esp_rom_crc32_le(0, (const uint8_t *)&hdr, offsetof(inv_bin_header_t, crc)) ||
+        hdr.version != INV_BIN_VERSION ||
+        hdr.record_size < sizeof(inv_bin_record_t) ||
+        hdr.strtab_size == 0) {
+        ESP_LOGW(TAG, "%s: bad header", path);
+        fclose(f);
+        return -1;
+    }
+
+    // string table lives after the records; it is the only allocation proportional to file size
+    long records_end = (long)sizeof(hdr) + (long)hdr.record_count * hdr.record_size;
+    char *strtab = malloc(hdr.strtab_size + 1);
+    if (!strtab) {
+        ESP_LOGE(TAG, "%s: no memory for the string table (%u bytes)", path, (unsigned)hdr.strtab_size);
+        fclose(f);
+        return -2;
+    }
+    if (fseek(f, records_end, SEEK_SET) != 0 ||
+        fread(strtab, 1, hdr.strtab_size, f) != hdr.strtab_size) {
+        ESP_LOGW(TAG, "%s: truncated string table", path);
+        free(strtab);
+        fclose(f);
+        return -1;
+    }
+    strtab[hdr.strtab_size] = '\0';
+    fseek(f, sizeof(hdr), SEEK_SET);
+
+    int loaded = 0;
+    for (uint32_t n = 0; n < hdr.record_count; ++n) {
+        inv_bin_record_t r;
+        inv_bin_record_ext_t ext = { 0 };
+        if (fread(&r, sizeof(r), 1, f) != 1) break;
+        size_t extra = hdr.record_size - sizeof(r);
+        if (extra >= sizeof(ext)) {
+            if (fread(&ext, sizeof(ext), 1, f) != 1) break;
+            extra -= sizeof(ext);
+            if (ext.crc != esp_rom_crc32_le(0, (const uint8_t *)&ext, offsetof(inv_bin_record_ext_t, crc))) {
+                memset(&ext, 0, sizeof(ext)); // keep the item, it just looks never synced
+            }
+        }
+        if (extra) fseek(f, extra, SEEK_CUR);
+        bool ok = true;
+        for (int i = 0; i < INV_BIN_NSTR; ++i) {
+            if (r.str[i] >= hdr.strtab_size) { ok = false; break; }
+        }
+        if (!ok || r.crc != record_crc(&r, strtab)) {
+            ESP_LOGW(TAG, "%s: dropping corrupt record %u", path, (unsigned)n);
+            continue;
+        }
+        inventory_item_t tmp;
+        memset(&tmp, 0, sizeof(tmp));
+        const char *fields[INV_BIN_NSTR];
+        for (int i = 0; i < INV_BIN_NSTR; ++i) fields[i] = strtab + r.str[i];
+        item_set_string_fields(&tmp, fields);
+        tmp.added_time = r.added_time;
+        tmp.calculated_expiry_date = r.calculated_expiry_date;
+        tmp.quantity = r.quantity;
+        tmp.default_shelf_life_days = r.default_shelf_life_days;
+        tmp.last_notified_remaining_days = r.last_notified_remaining_days;
+        tmp.version = ext.version;
+        tmp.updated_time = ext.updated_time;
+        inventory_compute_expiry(&tmp);
+        if (!store_upsert(&tmp)) {
+            ESP_LOGE(TAG, "%s: out of memory after %d records", path, loaded);
+            loaded = -2;
+            break;
+        }
+        loaded++;
+    }
+    free(strtab);
+    fclose(f);
+    return loaded;
+}
+
+// ---- JSON import/export ------------------------------------------------
+
+// 流式导入：逐 token 直接填充条目，峰值内存与文件大小无关（不读入整个文件、不建 DOM）
+typedef struct {
+    inventory_item_t item;
+    char key[32];
+    char name[128];
+    char category[64];
+    char unit[32];
+    char location[64];
+    char notes[256];
+    char photo_url[256];
+    bool in_array;
+    int loaded;
+    bool oom;
+} json_load_ctx_t;
+
+static void json_load_set_str(json_load_ctx_t *c, const char *v)
+{
+    struct { const char *key; char *buf; size_t size; const char **field; } map[] = {
+        { "name", c->name, sizeof(c->name), &c->item.name },
+        { "category", c->category, sizeof(c->category), &c->item.category },
+        { "unit", c->unit, sizeof(c->unit), &c->item.unit },
+        { "location", c->location, sizeof(c->location), &c->item.location },
+        { "notes", c->notes, sizeof(c->notes), &c->item.notes },
+        { "photo_url", c->photo_url, sizeof(c->photo_url), &c->item.photo_url },
+    };
+    if (strcmp(c->key, "item_id") == 0) {
+        strncpy(c->item.item_id, v, sizeof(c->item.item_id)-1);
+        return;
+    }
+    for (size_t i = 0; i < sizeof(map) / sizeof(map[0]); ++i) {
+        if (strcmp(c->key, map[i].key) == 0) {
+            strncpy(map[i].buf, v, map[i].size - 1);
+            map[i].buf[map[i].size - 1] = '\0';
+            *map[i].field = map[i].buf;
+            return;
+        }
+    }
+}
+
+static void json_load_set_num(json_load_ctx_t *c, double v)
+{
+    inventory_item_t *it = &c->item;
+    if (strcmp(c->key, "quantity") == 0) it->quantity = (int)v;
+    else if (strcmp(c->key, "added_time") == 0) it->added_time = (int64_t)v;
+    else if (strcmp(c->key, "default_shelf_life_days") == 0) it->default_shelf_life_days = (int)v;
+    else if (strcmp(c->key, "calculated_expiry_date") == 0) it->calculated_expiry_date = (int64_t)v;
+    else if (strcmp(c->key, "remaining_days") == 0) it->remaining_days = (int)v;
+    else if (strcmp(c->key, "last_notified_remaining_days") == 0) it->last_notified_remaining_days = (int)v;
+    else if (strcmp(c->key, "version") == 0) it->version = (uint32_t)v;
+    else if (strcmp(c->key, "updated_time") == 0) it->updated_time = (int64_t)v;
+}
+
+// depth 0: the top-level array, 1: item objects, 2: their fields (anything deeper is ignored)
+static bool json_load_token(const json_token_t *t, void *arg)
+{
+    json_load_ctx_t *c = arg;
+    if (t->depth == 0) {
+        if (t->type != JSON_TOK_ARR_BEGIN && t->type != JSON_TOK_ARR_END) return false; // not an item array
+        c->in_array = true;
+        return true;
+    }
+    if (t->depth == 1) {
+        if (t->type == JSON_TOK_OBJ_BEGIN) {
+            memset(&c->item, 0, sizeof(c->item));
+            c->item.last_notified_remaining_days = -1;
+            c->key[0] = '\0';
+        } else if (t->type == JSON_TOK_OBJ_END) {
+            // ensure computed fields
+            inventory_compute_expiry(&c->item);
+            if (c->item.item_id[0] == '\0') strncpy(c->item.item_id, inventory_generate_id(), sizeof(c->item.item_id)-1);
+            if (!store_upsert(&c->item)) { c->oom = true; return false; }
+            c->loaded++;
+        }
+        return true;
+    }
+    if (t->depth != 2) return true;
+    switch (t->type) {
+    case JSON_TOK_KEY:
+        strncpy(c->key, t->str, sizeof(c->key)-1);
+        c->key[sizeof(c->key)-1] = '\0';
+        break;
+    case JSON_TOK_STRING:
+        json_load_set_str(c, t->str);
+        break;
+    case JSON_TOK_NUMBER:
+        json_load_set_num(c, t->num);
+        break;
+    default:
+        break;
+    }
+    return true;
+}
+
+// Load an array of items from a JSON file; returns number loaded, or -1 if the file is missing or
+// malformed (items before the error have already been added)
+static int json_load_items(const char *path)
+{
+    json_load_ctx_t *c = calloc(1, sizeof(*c));
+    if (!c) return -1;
+    int rc = json_stream_parse_file(path, json_load_token, c);
+    int loaded = c->loaded;
+    bool ok = rc == 0 && c->in_array && !c->oom;
+    free(c);
+    if (!ok) {
+        if (rc != -1) ESP_LOGW(TAG, "%s: not a valid item array (%d items loaded)", path, loaded);
+        return -1;
+    }
+    return loaded;
+}
+
+int inventory_export_json(const char *path)
+{
+    if (!path) path = INV_PATH;
+    FILE *f = fopen(path, "w");
+    if (!f) return -1;
+    // items are streamed straight from the snapshot into the file in fixed-size chunks
+    json_writer_t w;
+    json_writer_init_file(&w, f);
+    json_w_arr_begin(&w);
+    const inventory_snapshot_t *snap = inventory_snapshot_acquire();
+    for (int i = 0; snap && i < snap->count; ++i) item_write_json(&w, &snap->items[i]);
+    inventory_snapshot_release(snap);
+    json_w_arr_end(&w);
+    int rc = json_writer_finish(&w);
+    if (fclose(f) != 0) rc = -1;
+    return rc;
+}
+
+int inventory_import_json(const char *path)
+{
+    if (!path) path = INV_PATH;
+    inventory_txn_begin();
+    uint32_t gen = s_generation;
+    int n = json_load_items(path);
+    // a malformed file may still have added the items before the error; keep those consistent on flash
+    if (s_generation != gen) {
+        inventory_save();
+        s_txn_changed = true;
+    }
+    inventory_txn_commit();
+    return n;
+}
+
+// Write a full snapshot and truncate the mutation log
+void inventory_save(void)
+{
+    INV_LOCK();
+    if (s_load_incomplete) {
+        ESP_LOGE(TAG, "snapshot not loaded completely, keeping the one on flash");
+        INV_UNLOCK();
+        return;
+    }
+    // write-then-rename so a power cut never leaves a half-written snapshot as the only copy
+    if (bin_write(INV_BIN_TMP_PATH) != 0) {
+        ESP_LOGE(TAG, "failed to write inventory snapshot");
+        storage_remove_file(INV_BIN_TMP_PATH);
+        INV_UNLOCK();
+        return;
+    }
+    storage_remove_file(INV_BIN_PATH);
+    if (rename(INV_BIN_TMP_PATH, INV_BIN_PATH) != 0) {
+        // inventory_load() also accepts the tmp file, so the snapshot is still recoverable
+        ESP_LOGW(TAG, "rename snapshot failed");
+        INV_UNLOCK();
+        return;
+    }
+    storage_remove_file(INV_LOG_PATH);
+    s_log_records = 0;
+    // the snapshot already contains any mutations still buffered by an open transaction
+    txn_log_reset();
+    INV_UNLOCK();
+}
+
+void inventory_load(void)
+{
+    INV_LOCK();
+    bool migrated = false;
+    int rc = bin_load(INV_BIN_PATH);
+    if (rc == -1) rc = bin_load(INV_BIN_TMP_PATH);
+    if (rc == -2) {
+        // a good snapshot that does not fit: keep it (and the legacy JSON) on flash as they are
+        s_load_incomplete = true;
+    } else if (rc < 0) {
+        // no binary snapshot yet: migrate forward from the legacy JSON file
+        if (json_load_items(INV_PATH) >= 0) {
+            ESP_LOGI(TAG, "migrating %s to binary snapshot", INV_PATH);
+            migrated = true;
+        }
+    }
+    // apply mutations recorded after the snapshot
+    log_replay();
+    if (migrated) {
+        inventory_save();
+        storage_remove_file(INV_PATH);
+    }
+    // publish even when empty so readers always get a (possibly empty) snapshot
+    s_generation++;
+    publish_snapshot();
+    INV_UNLOCK();
 }
 
 void inventory_print_all(void)
 {
-    inventory_item_t *it = g_head;
-    while (it) {
-        ESP_LOGI(TAG, "Item: %s qty:%d %s loc:%s added:%lld expiry:%lld remaining:%d days", it->name, it->quantity, it->unit, it->location, (long long)it->added_time, (long long)it->calculated_expiry_date, it->remaining_days);
-        it = it->next;
+    const inventory_snapshot_t *snap = inventory_snapshot_acquire();
+    if (!snap) return;
+    for (int i = 0; i < snap->count; ++i) {
+        const inventory_item_t *it = &snap->items[i];
+        ESP_LOGI(TAG, "Item: %s qty:%d %s loc:%s added:%lld expiry:%lld remaining:%d days", it->name, it->quantity, it->unit, it->location, (long long)it->added_time, (long long)it->calculated_expiry_date, inventory_days_left(it));
     }
+    inventory_snapshot_release(snap);
 }
 
-// Build array of pointers to items, sorted by remaining_days ascending
+// Build array of pointers to items, sorted by remaining_days ascending.
+// The array, the item copies and their strings live in one allocation, so the
+// result stays valid after later mutations and a single free() releases it.
 int inventory_list_items(inventory_item_t ***out_items)
 {
     if (!out_items) return -1;
-    int count = 0;
-    inventory_item_t *it = g_head;
-    while (it) { count++; it = it->next; }
-    if (count == 0) { *out_items = NULL; return 0; }
-    inventory_item_t **arr = calloc(count, sizeof(inventory_item_t*));
-    if (!arr) return -1;
-    int i = 0;
-    it = g_head;
-    while (it && i < count) { arr[i++] = it; it = it->next; }
-
-    // sort by remaining_days ascending
-    int cmp(const void *a, const void *b) {
-        inventory_item_t *ia = *(inventory_item_t **)a;
-        inventory_item_t *ib = *(inventory_item_t **)b;
-        return ia->remaining_days - ib->remaining_days;
-    }
-    qsort(arr, count, sizeof(inventory_item_t*), cmp);
+    const inventory_snapshot_t *snap = inventory_snapshot_acquire();
+    int count = snap ? snap->count : 0;
+    if (count == 0) {
+        inventory_snapshot_release(snap);
+        *out_items = NULL;
+        return 0;
+    }
+    size_t strs = 0;
+    for (int i = 0; i < count; ++i) strs += item_strings_len(&snap->items[i]);
+    inventory_item_t **arr = malloc(count * (sizeof(inventory_item_t *) + sizeof(inventory_item_t)) + strs);
+    if (!arr) { inventory_snapshot_release(snap); return -1; }
+    inventory_item_t *copies = (inventory_item_t *)(arr + count);
+    char *buf = (char *)(copies + count);
+    for (int i = 0; i < count; ++i) {
+        copies[i] = snap->items[i];
+        buf = item_copy_strings(&copies[i], &snap->items[i], buf);
+    }
+    inventory_snapshot_release(snap);
+    for (int i = 0; i < count; ++i) {
+        arr[i] = &copies[i];
+        copies[i].next = NULL;
+        // expiry date is fixed, only the day count drifts with the clock; order is unaffected
+        copies[i].remaining_days = inventory_days_left(&copies[i]);
+    }
     *out_items = arr;
     return count;
 }
 
+int inventory_foreach_by_expiry(int limit, inventory_visit_fn fn, void *ctx)
+{
+    if (!fn) return 0;
+    const inventory_snapshot_t *snap = inventory_snapshot_acquire();
+    if (!snap) return 0;
+    int n = (limit > 0 && limit < snap->count) ? limit : snap->count;
+    int visited = 0;
+    while (visited < n) {
+        // hand out a private copy so the day count can be refreshed without touching the shared snapshot
+        inventory_item_t it = snap->items[visited];
+        it.next = NULL;
+        it.remaining_days = inventory_days_left(&it);
+        visited++;
+        if (!fn(&it, ctx)) break;
+    }
+    inventory_snapshot_release(snap);
+    return visited;
+}
+
+int inventory_count(void)
+{
+    const inventory_snapshot_t *snap = inventory_snapshot_acquire();
+    int count = snap ? snap->count : 0;
+    inventory_snapshot_release(snap);
+    return count;
+}
+
+uint32_t inventory_generation(void)
+{
+    const inventory_snapshot_t *snap = inventory_snapshot_acquire();
+    uint32_t gen = snap ? snap->generation : 0;
+    inventory_snapshot_release(snap);
+    return gen;
+}
+
 void inventory_free_list(inventory_item_t **items)
 {
     if (items) free(items);
 }
 
-void inventory_mark_notified(inventory_item_t *item, int remaining_days)
+// item may be a copy (from a snapshot or list); the live record is found by item_id
+void inventory_mark_notified(const inventory_item_t *item, int remaining_days)
 {
     if (!item) return;
-    item->last_notified_remaining_days = remaining_days;
+    inventory_txn_begin();
+    inventory_item_t *live = find_by_id(item->item_id);
+    if (!live) { inventory_txn_commit(); return; }
+    live->last_notified_remaining_days = remaining_days;
+    s_generation++;
     // persist change
-    inventory_save();
+    log_update(live);
     // enqueue notify event
-    cJSON *ev = cJSON_CreateObject();
-    cJSON_AddStringToObject(ev, "item_id", item->item_id);
-    cJSON_AddStringToObject(ev, "action", "notified");
-    cJSON_AddNumberToObject(ev, "remaining_days", remaining_days);
-    char *s = cJSON_PrintUnformatted(ev);
-    if (s) { sync_enqueue_event("notified", s); free(s); }
-    cJSON_Delete(ev);
+    json_writer_t ev;
+    json_writer_init_mem(&ev);
+    json_w_obj_begin(&ev);
+    json_w_kv_str(&ev, "item_id", live->item_id);
+    json_w_kv_str(&ev, "action", "notified");
+    json_w_kv_int(&ev, "remaining_days", remaining_days);
+    json_w_obj_end(&ev);
+    txn_queue_event("notified", &ev);
+    inventory_txn_commit();
 }
 
 int inventory_remove_item(const char *name, int quantity)
 {
     if (!name || quantity <= 0) return -1;
-    
-    inventory_item_t *curr = g_head;
-    inventory_item_t *prev = NULL;
-    
-    while (curr) {
-        // Simple substring match or exact match? Let's try strstr for flexibility
-        if (strstr(curr->name, name) != NULL) {
-            ESP_LOGI(TAG, "Found item to remove: %s (qty: %d)", curr->name, curr->quantity);
-            
-            if (curr->quantity > quantity) {
-                curr->quantity -= quantity;
-                ESP_LOGI(TAG, "Decreased quantity to %d", curr->quantity);
-            } else {
-                // Remove entire item
-                if (prev) {
-                    prev->next = curr->next;
-                } else {
-                    g_head = curr->next;
-                }
-                ESP_LOGI(TAG, "Removed item completely");
-                free(curr);
-                // Don't access curr after free
-                curr = NULL; 
-            }
-            
-            inventory_save();
-            return 0;
+
+    inventory_txn_begin();
+    // exact (normalized) name via the hash index first; fall back to a substring
+    // scan so "牛奶" still finds "纯牛奶"
+    inventory_item_t *curr = find_by_name(name);
+    for (int i = 0; !curr && i < s_live_count; ++i) {
+        if (strstr(s_live[i]->item.name, name) != NULL) curr = &s_live[i]->item;
+    }
+    if (!curr) {
+        inventory_txn_commit();
+        ESP_LOGW(TAG, "Item not found for removal: %s", name);
+        return -1;
+    }
+
+    ESP_LOGI(TAG, "Found item to remove: %s (qty: %d)", curr->name, curr->quantity);
+    if (curr->quantity > quantity) {
+        curr->quantity -= quantity;
+        curr->version++;
+        curr->updated_time = time(NULL);
+        s_generation++;
+        ESP_LOGI(TAG, "Decreased quantity to %d", curr->quantity);
+        log_update(curr);
+        sync_item_state(curr);
+    } else {
+        // Remove entire item
+        ESP_LOGI(TAG, "Removed item completely");
+        log_delete(curr->item_id);
+        sync_item_removed(curr);
+        store_remove(curr);
+    }
+    s_txn_changed = true;
+    inventory_txn_commit();
+    return 0;
+}
+
+int inventory_apply_remote(const inventory_item_t *item, bool deleted)
+{
+    if (!item || item->item_id[0] == '\0') return -1;
+    inventory_txn_begin();
+    inventory_item_t *local = find_by_id(item->item_id);
+    // last writer wins: higher version, then later update time; a tie keeps the local copy
+    bool newer = !local || item->version > local->version ||
+                 (item->version == local->version && item->updated_time > local->updated_time);
+    int rc = 0;
+    if (!newer || (deleted && !local)) {
+        // stale, or deleting something this device never had
+    } else if (deleted) {
+        ESP_LOGI(TAG, "remote delete: %s", local->name);
+        log_delete(local->item_id);
+        store_remove(local);
+        s_txn_changed = true;
+        rc = 1;
+    } else {
+        inventory_item_t tmp = *item;
+        // reminder state is per device
+        tmp.last_notified_remaining_days = local ? local->last_notified_remaining_days : -1;
+        if (tmp.added_time == 0) tmp.added_time = local ? local->added_time : time(NULL);
+        if (tmp.default_shelf_life_days == 0) tmp.default_shelf_life_days = category_default_days(tmp.category);
+        inventory_compute_expiry(&tmp);
+        inventory_item_t *n = store_upsert(&tmp);
+        if (n) {
+            ESP_LOGI(TAG, "remote update: %s qty:%d v%u", n->name, n->quantity, (unsigned)n->version);
+            log_add(n);
+            s_txn_changed = true;
+            rc = 1;
+        } else {
+            rc = -1;
         }
-        prev = curr;
-        curr = curr->next;
     }
-    
-    ESP_LOGW(TAG, "Item not found for removal: %s", name);
-    return -1;
+    inventory_txn_commit();
+    return rc;
 }
 
 void inventory_clear_all(void)
 {
-    inventory_item_t *curr = g_head;
-    while (curr) {
-        inventory_item_t *next = curr->next;
-        free(curr);
-        curr = next;
-    }
-    g_head = NULL;
-    inventory_save(); // Save empty list
+    inventory_txn_begin();
+    for (int i = 0; i < s_live_count; ++i) sync_item_removed(&s_live[i]->item);
+    store_clear();
+    // a clear is cheapest expressed as an empty snapshot, which also drops the log
+    inventory_save();
+    s_txn_changed = true;
+    inventory_txn_commit();
     ESP_LOGI(TAG, "Inventory cleared");
 }
 
@@ -3,41 +3,85 @@
 #define _INVENTORY_H_
 
 #include <stdint.h>
+#include <stdbool.h>
 
+// 字符串字段：库存内部的条目保证非 NULL（缺省为 ""）。category/unit/location 驻留在只增不减的字符串池里，
+// name/notes/photo_url 按实际长度存放。传给 inventory_add_item 的条目只借用这些指针（可为 NULL），
+// 库存会自行拷贝；快照/列表中的字符串在快照释放/列表 free 之前有效
 typedef struct inventory_item_t {
     char item_id[32]; // 唯一标识
-    char name[64];
-    char category[32]; // 牛奶/肉类/蔬果/熟食/冷冻
+    const char *name;
+    const char *category; // 牛奶/肉类/蔬果/熟食/冷冻
+    const char *unit;
+    const char *location; // 中层左/中层右/冷冻室...
+    const char *notes;
+    const char *photo_url;
     int quantity;
-    char unit[16];
-    char location[32]; // 中层左/中层右/冷冻室...
-    int64_t added_time; // UTC epoch seconds
     int default_shelf_life_days; // 默认保质期（天）
-    int64_t calculated_expiry_date; // epoch seconds
     int remaining_days; // 计算值
-    char notes[128];
-    char photo_url[128];
     int last_notified_remaining_days; // -1 未通知
+    int64_t added_time; // UTC epoch seconds
+    int64_t calculated_expiry_date; // epoch seconds
+    uint32_t version; // 每次内容变更（本地或同步合入）递增，用于增量同步的冲突判定；0 表示从未同步过
+    int64_t updated_time; // 最后一次内容变更的时间（UTC epoch seconds）
     struct inventory_item_t *next;
 } inventory_item_t;
 
+// 只读快照：按过期时间升序的条目副本。获取后即使库存被修改也保持不变，不会悬空；
+// 用完必须 inventory_snapshot_release。获取/释放不会等待写者的闪存 I/O，可在音频/UI 任务中调用
+typedef struct inventory_snapshot_t {
+    uint32_t generation;
+    int count;
+    const inventory_item_t *items;
+    int refs; // 内部引用计数
+} inventory_snapshot_t;
+
 void inventory_init(void);
 int inventory_add_item(const inventory_item_t *item);
 int inventory_add_item_from_text(const char *text);
 void inventory_save(void);
 void inventory_load(void);
+// JSON 导入/导出（主存储为 /spiffs/inventory.bin）；path 为 NULL 时使用 /spiffs/inventory.json
+int inventory_export_json(const char *path);
+// 导入的条目追加到当前库存并立即写快照，返回导入条数；文件不存在或格式错误返回 -1（出错前已解析的条目保留）
+int inventory_import_json(const char *path);
 void inventory_print_all(void);
 int inventory_compute_expiry(inventory_item_t *item);
+// 按当前时间计算剩余天数（不修改 item），适用于快照中的只读条目
+int inventory_days_left(const inventory_item_t *item);
 const char *inventory_generate_id(void);
-// 返回动态分配的指针数组（元素为指向内部链表项的指针），caller 需 free() 返回的数组（但不要 free 元素）
+// 返回动态分配的指针数组（元素指向与数组同一块内存中的条目副本及其字符串），caller 需 free() 返回的数组（但不要 free 元素）
 int inventory_list_items(inventory_item_t ***out_items);
 void inventory_free_list(inventory_item_t **items);
+int inventory_count(void);
+const inventory_snapshot_t *inventory_snapshot_acquire(void); // 库存未初始化时返回 NULL
+void inventory_snapshot_release(const inventory_snapshot_t *snap);
+// 注册库存变更回调（增/删/清空/导入后调用，inventory_mark_notified 不触发）
+void inventory_set_change_cb(void (*cb)(void));
+// 库存变更计数：每次增删改都会递增，可用于判断缓存的列表是否过期
+uint32_t inventory_generation(void);
+// 按过期时间从早到晚遍历最多 limit 个条目（limit<=0 表示全部），不分配内存，fn 返回 false 提前结束。
+// 遍历基于快照，回调中可以修改库存；item 是临时副本，remaining_days 已按当前时间刷新。返回已遍历的条目数
+typedef bool (*inventory_visit_fn)(const inventory_item_t *item, void *ctx);
+int inventory_foreach_by_expiry(int limit, inventory_visit_fn fn, void *ctx);
 // 通知字段：记录上次被提醒时的 remaining_days，用于避免重复提醒
-void inventory_mark_notified(inventory_item_t *item, int remaining_days);
+// item 可以是快照/列表中的副本，按 item_id 定位实际条目
+void inventory_mark_notified(const inventory_item_t *item, int remaining_days);
+
+// 批量修改：begin/commit 之间的增删改先在内存生效，commit 时只追加一次变更日志（或写一次快照）、
+// 把同步事件一次性写入同步队列、发布一次快照并触发一次变更回调。可嵌套，以最外层 commit 为准。
+// 事务期间持有库存写锁，其他任务的写操作会等待，读快照不受影响
+void inventory_txn_begin(void);
+void inventory_txn_commit(void);
 
 // 移除物品（减少数量或删除）
 int inventory_remove_item(const char *name, int quantity);
 // 清空所有库存
 void inventory_clear_all(void);
 
+// 合入其他设备/服务端的变更（增量同步拉取）。“后写者胜”：远端 version 更大，或 version 相同而 updated_time 更新时
+// 才覆盖本地条目；deleted 为 true 时删除。合入的变更写入变更日志但不会再产生同步事件。
+// 已合入返回 1，本地版本更新而忽略返回 0，出错返回 -1
+int inventory_apply_remote(const inventory_item_t *item, bool deleted);
+
 #endif // _INVENTORY_H_
@@ -0,0 +1,455 @@
+// json_stream.c - 流式 JSON 读取（递归下降，深度受 JSON_STREAM_MAX_DEPTH 限制）与写入
+#include "json_stream.h"
+#include "esp_log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+static const char *TAG = "json_stream";
+
+typedef struct {
+    json_stream_read_fn read;
+    void *src;
+    char buf[JSON_STREAM_CHUNK];
+    size_t len;            // valid bytes in buf
+    size_t pos;            // next byte in buf
+    size_t base;           // input offset of buf[0]
+    char tok[JSON_STREAM_TOKEN_MAX];
+    json_stream_cb cb;
+    void *ctx;
+    bool stop;             // callback asked to stop
+    bool error;
+} json_reader_t;
+
+// next byte without consuming it, -1 at end of input
+static int peek(json_reader_t *r)
+{
+    if (r->pos == r->len) {
+        r->base += r->len;
+        r->len = r->read(r->src, r->buf, sizeof(r->buf));
+        r->pos = 0;
+        if (r->len == 0) return -1;
+    }
+    return (unsigned char)r->buf[r->pos];
+}
+
+static int get(json_reader_t *r)
+{
+    int c = peek(r);
+    if (c >= 0) r->pos++;
+    return c;
+}
+
+static size_t offset(const json_reader_t *r)
+{
+    return r->base + r->pos;
+}
+
+static void skip_ws(json_reader_t *r)
+{
+    int c;
+    while ((c = peek(r)) == ' ' || c == '\t' || c == '\n' || c == '\r') r->pos++;
+}
+
+static bool emit(json_reader_t *r, json_token_t *t)
+{
+    if (!r->cb(t, r->ctx)) r->stop = true;
+    return !r->stop;
+}
+
+static bool fail(json_reader_t *r, const char *what)
+{
+    ESP_LOGW(TAG, "syntax error at offset %u: %s", (unsigned)offset(r), what);
+    r->error = true;
+    return false;
+}
+
+static int hex4(json_reader_t *r)
+{
+    int v = 0;
+    for (int i = 0; i < 4; ++i) {
+        int c = get(r);
+        v <<= 4;
+        if (c >= '0' && c <= '9') v |= c - '0';
+        else if (c >= 'a' && c <= 'f') v |= c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') v |= c - 'A' + 10;
+        else return -1;
+    }
+    return v;
+}
+
+static void put_byte(json_token_t *t, char *out, int c)
+{
+    if (t->len < JSON_STREAM_TOKEN_MAX - 1) out[t->len++] = (char)c;
+    else t->truncated = true;
+}
+
+static void put_utf8(json_token_t *t, char *out, uint32_t cp)
+{
+    if (cp < 0x80) {
+        put_byte(t, out, cp);
+    } else if (cp < 0x800) {
+        put_byte(t, out, 0xC0 | (cp >> 6));
+        put_byte(t, out, 0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        put_byte(t, out, 0xE0 | (cp >> 12));
+        put_byte(t, out, 0x80 | ((cp >> 6) & 0x3F));
+        put_byte(t, out, 0x80 | (cp & 0x3F));
+    } else {
+        put_byte(t, out, 0xF0 | (cp >> 18));
+        put_byte(t, out, 0x80 | ((cp >> 12) & 0x3F));
+        put_byte(t, out, 0x80 | ((cp >> 6) & 0x3F));
+        put_byte(t, out, 0x80 | (cp & 0x3F));
+    }
+}
+
+// opening quote already consumed; decodes into r->tok
+static bool read_string(json_reader_t *r, json_token_t *t)
+{
+    t->len = 0;
+    t->truncated = false;
+    for (;;) {
+        int c = get(r);
+        if (c < 0) return fail(r, "unterminated string");
+        if (c == '"') break;
+        if (c != '\\') { put_byte(t, r->tok, c); continue; }
+        c = get(r);
+        switch (c) {
+        case '"': case '\\': case '/': put_byte(t, r->tok, c); break;
+        case 'b': put_byte(t, r->tok, '\b'); break;
+        case 'f': put_byte(t, r->tok, '\f'); break;
+        case 'n': put_byte(t, r->tok, '\n'); break;
+        case 'r': put_byte(t, r->tok, '\r'); break;
+        case 't': put_byte(t, r->tok, '\t'); break;
+        case 'u': {
+            int cp = hex4(r);
+            if (cp < 0) return fail(r, "bad \\u escape");
+            // surrogate pair
+            if (cp >= 0xD800 && cp <= 0xDBFF && peek(r) == '\\') {
+                r->pos++;
+                if (get(r) != 'u') return fail(r, "bad surrogate pair");
+                int lo = hex4(r);
+                if (lo < 0xDC00 || lo > 0xDFFF) return fail(r, "bad surrogate pair");
+                cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+            }
+            put_utf8(t, r->tok, (uint32_t)cp);
+            break;
+        }
+        default:
+            return fail(r, "bad escape");
+        }
+    }
+    r->tok[t->len] = '\0';
+    t->str = r->tok;
+    t->end = offset(r);
+    return true;
+}
+
+static bool read_literal(json_reader_t *r, const char *word)
+{
+    for (const char *p = word; *p; ++p) {
+        if (get(r) != *p) return fail(r, "bad literal");
+    }
+    return true;
+}
+
+static bool parse_value(json_reader_t *r, int depth);
+
+static bool parse_container(json_reader_t *r, int depth, bool is_obj)
+{
+    json_token_t t = { .type = is_obj ? JSON_TOK_OBJ_BEGIN : JSON_TOK_ARR_BEGIN, .depth = depth, .offset = offset(r) };
+    r->pos++; // '{' or '['
+    t.end = offset(r);
+    if (!emit(r, &t)) return false;
+    if (depth + 1 >= JSON_STREAM_MAX_DEPTH) return fail(r, "nesting too deep");
+
+    const int close = is_obj ? '}' : ']';
+    skip_ws(r);
+    if (peek(r) != close) {
+        for (;;) {
+            if (is_obj) {
+                skip_ws(r);
+                json_token_t k = { .type = JSON_TOK_KEY, .depth = depth + 1, .offset = offset(r) };
+                if (get(r) != '"') return fail(r, "expected key");
+                if (!read_string(r, &k) || !emit(r, &k)) return false;
+                skip_ws(r);
+                if (get(r) != ':') return fail(r, "expected ':'");
+            }
+            if (!parse_value(r, depth + 1)) return false;
+            skip_ws(r);
+            int c = peek(r);
+            if (c == ',') { r->pos++; continue; }
+            if (c == close) break;
+            return fail(r, is_obj ? "expected ',' or '}'" : "expected ',' or ']'");
+        }
+    }
+    json_token_t e = { .type = is_obj ? JSON_TOK_OBJ_END : JSON_TOK_ARR_END, .depth = depth, .offset = offset(r) };
+    r->pos++;
+    e.end = offset(r);
+    return emit(r, &e);
+}
+
+static bool parse_value(json_reader_t *r, int depth)
+{
+    skip_ws(r);
+    json_token_t t = { .depth = depth, .offset = offset(r) };
+    int c = peek(r);
+    switch (c) {
+    case '{': return parse_container(r, depth, true);
+    case '[': return parse_container(r, depth, false);
+    case '"':
+        r->pos++;
+        t.type = JSON_TOK_STRING;
+        if (!read_string(r, &t)) return false;
+        return emit(r, &t);
+    case 't':
+        t.type = JSON_TOK_TRUE;
+        if (!read_literal(r, "true")) return false;
+        break;
+    case 'f':
+        t.type = JSON_TOK_FALSE;
+        if (!read_literal(r, "false")) return false;
+        break;
+    case 'n':
+        t.type = JSON_TOK_NULL;
+        if (!read_literal(r, "null")) return false;
+        break;
+    default:
+        if (c != '-' && (c < '0' || c > '9')) return fail(r, "unexpected character");
+        t.type = JSON_TOK_NUMBER;
+        t.len = 0;
+        while ((c = peek(r)) >= 0 && (strchr("+-.eE", c) || (c >= '0' && c <= '9'))) {
+            if (t.len < JSON_STREAM_TOKEN_MAX - 1) r->tok[t.len++] = (char)c;
+            r->pos++;
+        }
+        r->tok[t.len] = '\0';
+        char *endp;
+        t.num = strtod(r->tok, &endp);
+        if (endp == r->tok) return fail(r, "bad number");
+        t.str = r->tok;
+        break;
+    }
+    t.end = offset(r);
+    return emit(r, &t);
+}
+
+int json_stream_parse(json_stream_read_fn read, void *src, json_stream_cb cb, void *ctx)
+{
+    if (!read || !cb) return -1;
+    // the reader holds the chunk and token buffers: one fixed-size allocation per parse
+    json_reader_t *r = calloc(1, sizeof(*r));
+    if (!r) return -1;
+    r->read = read;
+    r->src = src;
+    r->cb = cb;
+    r->ctx = ctx;
+    if (parse_value(r, 0) && !r->stop) {
+        skip_ws(r);
+        if (peek(r) >= 0) fail(r, "trailing data");
+    }
+    int rc = r->error ? -2 : 0;
+    free(r);
+    return rc;
+}
+
+static size_t file_read(void *src, char *buf, size_t size)
+{
+    return fread(buf, 1, size, (FILE *)src);
+}
+
+int json_stream_parse_file(const char *path, json_stream_cb cb, void *ctx)
+{
+    if (!path || !cb) return -1;
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+    int rc = json_stream_parse(file_read, f, cb, ctx);
+    fclose(f);
+    return rc;
+}
+
+// ---- writer ----------------------------------------------------------------
+
+void json_writer_init_file(json_writer_t *w, FILE *f)
+{
+    memset(w, 0, sizeof(*w));
+    w->f = f;
+    w->buf = malloc(JSON_STREAM_CHUNK);
+    w->cap = JSON_STREAM_CHUNK;
+    w->error = (f == NULL || w->buf == NULL);
+}
+
+void json_writer_init_mem(json_writer_t *w)
+{
+    memset(w, 0, sizeof(*w));
+}
+
+static void flush_chunk(json_writer_t *w)
+{
+    if (w->len && fwrite(w->buf, 1, w->len, w->f) != w->len) w->error = true;
+    w->len = 0;
+}
+
+void json_w_bytes(json_writer_t *w, const char *data, size_t len)
+{
+    if (w->error) return;
+    if (w->f) {
+        while (len > 0) {
+            if (w->len == w->cap) flush_chunk(w);
+            if (w->error) return;
+            size_t n = w->cap - w->len;
+            if (n > len) n = len;
+            memcpy(w->buf + w->len, data, n);
+            w->len += n;
+            data += n;
+            len -= n;
+        }
+        return;
+    }
+    if (w->len + len + 1 > w->cap) {
+        size_t cap = w->cap ? w->cap : 128;
+        while (w->len + len + 1 > cap) cap *= 2;
+        char *nb = realloc(w->buf, cap);
+        if (!nb) { w->error = true; return; }
+        w->buf = nb;
+        w->cap = cap;
+    }
+    memcpy(w->buf + w->len, data, len);
+    w->len += len;
+    w->buf[w->len] = '\0';
+}
+
+static void put_c(json_writer_t *w, char c)
+{
+    json_w_bytes(w, &c, 1);
+}
+
+static void put_s(json_writer_t *w, const char *s)
+{
+    json_w_bytes(w, s, strlen(s));
+}
+
+// comma before every element but the first of the enclosing container (not after a key)
+static void before_value(json_writer_t *w)
+{
+    if (w->after_key) { w->after_key = false; return; }
+    if (w->depth == 0) return;
+    uint32_t bit = 1u << (w->depth - 1);
+    if (w->has_items & bit) put_c(w, ',');
+    w->has_items |= bit;
+}
+
+static void put_escaped(json_writer_t *w, const char *s)
+{
+    put_c(w, '"');
+    const char *run = s;
+    for (; *s; ++s) {
+        unsigned char c = (unsigned char)*s;
+        if (c >= 0x20 && c != '"' && c != '\\') continue; // UTF-8 passes through unchanged
+        json_w_bytes(w, run, s - run);
+        run = s + 1;
+        char esc[8];
+        switch (c) {
+        case '"':  put_s(w, "\\\""); break;
+        case '\\': put_s(w, "\\\\"); break;
+        case '\n': put_s(w, "\\n"); break;
+        case '\r': put_s(w, "\\r"); break;
+        case '\t': put_s(w, "\\t"); break;
+        default:
+            snprintf(esc, sizeof(esc), "\\u%04x", c);
+            put_s(w, esc);
+            break;
+        }
+    }
+    json_w_bytes(w, run, s - run);
+    put_c(w, '"');
+}
+
+static void open_container(json_writer_t *w, char c)
+{
+    before_value(w);
+    put_c(w, c);
+    if (w->depth >= 32) { w->error = true; return; }
+    w->depth++;
+    w->has_items &= ~(1u << (w->depth - 1));
+}
+
+static void close_container(json_writer_t *w, char c)
+{
+    if (w->depth > 0) w->depth--;
+    put_c(w, c);
+}
+
+void json_w_obj_begin(json_writer_t *w) { open_container(w, '{'); }
+void json_w_obj_end(json_writer_t *w)   { close_container(w, '}'); }
+void json_w_arr_begin(json_writer_t *w) { open_container(w, '['); }
+void json_w_arr_end(json_writer_t *w)   { close_container(w, ']'); }
+
+void json_w_key(json_writer_t *w, const char *key)
+{
+    before_value(w);
+    put_escaped(w, key);
+    put_c(w, ':');
+    w->after_key = true;
+}
+
+void json_w_str(json_writer_t *w, const char *s)
+{
+    before_value(w);
+    put_escaped(w, s ? s : "");
+}
+
+void json_w_int(json_writer_t *w, int64_t v)
+{
+    char num[24];
+    before_value(w);
+    snprintf(num, sizeof(num), "%lld", (long long)v);
+    put_s(w, num);
+}
+
+void json_w_bool(json_writer_t *w, bool v)
+{
+    before_value(w);
+    put_s(w, v ? "true" : "false");
+}
+
+void json_w_null(json_writer_t *w)
+{
+    before_value(w);
+    put_s(w, "null");
+}
+
+void json_w_value_raw(json_writer_t *w, const char *json)
+{
+    before_value(w);
+    put_s(w, json);
+}
+
+int json_writer_finish(json_writer_t *w)
+{
+    if (w->f) {
+        if (!w->error) flush_chunk(w);
+        free(w->buf);
+        w->buf = NULL;
+    }
+    return w->error ? -1 : 0;
+}
+
+char *json_writer_take(json_writer_t *w)
+{
+    if (w->f) return NULL;
+    if (w->error || !w->buf) {
+        free(w->buf);
+        w->buf = NULL;
+        return NULL;
+    }
+    char *out = w->buf;
+    w->buf = NULL;
+    return out;
+}
+
+void json_writer_discard(json_writer_t *w)
+{
+    free(w->buf);
+    w->buf = NULL;
+}
@@ -0,0 +1,91 @@
+// json_stream.h - 流式 JSON 读写，不构建 DOM
+//   读取（SAX 风格）：按固定大小分块读文件，逐个 token 回调
+//   写入：边生成边输出到文件（固定大小缓冲分块写）或内存字符串，逗号/转义由 writer 处理
+#ifndef _JSON_STREAM_H_
+#define _JSON_STREAM_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// 读缓冲与单个字符串/数字 token 的上限；内存占用与文件大小无关
+#define JSON_STREAM_CHUNK     512
+#define JSON_STREAM_TOKEN_MAX 512
+#define JSON_STREAM_MAX_DEPTH 16
+
+typedef enum {
+    JSON_TOK_OBJ_BEGIN,
+    JSON_TOK_OBJ_END,
+    JSON_TOK_ARR_BEGIN,
+    JSON_TOK_ARR_END,
+    JSON_TOK_KEY,
+    JSON_TOK_STRING,
+    JSON_TOK_NUMBER,
+    JSON_TOK_TRUE,
+    JSON_TOK_FALSE,
+    JSON_TOK_NULL,
+} json_tok_type_t;
+
+typedef struct {
+    json_tok_type_t type;
+    int depth;          // 外层容器层数：顶层值为 0，顶层数组的元素为 1，依此类推；*_END 与对应 *_BEGIN 相同
+    const char *str;    // KEY/STRING 为解码后的 UTF-8 文本，NUMBER 为原文；仅在回调期间有效
+    size_t len;
+    bool truncated;     // 字符串超过 JSON_STREAM_TOKEN_MAX-1 字节被截断
+    double num;         // NUMBER 的数值
+    size_t offset;      // token 在输入中的起始字节偏移
+    size_t end;         // token 结束后的字节偏移（*_END 为右括号之后）
+} json_token_t;
+
+// 返回 false 提前结束解析
+typedef bool (*json_stream_cb)(const json_token_t *tok, void *ctx);
+
+// 解析整个文件，逐 token 回调。成功（或被回调提前结束）返回 0，文件不存在返回 -1，语法错误返回 -2
+int json_stream_parse_file(const char *path, json_stream_cb cb, void *ctx);
+
+// 数据源：读取最多 size 字节到 buf，返回读到的字节数，0 表示输入结束（或读出错）
+typedef size_t (*json_stream_read_fn)(void *src, char *buf, size_t size);
+// 从任意数据源（如 HTTP 响应体）边读边解析；内存不足返回 -1，其余返回值同 json_stream_parse_file
+int json_stream_parse(json_stream_read_fn read, void *src, json_stream_cb cb, void *ctx);
+
+typedef struct {
+    FILE *f;               // 文件输出；NULL 表示输出到内存
+    char *buf;             // 文件：JSON_STREAM_CHUNK 字节的块缓冲；内存：不断增长的输出串
+    size_t len;
+    size_t cap;
+    uint32_t has_items;    // 第 n 位：第 n 层容器已写过元素（决定是否先写逗号）
+    int depth;
+    bool after_key;
+    bool error;            // 写失败或内存不足，之后的写入都被忽略
+} json_writer_t;
+
+// 写到已打开的文件（调用者负责 fclose），必须以 json_writer_finish 结束以冲刷并释放块缓冲
+void json_writer_init_file(json_writer_t *w, FILE *f);
+// 写到内存；用 json_writer_take 取出结果
+void json_writer_init_mem(json_writer_t *w);
+// 文件：冲刷并释放块缓冲；内存：无操作。出错返回 -1
+int json_writer_finish(json_writer_t *w);
+// 取出内存输出（以 '\0' 结尾，caller free）；出错返回 NULL。之后 writer 不可再用
+char *json_writer_take(json_writer_t *w);
+// 放弃内存输出
+void json_writer_discard(json_writer_t *w);
+
+void json_w_obj_begin(json_writer_t *w);
+void json_w_obj_end(json_writer_t *w);
+void json_w_arr_begin(json_writer_t *w);
+void json_w_arr_end(json_writer_t *w);
+void json_w_key(json_writer_t *w, const char *key);
+void json_w_str(json_writer_t *w, const char *s); // NULL 写成 ""
+void json_w_int(json_writer_t *w, int64_t v);
+void json_w_bool(json_writer_t *w, bool v);
+void json_w_null(json_writer_t *w);
+// 插入一段已序列化好的 JSON 值
+void json_w_value_raw(json_writer_t *w, const char *json);
+// 原样写入字节，不参与逗号处理（用于在已有文件中续写）
+void json_w_bytes(json_writer_t *w, const char *data, size_t len);
+
+static inline void json_w_kv_str(json_writer_t *w, const char *key, const char *s) { json_w_key(w, key); json_w_str(w, s); }
+static inline void json_w_kv_int(json_writer_t *w, const char *key, int64_t v) { json_w_key(w, key); json_w_int(w, v); }
+
+#endif // _JSON_STREAM_H_
@@ -7,6 +7,7 @@
 #include "tts.h"
 #include "notify.h"
 #include "wifi.h"
+#include "sync.h"
 
 
 void app_main(void)
@@ -25,13 +26,15 @@ void app_main(void)
 
     // 初始化 TTS 与提醒
     tts_init();
-    // check every 43200s (12 hours), threshold 3 days (adjustable)
+    // reminders wake exactly at the next expiry day boundary; 43200s (12 hours) caps a single sleep, threshold 3 days (adjustable)
     notify_init(43200, 3);
 
     // Start Wi-Fi (edit wifi_config.h to set SSID/PASSWORD)
     if (!wifi_init_sta()) {
         ESP_LOGW("main", "Wi-Fi failed to start or connect");
     }
+    // 云同步：离线期间事件留在本地队列，联网后自动上传
+    sync_init();
 
     app_sr_init();  // 语音识别初始化   
 }
@@ -1,4 +1,5 @@
-// notify.c - periodic scan of inventory and TTS reminders
+// notify.c - event-driven expiry reminders: sleep until the next item crosses a day boundary
+// inside the reminder window, or until an inventory change re-arms the scheduler
 #include "notify.h"
 #include "inventory.h"
 #include "ui_inventory.h"
@@ -6,40 +7,85 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include <stdio.h>
+#include <time.h>
 
 static const char *TAG = "notify";
-static int g_check_interval = 43200; // seconds
+static int g_check_interval = 43200; // seconds, upper bound on a single sleep (guards against clock jumps)
 static int g_threshold_days = 3;
+static TaskHandle_t s_notify_task = NULL;
+
+#define SECONDS_PER_DAY 86400
+// 时钟尚未经 SNTP 校准（仍是 1970 年附近）时无法计算到期时刻，先短轮询等待
+#define CLOCK_VALID_EPOCH 1704067200 // 2024-01-01
+#define CLOCK_WAIT_SECONDS 60
+
+typedef struct {
+    time_t now;
+    time_t next_wake; // 0 = nothing scheduled
+    int marked;       // items notified in this scan
+} notify_scan_t;
+
+// items are visited soonest-expiring first, so stop at the first one that cannot
+// reach the threshold at its next day boundary
+static bool notify_visit(const inventory_item_t *it, void *ctx)
+{
+    notify_scan_t *scan = ctx;
+    int64_t left = it->calculated_expiry_date - (int64_t)scan->now;
+
+    if (it->remaining_days <= g_threshold_days &&
+        it->last_notified_remaining_days != it->remaining_days) {
+        // 仅记录日志和刷新 UI，不再语音播报，避免 notify 任务栈溢出
+        ESP_LOGI(TAG, "notify: %s 将在 %d 天后过期", it->name, it->remaining_days);
+        inventory_mark_notified(it, it->remaining_days);
+        scan->marked++;
+    }
+
+    if (left <= 0) return true; // already expired, its day count will not change again
+    // remaining_days = ceil(left / day) drops by one when left reaches the next lower multiple
+    int64_t days = (left + SECONDS_PER_DAY - 1) / SECONDS_PER_DAY;
+    if (days - 1 > g_threshold_days) return false;
+    time_t boundary = (time_t)(it->calculated_expiry_date - (days - 1) * SECONDS_PER_DAY);
+    if (scan->next_wake == 0 || boundary < scan->next_wake) scan->next_wake = boundary;
+    return true;
+}
 
 static void notify_task(void *arg)
 {
     (void)arg;
     while (1) {
-        inventory_item_t **items = NULL;
-        int count = inventory_list_items(&items);
-        if (count > 0 && items) {
+        notify_scan_t scan = { .now = time(NULL), .next_wake = 0 };
+        int64_t sleep_s = g_check_interval;
+        if (scan.now < CLOCK_VALID_EPOCH) {
+            sleep_s = CLOCK_WAIT_SECONDS;
+        } else {
             // only do expiry notifications; do NOT trigger recipe suggestions here
-            for (int i = 0; i < count; ++i) {
-                inventory_item_t *it = items[i];
-                if (!it) continue;
-                if (it->remaining_days <= g_threshold_days) {
-                    if (it->last_notified_remaining_days != it->remaining_days) {
-                        // 仅记录日志和刷新 UI，不再语音播报，避免 notify 任务栈溢出
-                        ESP_LOGI(TAG, "notify: %s 将在 %d 天后过期", it->name, it->remaining_days);
-                        inventory_mark_notified(it, it->remaining_days);
-                        ui_inventory_refresh();
-                    }
-                }
+            // 一次扫描的所有标记在一个库存事务里：一次日志追加、一次同步入队、一次快照发布；UI 最后刷新一次
+            inventory_txn_begin();
+            inventory_foreach_by_expiry(0, notify_visit, &scan);
+            inventory_txn_commit();
+            if (scan.marked) ui_inventory_refresh();
+            if (scan.next_wake) {
+                // +1s so the boundary has definitely passed when we wake
+                int64_t until = (int64_t)scan.next_wake - (int64_t)scan.now + 1;
+                if (until < 1) until = 1;
+                if (until < sleep_s) sleep_s = until;
             }
         }
-        if (items) inventory_free_list(items);
-        vTaskDelay(pdMS_TO_TICKS(g_check_interval * 1000));
+        ESP_LOGD(TAG, "next check in %lld s", (long long)sleep_s);
+        // woken early by notify_rearm() whenever the inventory changes
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(sleep_s * 1000));
     }
 }
 
+void notify_rearm(void)
+{
+    if (s_notify_task) xTaskNotifyGive(s_notify_task);
+}
+
 void notify_init(int check_interval_seconds, int threshold_days)
 {
     if (check_interval_seconds > 0) g_check_interval = check_interval_seconds;
     if (threshold_days >= 0) g_threshold_days = threshold_days;
-    xTaskCreatePinnedToCore(notify_task, "notify", 6*1024, NULL, 5, NULL, 1);
+    xTaskCreatePinnedToCore(notify_task, "notify", 6*1024, NULL, 5, &s_notify_task, 1);
+    inventory_set_change_cb(notify_rearm);
 }
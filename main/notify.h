@@ -2,6 +2,9 @@
 #ifndef _NOTIFY_H_
 #define _NOTIFY_H_
 
+// check_interval_seconds 是单次休眠上限；实际在下一个物品跨过提醒阈值内的整天边界时唤醒
 void notify_init(int check_interval_seconds, int threshold_days);
+// 库存变更后重新计算下一次唤醒时间（notify_init 已自动注册到 inventory）
+void notify_rearm(void);
 
 #endif // _NOTIFY_H_
@@ -3,6 +3,7 @@
 #include <string.h>
 #include <stdio.h>
 #include <ctype.h>
+#include <stdlib.h>
 #include <time.h>
 
 // 本实现为启发式解析，目标在设备端做初步槽位抽取以减少误报和网络调用。
@@ -38,10 +39,11 @@ static int extract_token(const char **p, char *out, int maxlen) {
     return i>0;
 }
 
-int parse_add_command(const char *text, inventory_item_t *out)
+int parse_add_command(const char *text, inventory_item_t *out, parse_strings_t *strs)
 {
-    if (!text || !out) return -1;
+    if (!text || !out || !strs) return -1;
     memset(out, 0, sizeof(*out));
+    memset(strs, 0, sizeof(*strs));
     const char *s = text;
     // simple heuristic: look for keywords 放入/加入/存放
     if (strstr(s, "放入") == NULL && strstr(s, "加入") == NULL && strstr(s, "存放") == NULL) {
@@ -57,7 +59,8 @@ int parse_add_command(const char *text, inventory_item_t *out)
     if (strstr(token, "放入") || strstr(token, "加入") || strstr(token, "存放")) {
         if (!extract_token(&p, token, sizeof(token))) return -1;
     }
-    strncpy(out->name, token, sizeof(out->name)-1);
+    strncpy(strs->name, token, sizeof(strs->name)-1);
+    out->name = strs->name;
 
     // scan remaining text for a number (quantity) or unit or expiry info
     const char *q = p;
@@ -121,18 +124,19 @@ int parse_add_command(const char *text, inventory_item_t *out)
             buf[bi] = '\0';
             // take last word
             char *last = strrchr(buf, ' ');
-            if (last) strncpy(out->location, last+1, sizeof(out->location)-1);
-            else strncpy(out->location, buf, sizeof(out->location)-1);
+            if (last) strncpy(strs->location, last+1, sizeof(strs->location)-1);
+            else strncpy(strs->location, buf, sizeof(strs->location)-1);
+            out->location = strs->location;
             break;
         }
     }
 
     // detect basic category keywords
-    if (strstr(s, "牛奶") || strstr(s, "牛乳") || strstr(s, "milk")) strncpy(out->category, "牛奶", sizeof(out->category)-1);
-    else if (strstr(s, "肉") || strstr(s, "牛肉") || strstr(s, "鸡") || strstr(s, "猪")) strncpy(out->category, "肉类", sizeof(out->category)-1);
-    else if (strstr(s, "菜") || strstr(s, "蔬") || strstr(s, "果") || strstr(s, "青菜")) strncpy(out->category, "蔬果", sizeof(out->category)-1);
-    else if (strstr(s, "熟食") || strstr(s, "熟")) strncpy(out->category, "熟食", sizeof(out->category)-1);
-    else if (strstr(s, "冷冻") || strstr(s, "冰")) strncpy(out->category, "冷冻", sizeof(out->category)-1);
+    if (strstr(s, "牛奶") || strstr(s, "牛乳") || strstr(s, "milk")) out->category = "牛奶";
+    else if (strstr(s, "肉") || strstr(s, "牛肉") || strstr(s, "鸡") || strstr(s, "猪")) out->category = "肉类";
+    else if (strstr(s, "菜") || strstr(s, "蔬") || strstr(s, "果") || strstr(s, "青菜")) out->category = "蔬果";
+    else if (strstr(s, "熟食") || strstr(s, "熟")) out->category = "熟食";
+    else if (strstr(s, "冷冻") || strstr(s, "冰")) out->category = "冷冻";
 
     // default: unit empty, default_shelf_life_days left 0
     return 0;
@@ -4,7 +4,13 @@
 
 #include "inventory.h"
 
-// 解析“放入...数量...位置...时间”类命令，成功返回0并填充 out。
-int parse_add_command(const char *text, inventory_item_t *out);
+// 解析结果中名称/位置字符串的存放处，out 的字符串字段指向这里，使用期间需保持有效
+typedef struct {
+    char name[64];
+    char location[32];
+} parse_strings_t;
+
+// 解析“放入...数量...位置...时间”类命令，成功返回0并填充 out（字符串存放在 strs 中）。
+int parse_add_command(const char *text, inventory_item_t *out, parse_strings_t *strs);
 
 #endif // _PARSER_H_
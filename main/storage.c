@@ -36,3 +36,20 @@ char *storage_read_file(const char *path)
     fclose(f);
     return buf;
 }
+
+int storage_append_file(const char *path, const char *buf)
+{
+    if (!path || !buf) return -1;
+    FILE *f = fopen(path, "a");
+    if (!f) return -1;
+    size_t len = strlen(buf);
+    size_t wr = fwrite(buf, 1, len, f);
+    fclose(f);
+    return (wr == len) ? 0 : -1;
+}
+
+int storage_remove_file(const char *path)
+{
+    if (!path) return -1;
+    return remove(path) == 0 ? 0 : -1;
+}
@@ -4,5 +4,7 @@
 
 int storage_write_file(const char *path, const char *buf);
 char *storage_read_file(const char *path); // return malloc'd buffer, caller must free
+int storage_append_file(const char *path, const char *buf); // append buf to end of file (creates file if missing)
+int storage_remove_file(const char *path);
 
 #endif // _STORAGE_H_
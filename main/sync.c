@@ -1,123 +1,1197 @@
-// sync.c - simple persistent queue and background sync task
+// sync.c - persistent offline event queue and background sync task
 #include "sync.h"
 #include "sync_config.h"
 #include "storage.h"
+#include "json_stream.h"
+#include "wifi.h"
+#include "inventory.h"
 #include "esp_log.h"
-#include "cJSON.h"
+#include "esp_event.h"
+#include "esp_netif.h"
+#include "esp_random.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#if defined(CONFIG_ESP_HTTP_CLIENT)
+#include "freertos/semphr.h"
 #include "esp_http_client.h"
-#endif
+#include "esp_crt_bundle.h"
 #include <string.h>
 #include <time.h>
 #include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <dirent.h>
 
 static const char *TAG = "sync";
-static const char *QUEUE_PATH = "/spiffs/sync_queue.json";
+static const char *LEGACY_QUEUE_PATH = "/spiffs/sync_queue.json"; // old single-array queue, migrated once
+static const char *QUEUE_META_PATH = "/spiffs/syncq.meta";
+static const char *QUEUE_CMP_PATH = "/spiffs/syncq.cmp";     // compaction output before it replaces the segments
+static const char *PULL_CURSOR_PATH = "/spiffs/sync_cursor.txt";
 
-// read queue as cJSON array; caller must cJSON_Delete
-static cJSON *read_queue()
+// ---- queue ---------------------------------------------------------------
+//
+// 队列由若干段文件组成（/spiffs/syncq_NNNNN.jsonl），每行一个事件。入队只向尾段追加，
+// 尾段超过 SYNC_SEG_MAX_BYTES 后换新段；出队只推进头游标（段号 + 段内偏移），读完的段整段删除。
+// 游标保存在很小的 syncq.meta 中，因此入队/出队都是 O(1) 的 I/O，与积压的事件数无关。
+// 最近入队的事件同时留在内存环形缓存里，网络恢复后上传刚产生的事件不必再读闪存。
+// 语义是“至少一次”：上传成功但游标未落盘时掉电，重启后会重发该事件。
+//
+// 压缩：同一 item_id 的事件只保留净效果 —— 最后一条 add_item（整条状态的 upsert）或 remove_item，
+// 以及其后最后一条 notified；被删除的物品只剩 remove_item。上传前对每批事件折叠一次；
+// 积压超过 SYNC_COMPACT_MIN_SEGS 个已封口的段时，sync 任务把这些段整体折叠成一个段。
+
+#define SYNC_SEG_PATH_FMT   "/spiffs/syncq_%05u.jsonl"
+#define SYNC_SEG_PREFIX     "syncq_"
+#define SYNC_SEG_MAX_BYTES  (8 * 1024)
+#define SYNC_RING_SLOTS     8
+#define SYNC_COMPACT_MIN_SEGS 2
+
+typedef struct {
+    uint32_t seg;
+    uint32_t off;
+    char *line;     // event JSON without the trailing '\n'; NULL = empty slot
+    size_t len;     // bytes on flash including '\n'
+} ring_slot_t;
+
+typedef struct {
+    uint32_t head_seg, head_off;  // next event to upload
+    uint32_t tail_seg, tail_off;  // append position (tail_off = size of the tail segment)
+    bool cmp_pending;             // syncq.cmp holds the folded events of segments head_seg..cmp_seg
+    uint32_t cmp_seg;
+    bool ready;
+} queue_state_t;
+
+static queue_state_t s_q;
+static ring_slot_t s_ring[SYNC_RING_SLOTS];
+static int s_ring_next = 0;
+
+static SemaphoreHandle_t s_qlock = NULL;
+static StaticSemaphore_t s_qlock_buf;
+static portMUX_TYPE s_qlock_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static void queue_open(void);
+
+// sync task wake-up reasons (task notification bits)
+#define SYNC_NOTIFY_ENQUEUE (1u << 0)
+#define SYNC_NOTIFY_ONLINE  (1u << 1)
+
+static TaskHandle_t s_sync_task = NULL;
+
+// enqueue can run before sync_init (inventory loads first), so the lock is created on first use
+static void queue_lock(void)
 {
-    char *s = storage_read_file(QUEUE_PATH);
-    if (!s) return cJSON_CreateArray();
-    cJSON *arr = cJSON_Parse(s);
-    free(s);
-    if (!arr) return cJSON_CreateArray();
-    if (!cJSON_IsArray(arr)) { cJSON_Delete(arr); return cJSON_CreateArray(); }
-    return arr;
+    if (!s_qlock) {
+        portENTER_CRITICAL(&s_qlock_mux);
+        if (!s_qlock) s_qlock = xSemaphoreCreateMutexStatic(&s_qlock_buf);
+        portEXIT_CRITICAL(&s_qlock_mux);
+    }
+    xSemaphoreTake(s_qlock, portMAX_DELAY);
+    if (!s_q.ready) queue_open();
+}
+
+static void queue_unlock(void)
+{
+    xSemaphoreGive(s_qlock);
 }
 
-static int write_queue(cJSON *arr)
+static void seg_path(char *out, size_t size, uint32_t seg)
 {
-    if (!arr) return -1;
-    char *s = cJSON_PrintUnformatted(arr);
-    if (!s) return -1;
-    int rc = storage_write_file(QUEUE_PATH, s);
+    snprintf(out, size, SYNC_SEG_PATH_FMT, (unsigned)seg);
+}
+
+static int meta_write(void)
+{
+    char buf[64];
+    int n = snprintf(buf, sizeof(buf), "%u %u %u", (unsigned)s_q.head_seg, (unsigned)s_q.head_off, (unsigned)s_q.tail_seg);
+    if (s_q.cmp_pending) n += snprintf(buf + n, sizeof(buf) - n, " %u", (unsigned)s_q.cmp_seg);
+    snprintf(buf + n, sizeof(buf) - n, "\n");
+    return storage_write_file(QUEUE_META_PATH, buf);
+}
+
+static bool meta_read(void)
+{
+    char *s = storage_read_file(QUEUE_META_PATH);
+    if (!s) return false;
+    unsigned hs, ho, ts, cs;
+    int n = sscanf(s, "%u %u %u %u", &hs, &ho, &ts, &cs);
+    bool ok = n >= 3 && hs <= ts && (n == 3 || (cs >= hs && cs < ts));
     free(s);
+    if (ok) {
+        s_q.head_seg = hs;
+        s_q.head_off = ho;
+        s_q.tail_seg = ts;
+        s_q.cmp_pending = n == 4;
+        s_q.cmp_seg = n == 4 ? cs : 0;
+    }
+    return ok;
+}
+
+// meta lost or corrupt: rebuild the cursors from the segment files present (may resend the head segment)
+static void meta_rebuild(void)
+{
+    bool any = false;
+    uint32_t lo = 0, hi = 0;
+    DIR *d = opendir("/spiffs");
+    if (d) {
+        struct dirent *e;
+        while ((e = readdir(d)) != NULL) {
+            unsigned n;
+            if (sscanf(e->d_name, SYNC_SEG_PREFIX "%u", &n) != 1) continue;
+            if (!any || n < lo) lo = n;
+            if (!any || n > hi) hi = n;
+            any = true;
+        }
+        closedir(d);
+    }
+    s_q.head_seg = lo;
+    s_q.head_off = 0;
+    s_q.tail_seg = hi;
+    ESP_LOGW(TAG, "queue cursor rebuilt: segments %u..%u", (unsigned)lo, (unsigned)hi);
+}
+
+static long file_size(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+    fseek(f, 0, SEEK_END);
+    long sz = ftell(f);
+    fclose(f);
+    return sz;
+}
+
+// true if the file ends with '\n' (or is empty)
+static bool ends_with_newline(const char *path, long size)
+{
+    if (size <= 0) return true;
+    FILE *f = fopen(path, "r");
+    if (!f) return true;
+    fseek(f, size - 1, SEEK_SET);
+    int c = fgetc(f);
+    fclose(f);
+    return c == '\n';
+}
+
+static void ring_clear(void)
+{
+    for (int i = 0; i < SYNC_RING_SLOTS; ++i) {
+        free(s_ring[i].line);
+        s_ring[i].line = NULL;
+    }
+}
+
+static void ring_put(uint32_t seg, uint32_t off, const char *line, size_t len)
+{
+    ring_slot_t *r = &s_ring[s_ring_next];
+    s_ring_next = (s_ring_next + 1) % SYNC_RING_SLOTS;
+    free(r->line);
+    r->line = malloc(len);
+    if (!r->line) return;
+    memcpy(r->line, line, len - 1);
+    r->line[len - 1] = '\0';
+    r->seg = seg;
+    r->off = off;
+    r->len = len;
+}
+
+static const ring_slot_t *ring_find(uint32_t seg, uint32_t off)
+{
+    for (int i = 0; i < SYNC_RING_SLOTS; ++i) {
+        if (s_ring[i].line && s_ring[i].seg == seg && s_ring[i].off == off) return &s_ring[i];
+    }
+    return NULL;
+}
+
+// raw append of already formatted lines to the tail segment, rolling to a new segment when it is full
+static int queue_append(const char *lines, size_t len)
+{
+    char path[40];
+    seg_path(path, sizeof(path), s_q.tail_seg);
+    FILE *f = fopen(path, "a");
+    if (!f) return -1;
+    size_t wr = fwrite(lines, 1, len, f);
+    int rc = (fclose(f) == 0 && wr == len) ? 0 : -1;
+    if (rc != 0) {
+        // a partial write leaves a torn line: isolate it by starting a fresh segment
+        s_q.tail_seg++;
+        s_q.tail_off = 0;
+        meta_write();
+        return -1;
+    }
+    s_q.tail_off += len;
+    if (s_q.tail_off >= SYNC_SEG_MAX_BYTES) {
+        s_q.tail_seg++;
+        s_q.tail_off = 0;
+        meta_write();
+    }
+    return 0;
+}
+
+// read one line of the head segment starting at head_off; *consumed gets its length on flash
+static char *seg_read_line(uint32_t seg, uint32_t off, size_t *consumed, bool *at_eof)
+{
+    char path[40];
+    seg_path(path, sizeof(path), seg);
+    *at_eof = true;
+    FILE *f = fopen(path, "r");
+    if (!f) return NULL;
+    if (fseek(f, off, SEEK_SET) != 0) { fclose(f); return NULL; }
+    size_t cap = 256, len = 0;
+    char *line = malloc(cap);
+    int c = EOF;
+    while (line && (c = fgetc(f)) != EOF && c != '\n') {
+        if (len + 1 >= cap) {
+            char *n = realloc(line, cap * 2);
+            if (!n) { free(line); line = NULL; break; }
+            line = n;
+            cap *= 2;
+        }
+        line[len++] = (char)c;
+    }
+    fclose(f);
+    if (!line) { *at_eof = false; return NULL; }
+    if (c != '\n') { free(line); return NULL; } // EOF, or a torn line without its '\n'
+    *at_eof = false;
+    line[len] = '\0';
+    *consumed = len + 1;
+    return line;
+}
+
+typedef struct {
+    uint32_t seg;
+    uint32_t off;
+} queue_pos_t;
+
+// event at *pos (caller frees), skipping blank lines and finished segments; on return *pos is the
+// position of that event and *consumed its length on flash. NULL when nothing is left. lock held
+static char *queue_read_at(queue_pos_t *pos, size_t *consumed)
+{
+    for (;;) {
+        const ring_slot_t *r = ring_find(pos->seg, pos->off);
+        if (r) {
+            char *s = strdup(r->line);
+            if (s) *consumed = r->len;
+            return s;
+        }
+        if (pos->seg == s_q.tail_seg && pos->off >= s_q.tail_off) return NULL;
+        bool at_eof;
+        char *s = seg_read_line(pos->seg, pos->off, consumed, &at_eof);
+        if (s && s[0] == '\0') { // blank line
+            free(s);
+            pos->off += *consumed;
+            continue;
+        }
+        if (s || !at_eof) return s;
+        if (pos->seg == s_q.tail_seg) return NULL;
+        // segment fully consumed (or ends in a torn line): continue with the next one
+        pos->seg++;
+        pos->off = 0;
+    }
+}
+
+// ---- compaction ------------------------------------------------------------
+
+typedef enum { EV_OTHER, EV_STATE, EV_REMOVE, EV_NOTIFIED } ev_kind_t;
+
+// event kind and payload item_id, from the fixed layout write_event() produces; anything else is EV_OTHER
+static ev_kind_t event_kind(const char *line, char *id, size_t id_size)
+{
+    ev_kind_t k;
+    if (strncmp(line, "{\"type\":\"add_item\"", 18) == 0) k = EV_STATE;
+    else if (strncmp(line, "{\"type\":\"remove_item\"", 21) == 0) k = EV_REMOVE;
+    else if (strncmp(line, "{\"type\":\"notified\"", 18) == 0) k = EV_NOTIFIED;
+    else return EV_OTHER;
+    const char *p = strstr(line, "\"item_id\":\"");
+    if (!p) return EV_OTHER;
+    p += 11;
+    size_t n = 0;
+    while (p[n] && p[n] != '"' && p[n] != '\\' && n + 1 < id_size) n++;
+    if (p[n] != '"' || n == 0) return EV_OTHER; // escaped or oversized ids are left alone
+    memcpy(id, p, n);
+    id[n] = '\0';
+    return k;
+}
+
+typedef struct {
+    char id[32];
+    int last_state;     // sequence number of the last add_item/remove_item, -1 if none
+    int last_notified;
+    bool removed;
+} fold_entry_t;
+
+// open-addressing table item_id -> latest events; on OOM folding is disabled and every event is kept
+typedef struct {
+    fold_entry_t *e;
+    uint32_t cap;
+    uint32_t used;
+    bool failed;
+} fold_t;
+
+static uint32_t fold_hash(const char *id)
+{
+    uint32_t h = 2166136261u;
+    while (*id) { h ^= (uint8_t)*id++; h *= 16777619u; }
+    return h;
+}
+
+static fold_entry_t *fold_find(fold_t *f, const char *id, bool create)
+{
+    if (create && (f->used + 1) * 10 > f->cap * 7) {
+        uint32_t cap = f->cap ? f->cap * 2 : 64;
+        fold_entry_t *e = calloc(cap, sizeof(*e));
+        if (!e) { f->failed = true; return NULL; }
+        for (uint32_t i = 0; i < f->cap; ++i) {
+            if (!f->e[i].id[0]) continue;
+            uint32_t j = fold_hash(f->e[i].id) & (cap - 1);
+            while (e[j].id[0]) j = (j + 1) & (cap - 1);
+            e[j] = f->e[i];
+        }
+        free(f->e);
+        f->e = e;
+        f->cap = cap;
+    }
+    if (!f->cap) return NULL;
+    uint32_t i = fold_hash(id) & (f->cap - 1);
+    while (f->e[i].id[0]) {
+        if (strcmp(f->e[i].id, id) == 0) return &f->e[i];
+        i = (i + 1) & (f->cap - 1);
+    }
+    if (!create) return NULL;
+    fold_entry_t *e = &f->e[i];
+    strcpy(e->id, id);
+    e->last_state = -1;
+    e->last_notified = -1;
+    f->used++;
+    return e;
+}
+
+// pass 1: remember the latest events of each item
+static void fold_note(fold_t *f, int seq, const char *line)
+{
+    char id[32];
+    ev_kind_t k = event_kind(line, id, sizeof(id));
+    if (k == EV_OTHER || f->failed) return;
+    fold_entry_t *e = fold_find(f, id, true);
+    if (!e) return;
+    if (k == EV_NOTIFIED) {
+        e->last_notified = seq;
+    } else {
+        e->last_state = seq;
+        e->removed = k == EV_REMOVE;
+    }
+}
+
+// pass 2: an event survives if nothing later supersedes it
+static bool fold_keep(fold_t *f, int seq, const char *line)
+{
+    char id[32];
+    ev_kind_t k = event_kind(line, id, sizeof(id));
+    if (k == EV_OTHER || f->failed) return true;
+    fold_entry_t *e = fold_find(f, id, false);
+    if (!e) return true;
+    if (k != EV_NOTIFIED) return seq == e->last_state;
+    // add_item resets the notification state, and a removed item needs no notification
+    return seq == e->last_notified && !e->removed && seq > e->last_state;
+}
+
+static void fold_free(fold_t *f)
+{
+    free(f->e);
+    memset(f, 0, sizeof(*f));
+}
+
+// up to max_events / max_bytes events from the head, folded, as one JSON array (caller frees).
+// ends[i] is the queue position for acknowledging sent events 0..i: just past event i and the events folded
+// away between it and the next sent one. Popping to it drops those too: each was superseded by a later
+// event still in the queue, or is a notification for an item whose removal (earlier, sent) makes it moot.
+// The first event is always taken. lock held
+static char *queue_peek_batch(int max_events, size_t max_bytes, queue_pos_t *ends, int *count)
+{
+    char *lines[SYNC_BATCH_MAX_EVENTS];
+    queue_pos_t at_end[SYNC_BATCH_MAX_EVENTS];
+    if (max_events > SYNC_BATCH_MAX_EVENTS) max_events = SYNC_BATCH_MAX_EVENTS;
+    queue_pos_t pos = { s_q.head_seg, s_q.head_off };
+    size_t bytes = 2;
+    int n = 0;
+    while (n < max_events) {
+        size_t consumed;
+        queue_pos_t at = pos;
+        char *s = queue_read_at(&at, &consumed);
+        if (!s) break;
+        size_t len = strlen(s);
+        if (n > 0 && bytes + len + 1 > max_bytes) { free(s); break; }
+        bytes += len + 1;
+        pos.seg = at.seg;
+        pos.off = at.off + consumed;
+        lines[n] = s;
+        at_end[n++] = pos;
+    }
+    *count = 0;
+    if (n == 0) return NULL;
+
+    fold_t fold = { 0 };
+    for (int i = 0; i < n; ++i) fold_note(&fold, i, lines[i]);
+    json_writer_t w;
+    json_writer_init_mem(&w);
+    json_w_arr_begin(&w);
+    int sent = 0;
+    for (int i = 0; i < n; ++i) {
+        // the last state event of each item survives, so sent > 0 and ends[sent-1] covers the whole batch,
+        // including a trailing notified folded away behind a remove_item
+        if (fold_keep(&fold, i, lines[i])) {
+            json_w_value_raw(&w, lines[i]);
+            ends[sent++] = at_end[i];
+        } else if (sent > 0) {
+            ends[sent - 1] = at_end[i];
+        }
+        free(lines[i]);
+    }
+    json_w_arr_end(&w);
+    fold_free(&fold);
+    if (sent < n) ESP_LOGI(TAG, "batch folded %d -> %d event(s)", n, sent);
+    *count = sent;
+    return json_writer_take(&w);
+}
+
+// advance the head to end (returned by queue_peek_batch), deleting the segments passed over. lock held
+static int queue_pop_to(queue_pos_t end)
+{
+    char path[40];
+    while (s_q.head_seg < end.seg) {
+        seg_path(path, sizeof(path), s_q.head_seg);
+        storage_remove_file(path);
+        s_q.head_seg++;
+    }
+    s_q.head_off = end.off;
+    if (s_q.head_seg == s_q.tail_seg && s_q.head_off >= s_q.tail_off && s_q.tail_off > 0) {
+        // drained: start over in a fresh segment so the old one can be deleted
+        seg_path(path, sizeof(path), s_q.tail_seg);
+        storage_remove_file(path);
+        s_q.tail_seg++;
+        s_q.tail_off = 0;
+        s_q.head_seg = s_q.tail_seg;
+        s_q.head_off = 0;
+    }
+    return meta_write();
+}
+
+// call fn for every complete line of the sealed segments [head_seg, end_seg), starting at head_off
+static int sealed_foreach(uint32_t head_seg, uint32_t head_off, uint32_t end_seg,
+                          void (*fn)(const char *line, int seq, void *ctx), void *ctx)
+{
+    size_t cap = 256;
+    char *line = malloc(cap);
+    if (!line) return -1;
+    int seq = 0;
+    for (uint32_t seg = head_seg; seg < end_seg; ++seg) {
+        char path[40];
+        seg_path(path, sizeof(path), seg);
+        FILE *f = fopen(path, "r");
+        if (!f) continue;
+        if (seg == head_seg) fseek(f, head_off, SEEK_SET);
+        size_t len = 0;
+        int c;
+        while ((c = fgetc(f)) != EOF) {
+            if (c != '\n') {
+                if (len + 1 >= cap) {
+                    char *n = realloc(line, cap * 2);
+                    if (!n) { fclose(f); free(line); return -1; }
+                    line = n;
+                    cap *= 2;
+                }
+                line[len++] = (char)c;
+                continue;
+            }
+            line[len] = '\0';
+            if (len > 0) fn(line, seq++, ctx);
+            len = 0;
+        }
+        fclose(f); // a trailing line without '\n' is torn and skipped
+    }
+    free(line);
+    return seq;
+}
+
+typedef struct {
+    fold_t fold;
+    FILE *out;
+    int kept;
+    bool failed;
+} compact_ctx_t;
+
+static void compact_note(const char *line, int seq, void *arg)
+{
+    fold_note(&((compact_ctx_t *)arg)->fold, seq, line);
+}
+
+static void compact_copy(const char *line, int seq, void *arg)
+{
+    compact_ctx_t *c = arg;
+    if (!fold_keep(&c->fold, seq, line)) return;
+    if (fputs(line, c->out) < 0 || fputc('\n', c->out) == EOF) c->failed = true;
+    c->kept++;
+}
+
+// swap syncq.cmp in for segments head_seg..cmp_seg; also finishes a swap interrupted by a reset. lock held
+static int compact_finish(void)
+{
+    char path[40];
+    FILE *f = fopen(QUEUE_CMP_PATH, "r");
+    if (f) {
+        fclose(f);
+        for (uint32_t seg = s_q.head_seg; seg <= s_q.cmp_seg; ++seg) {
+            seg_path(path, sizeof(path), seg);
+            storage_remove_file(path);
+        }
+        seg_path(path, sizeof(path), s_q.cmp_seg);
+        if (rename(QUEUE_CMP_PATH, path) != 0) {
+            ESP_LOGE(TAG, "failed to install compacted segment %u", (unsigned)s_q.cmp_seg);
+            return -1;
+        }
+    }
+    // no syncq.cmp while the swap is pending means the rename already happened
+    for (int i = 0; i < SYNC_RING_SLOTS; ++i) {
+        if (s_ring[i].line && s_ring[i].seg <= s_q.cmp_seg) {
+            free(s_ring[i].line);
+            s_ring[i].line = NULL;
+        }
+    }
+    s_q.head_seg = s_q.cmp_seg;
+    s_q.head_off = 0;
+    s_q.cmp_pending = false;
+    return meta_write();
+}
+
+// fold the sealed part of the backlog into one segment. Runs in the sync task (the only consumer), so
+// the sealed segments cannot change underneath; producers keep appending to the tail meanwhile
+static void queue_compact(void)
+{
+    static uint32_t s_checked_head = UINT32_MAX, s_checked_end = UINT32_MAX;
+    queue_lock();
+    uint32_t head_seg = s_q.head_seg, head_off = s_q.head_off, end_seg = s_q.tail_seg;
+    queue_unlock();
+    if (end_seg - head_seg < SYNC_COMPACT_MIN_SEGS) return;
+    if (head_seg == s_checked_head && end_seg == s_checked_end) return; // nothing new since the last pass
+    s_checked_head = head_seg;
+    s_checked_end = end_seg;
+
+    compact_ctx_t c = { 0 };
+    int total = sealed_foreach(head_seg, head_off, end_seg, compact_note, &c);
+    if (total <= 0 || c.fold.failed) { fold_free(&c.fold); return; }
+    c.out = fopen(QUEUE_CMP_PATH, "w");
+    if (!c.out) { fold_free(&c.fold); return; }
+    int rc = sealed_foreach(head_seg, head_off, end_seg, compact_copy, &c);
+    if (fclose(c.out) != 0) c.failed = true;
+    fold_free(&c.fold);
+    if (rc != total || c.failed || c.kept == total) {
+        storage_remove_file(QUEUE_CMP_PATH);
+        if (c.failed) ESP_LOGE(TAG, "queue compaction failed");
+        return;
+    }
+
+    queue_lock();
+    s_q.cmp_pending = true;
+    s_q.cmp_seg = end_seg - 1;
+    if (meta_write() == 0) {
+        compact_finish();
+        s_checked_head = s_q.head_seg;
+    } else {
+        s_q.cmp_pending = false;
+        storage_remove_file(QUEUE_CMP_PATH);
+    }
+    queue_unlock();
+    ESP_LOGI(TAG, "queue compacted: %d -> %d event(s) in segments %u..%u",
+             total, c.kept, (unsigned)head_seg, (unsigned)(end_seg - 1));
+}
+
+// move events from the old single-array queue file into segments, one event per line
+typedef struct {
+    FILE *src;
+    long begin;
+    int moved;
+    bool failed;
+} legacy_ctx_t;
+
+static bool legacy_token(const json_token_t *t, void *arg)
+{
+    legacy_ctx_t *c = arg;
+    if (t->depth == 0) return t->type == JSON_TOK_ARR_BEGIN || t->type == JSON_TOK_ARR_END;
+    if (t->depth != 1) return true;
+    if (t->type != JSON_TOK_OBJ_END && t->type != JSON_TOK_ARR_END) c->begin = (long)t->offset;
+    if (t->type == JSON_TOK_OBJ_BEGIN || t->type == JSON_TOK_ARR_BEGIN) return true;
+    // a whole event [begin, end) has been seen: copy its bytes out through the second handle
+    size_t len = t->end - (size_t)c->begin;
+    char *line = malloc(len + 1);
+    if (!line || fseek(c->src, c->begin, SEEK_SET) != 0 || fread(line, 1, len, c->src) != len) {
+        free(line);
+        c->failed = true;
+        return false;
+    }
+    for (size_t i = 0; i < len; ++i) {
+        if (line[i] == '\n' || line[i] == '\r') line[i] = ' '; // only whitespace can hold raw newlines
+    }
+    line[len] = '\n';
+    if (queue_append(line, len + 1) != 0) c->failed = true;
+    else c->moved++;
+    free(line);
+    return !c->failed;
+}
+
+static void legacy_migrate(void)
+{
+    legacy_ctx_t c = { .src = fopen(LEGACY_QUEUE_PATH, "r") };
+    if (!c.src) return;
+    int rc = json_stream_parse_file(LEGACY_QUEUE_PATH, legacy_token, &c);
+    fclose(c.src);
+    meta_write();
+    if (c.failed) {
+        ESP_LOGE(TAG, "legacy queue migration failed after %d event(s), will retry", c.moved);
+        return;
+    }
+    if (rc != 0) ESP_LOGW(TAG, "legacy queue corrupt, kept %d event(s)", c.moved);
+    else ESP_LOGI(TAG, "migrated %d event(s) from legacy queue", c.moved);
+    storage_remove_file(LEGACY_QUEUE_PATH);
+}
+
+static void queue_open(void)
+{
+    memset(&s_q, 0, sizeof(s_q));
+    ring_clear();
+    if (!meta_read()) meta_rebuild();
+    if (s_q.cmp_pending) compact_finish();
+    else storage_remove_file(QUEUE_CMP_PATH); // compaction output that was never committed
+    char path[40];
+    seg_path(path, sizeof(path), s_q.tail_seg);
+    long sz = file_size(path);
+    s_q.tail_off = sz > 0 ? (uint32_t)sz : 0;
+    if (!ends_with_newline(path, sz)) {
+        // power cut during an append: never append after a torn line
+        ESP_LOGW(TAG, "torn tail in segment %u, starting a new one", (unsigned)s_q.tail_seg);
+        s_q.tail_seg++;
+        s_q.tail_off = 0;
+    }
+    if (s_q.head_seg == s_q.tail_seg && s_q.head_off > s_q.tail_off) s_q.head_off = s_q.tail_off;
+    meta_write();
+    s_q.ready = true;
+    legacy_migrate();
+}
+
+// {"type":..,"payload":..,"ts":..}; the payload is embedded as-is when it is a JSON object/array
+static void write_event(json_writer_t *w, const char *event_type, const char *payload_json)
+{
+    const char *p = payload_json;
+    while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') p++;
+    json_w_obj_begin(w);
+    json_w_kv_str(w, "type", event_type);
+    json_w_key(w, "payload");
+    if (*p == '{' || *p == '[') json_w_value_raw(w, p);
+    else json_w_str(w, payload_json);
+    json_w_kv_int(w, "ts", (int64_t)time(NULL));
+    json_w_obj_end(w);
+}
+
+int sync_enqueue_batch(const char *const *event_types, const char *const *payloads_json, int count)
+{
+    if (!event_types || !payloads_json || count <= 0) return -1;
+    // all lines of the batch are built in memory and hit flash as a single append
+    json_writer_t w;
+    json_writer_init_mem(&w);
+    size_t starts[count];
+    int n = 0;
+    for (int i = 0; i < count; ++i) {
+        if (!event_types[i] || !payloads_json[i]) continue;
+        starts[n++] = w.len;
+        write_event(&w, event_types[i], payloads_json[i]);
+        json_w_bytes(&w, "\n", 1);
+    }
+    size_t total = w.len;
+    char *lines = json_writer_take(&w);
+    if (!lines) return -1;
+    if (n == 0) { free(lines); return 0; }
+
+    queue_lock();
+    uint32_t seg = s_q.tail_seg, base = s_q.tail_off;
+    int rc = queue_append(lines, total);
+    if (rc == 0) {
+        for (int i = 0; i < n; ++i) {
+            size_t end = (i + 1 < n) ? starts[i + 1] : total;
+            ring_put(seg, base + starts[i], lines + starts[i], end - starts[i]);
+        }
+    }
+    queue_unlock();
+    free(lines);
+    if (rc == 0) ESP_LOGI(TAG, "enqueued %d event(s), first %s", n, event_types[0]);
+    else ESP_LOGE(TAG, "failed to enqueue %d event(s)", n);
+    if (rc == 0 && s_sync_task) xTaskNotify(s_sync_task, SYNC_NOTIFY_ENQUEUE, eSetBits);
     return rc;
 }
 
 int sync_enqueue_event(const char *event_type, const char *payload_json)
 {
     if (!event_type || !payload_json) return -1;
-    cJSON *arr = read_queue();
-    cJSON *ev = cJSON_CreateObject();
-    cJSON_AddStringToObject(ev, "type", event_type);
-    cJSON *payload = cJSON_Parse(payload_json);
-    if (!payload) payload = cJSON_CreateString(payload_json);
-    cJSON_AddItemToObject(ev, "payload", payload);
-    cJSON_AddNumberToObject(ev, "ts", (double)time(NULL));
-    cJSON_AddItemToArray(arr, ev);
-    int rc = write_queue(arr);
-    cJSON_Delete(arr);
-    ESP_LOGI(TAG, "enqueued event %s", event_type);
-    return rc;
+    return sync_enqueue_batch(&event_type, &payload_json, 1);
 }
 
-#if defined(CONFIG_ESP_HTTP_CLIENT)
-static int post_event_to_server(const char *json, int len)
+// POST a JSON array of events. Returns how many leading events the server accepted, or -1.
+// The server may answer {"acked":N} to accept only the first N; any other 2xx reply accepts all
+static int post_events_to_server(const char *json, int len, int count)
 {
-    esp_http_client_config_t config = { .url = SYNC_API_URL };
+    esp_http_client_config_t config = {
+        .url = SYNC_API_URL,
+        .method = HTTP_METHOD_POST,
+        .crt_bundle_attach = esp_crt_bundle_attach,
+    };
     esp_http_client_handle_t client = esp_http_client_init(&config);
     if (!client) return -1;
     esp_http_client_set_header(client, "Content-Type", "application/json");
-    esp_http_client_set_post_field(client, json, len);
-    esp_err_t err = esp_http_client_perform(client);
-    if (err != ESP_OK) {
-        esp_http_client_cleanup(client);
-        return -1;
+    int acked = -1;
+    if (esp_http_client_open(client, len) == ESP_OK) {
+        if (esp_http_client_write(client, json, len) == len && esp_http_client_fetch_headers(client) >= 0) {
+            char resp[128];
+            int rlen = esp_http_client_read_response(client, resp, sizeof(resp) - 1);
+            resp[rlen > 0 ? rlen : 0] = '\0';
+            int status = esp_http_client_get_status_code(client);
+            if (status >= 200 && status < 300) {
+                acked = count;
+                const char *a = strstr(resp, "\"acked\"");
+                if (a && (a = strchr(a, ':')) != NULL) {
+                    int n = atoi(a + 1);
+                    if (n >= 0 && n < count) acked = n;
+                }
+            } else {
+                ESP_LOGW(TAG, "sync upload rejected: HTTP %d", status);
+            }
+        }
+        esp_http_client_close(client);
+    }
+    esp_http_client_cleanup(client);
+    return acked;
+}
+
+// batch size adapts AIMD-style: grows while uploads are fast, halves on slow round trips or failures
+static int s_batch_limit = SYNC_BATCH_MIN_EVENTS;
+
+static void batch_adapt(bool ok, uint32_t rtt_ms)
+{
+    if (ok && rtt_ms < SYNC_BATCH_RTT_TARGET_MS / 2) s_batch_limit *= 2;
+    else if (!ok || rtt_ms > SYNC_BATCH_RTT_TARGET_MS) s_batch_limit /= 2;
+    if (s_batch_limit < SYNC_BATCH_MIN_EVENTS) s_batch_limit = SYNC_BATCH_MIN_EVENTS;
+    if (s_batch_limit > SYNC_BATCH_MAX_EVENTS) s_batch_limit = SYNC_BATCH_MAX_EVENTS;
+}
+
+// upload one batch from the head of the queue; returns events acknowledged, 0 if the queue is empty, -1 on failure
+static int sync_upload_batch(void)
+{
+    queue_pos_t ends[SYNC_BATCH_MAX_EVENTS];
+    int count = 0;
+    queue_lock();
+    char *body = queue_peek_batch(s_batch_limit, SYNC_BATCH_MAX_BYTES, ends, &count);
+    queue_unlock();
+    if (!body) return 0;
+
+    // the lock is not held across the upload; this task is the only consumer so the head stays put
+    TickType_t t0 = xTaskGetTickCount();
+    int acked = post_events_to_server(body, strlen(body), count);
+    uint32_t rtt_ms = (uint32_t)((xTaskGetTickCount() - t0) * portTICK_PERIOD_MS);
+    free(body);
+    batch_adapt(acked == count, rtt_ms);
+    if (acked > 0) {
+        queue_lock();
+        queue_pop_to(ends[acked - 1]);
+        queue_unlock();
+    }
+    ESP_LOGI(TAG, "sync batch: %d/%d event(s) acked in %u ms, next limit %d",
+             acked > 0 ? acked : 0, count, (unsigned)rtt_ms, s_batch_limit);
+    return acked > 0 ? acked : -1;
+}
+
+// ---- delta pull ------------------------------------------------------------
+//
+// GET SYNC_API_URL SYNC_PULL_PATH?since=<cursor>&limit=N 返回自 cursor 以来服务端上变化过的条目：
+//   {"cursor":"..","more":false,"changes":[{"item_id":..,"version":..,"updated_time":..,"deleted":false,"name":..,...}]}
+// 整页收进内存后在一个库存事务里解析，每条变更按 inventory_apply_remote 的“后写者胜”规则合入，
+// 整页处理完才保存新 cursor（中途失败会重取该页，合入是幂等的）。只在本地队列清空后拉取，保证服务端先看到本设备的修改。
+
+#define SYNC_CURSOR_MAX 64
+
+typedef struct {
+    char top_key[16];
+    char key[32];
+    bool in_changes;
+    inventory_item_t item;
+    bool deleted;
+    char name[128];
+    char category[64];
+    char unit[32];
+    char location[64];
+    char notes[256];
+    char photo_url[256];
+    char cursor[SYNC_CURSOR_MAX];
+    bool more;
+    int seen;
+    int applied;
+} pull_ctx_t;
+
+static char s_cursor[SYNC_CURSOR_MAX];
+static bool s_cursor_loaded = false;
+
+static void pull_set_str(pull_ctx_t *c, const char *v)
+{
+    struct { const char *key; char *buf; size_t size; const char **field; } map[] = {
+        { "name", c->name, sizeof(c->name), &c->item.name },
+        { "category", c->category, sizeof(c->category), &c->item.category },
+        { "unit", c->unit, sizeof(c->unit), &c->item.unit },
+        { "location", c->location, sizeof(c->location), &c->item.location },
+        { "notes", c->notes, sizeof(c->notes), &c->item.notes },
+        { "photo_url", c->photo_url, sizeof(c->photo_url), &c->item.photo_url },
+    };
+    if (strcmp(c->key, "item_id") == 0) {
+        strncpy(c->item.item_id, v, sizeof(c->item.item_id)-1);
+        return;
+    }
+    for (size_t i = 0; i < sizeof(map) / sizeof(map[0]); ++i) {
+        if (strcmp(c->key, map[i].key) == 0) {
+            strncpy(map[i].buf, v, map[i].size - 1);
+            map[i].buf[map[i].size - 1] = '\0';
+            *map[i].field = map[i].buf;
+            return;
+        }
+    }
+}
+
+static void pull_set_num(pull_ctx_t *c, double v)
+{
+    inventory_item_t *it = &c->item;
+    if (strcmp(c->key, "quantity") == 0) it->quantity = (int)v;
+    else if (strcmp(c->key, "added_time") == 0) it->added_time = (int64_t)v;
+    else if (strcmp(c->key, "default_shelf_life_days") == 0) it->default_shelf_life_days = (int)v;
+    else if (strcmp(c->key, "version") == 0) it->version = (uint32_t)v;
+    else if (strcmp(c->key, "updated_time") == 0) it->updated_time = (int64_t)v;
+}
+
+// depth 0: response object, 1: its fields, 2: change objects, 3: their fields
+static bool pull_token(const json_token_t *t, void *arg)
+{
+    pull_ctx_t *c = arg;
+    if (t->depth == 0) return t->type == JSON_TOK_OBJ_BEGIN || t->type == JSON_TOK_OBJ_END;
+    if (t->depth == 1) {
+        switch (t->type) {
+        case JSON_TOK_KEY:
+            strncpy(c->top_key, t->str, sizeof(c->top_key)-1);
+            c->top_key[sizeof(c->top_key)-1] = '\0';
+            break;
+        case JSON_TOK_STRING:
+            if (strcmp(c->top_key, "cursor") == 0 && !t->truncated && t->len < sizeof(c->cursor)) {
+                memcpy(c->cursor, t->str, t->len + 1);
+            }
+            break;
+        case JSON_TOK_TRUE:
+        case JSON_TOK_FALSE:
+            if (strcmp(c->top_key, "more") == 0) c->more = t->type == JSON_TOK_TRUE;
+            break;
+        case JSON_TOK_ARR_BEGIN:
+            c->in_changes = strcmp(c->top_key, "changes") == 0;
+            break;
+        case JSON_TOK_ARR_END:
+            c->in_changes = false;
+            break;
+        default:
+            break;
+        }
+        return true;
+    }
+    if (!c->in_changes) return true;
+    if (t->depth == 2) {
+        if (t->type == JSON_TOK_OBJ_BEGIN) {
+            memset(&c->item, 0, sizeof(c->item));
+            c->deleted = false;
+            c->key[0] = '\0';
+        } else if (t->type == JSON_TOK_OBJ_END) {
+            c->seen++;
+            if (inventory_apply_remote(&c->item, c->deleted) == 1) c->applied++;
+        }
+        return true;
+    }
+    if (t->depth != 3) return true;
+    switch (t->type) {
+    case JSON_TOK_KEY:
+        strncpy(c->key, t->str, sizeof(c->key)-1);
+        c->key[sizeof(c->key)-1] = '\0';
+        break;
+    case JSON_TOK_STRING:
+        pull_set_str(c, t->str);
+        break;
+    case JSON_TOK_NUMBER:
+        pull_set_num(c, t->num);
+        break;
+    case JSON_TOK_TRUE:
+    case JSON_TOK_FALSE:
+        if (strcmp(c->key, "deleted") == 0) c->deleted = t->type == JSON_TOK_TRUE;
+        break;
+    default:
+        break;
+    }
+    return true;
+}
+
+// percent-encode an opaque cursor for the query string
+static void url_encode(char *out, size_t size, const char *in)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    size_t n = 0;
+    for (; *in && n + 4 < size; ++in) {
+        unsigned char ch = (unsigned char)*in;
+        if ((ch >= 'A' && ch <= 'Z') || (ch >= 'a' && ch <= 'z') || (ch >= '0' && ch <= '9') ||
+            ch == '-' || ch == '_' || ch == '.' || ch == '~') {
+            out[n++] = (char)ch;
+        } else {
+            out[n++] = '%';
+            out[n++] = hex[ch >> 4];
+            out[n++] = hex[ch & 0xF];
+        }
+    }
+    out[n] = '\0';
+}
+
+typedef struct {
+    const char *p;
+    size_t left;
+} mem_src_t;
+
+static size_t mem_read(void *src, char *buf, size_t size)
+{
+    mem_src_t *m = src;
+    size_t n = size < m->left ? size : m->left;
+    memcpy(buf, m->p, n);
+    m->p += n;
+    m->left -= n;
+    return n;
+}
+
+// GET one page of remote changes into memory (caller frees); NULL on failure
+// page size for the next pull request: halved while pages come back over SYNC_PULL_MAX_BYTES, grown back
+// towards SYNC_PULL_PAGE after each page that fits
+static int s_pull_limit = SYNC_PULL_PAGE;
+
+// *too_big is set when the page did not fit in SYNC_PULL_MAX_BYTES
+static char *pull_fetch(size_t *out_len, bool *too_big)
+{
+    char enc[SYNC_CURSOR_MAX * 3];
+    char url[sizeof(SYNC_API_URL SYNC_PULL_PATH) + sizeof(enc) + 32];
+    url_encode(enc, sizeof(enc), s_cursor);
+    snprintf(url, sizeof(url), "%s%s?since=%s&limit=%d", SYNC_API_URL, SYNC_PULL_PATH, enc, s_pull_limit);
+    esp_http_client_config_t config = {
+        .url = url,
+        .method = HTTP_METHOD_GET,
+        .crt_bundle_attach = esp_crt_bundle_attach,
+    };
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    if (!client) return NULL;
+    char *body = NULL;
+    size_t len = 0;
+    bool ok = false;
+    if (esp_http_client_open(client, 0) == ESP_OK) {
+        if (esp_http_client_fetch_headers(client) >= 0) {
+            int status = esp_http_client_get_status_code(client);
+            if (status >= 200 && status < 300) {
+                size_t cap = 0;
+                while (1) {
+                    if (len + 1 >= cap) {
+                        if (cap == SYNC_PULL_MAX_BYTES) {
+                            ESP_LOGW(TAG, "delta pull page of %d over %d bytes", s_pull_limit, SYNC_PULL_MAX_BYTES);
+                            *too_big = true;
+                            break;
+                        }
+                        size_t ncap = cap ? cap * 2 : 2048;
+                        if (ncap > SYNC_PULL_MAX_BYTES) ncap = SYNC_PULL_MAX_BYTES;
+                        char *nb = realloc(body, ncap);
+                        if (!nb) break;
+                        body = nb;
+                        cap = ncap;
+                    }
+                    int n = esp_http_client_read(client, body + len, (int)(cap - 1 - len));
+                    if (n < 0) break;
+                    if (n == 0) { ok = true; break; }
+                    len += (size_t)n;
+                }
+            } else {
+                ESP_LOGW(TAG, "delta pull rejected: HTTP %d", status);
+            }
+        }
+        esp_http_client_close(client);
     }
-    int status = esp_http_client_get_status_code(client);
     esp_http_client_cleanup(client);
-    return (status >= 200 && status < 300) ? 0 : -1;
+    if (!ok) {
+        free(body);
+        return NULL;
+    }
+    body[len] = '\0';
+    *out_len = len;
+    return body;
+}
+
+// fetch one page and apply it as one inventory transaction (one log append, one snapshot publish, one change
+// callback); the page is downloaded first so the inventory lock is never held across network reads.
+// a page over SYNC_PULL_MAX_BYTES is requested again with a smaller limit, down to a single change.
+// returns 0 with c filled in, or -1
+static int pull_page(pull_ctx_t *c)
+{
+    size_t len = 0;
+    char *body;
+    for (;;) {
+        bool too_big = false;
+        body = pull_fetch(&len, &too_big);
+        if (body) break;
+        if (!too_big || s_pull_limit == 1) return -1;
+        s_pull_limit /= 2;
+    }
+    if (s_pull_limit < SYNC_PULL_PAGE) s_pull_limit = s_pull_limit * 2 < SYNC_PULL_PAGE ? s_pull_limit * 2 : SYNC_PULL_PAGE;
+    mem_src_t src = { body, len };
+    inventory_txn_begin();
+    int rc = json_stream_parse(mem_read, &src, pull_token, c);
+    inventory_txn_commit();
+    free(body);
+    return rc == 0 ? 0 : -1;
+}
+
+// pull remote changes since the saved cursor; returns the number applied, or -1
+static int sync_pull(void)
+{
+    if (!s_cursor_loaded) {
+        char *saved = storage_read_file(PULL_CURSOR_PATH);
+        if (saved) {
+            strncpy(s_cursor, saved, sizeof(s_cursor)-1);
+            s_cursor[strcspn(s_cursor, "\r\n")] = '\0';
+            free(saved);
+        }
+        s_cursor_loaded = true;
+    }
+    pull_ctx_t *c = malloc(sizeof(*c));
+    if (!c) return -1;
+    int applied = 0, seen = 0;
+    int rc = 0;
+    for (int page = 0; page < SYNC_PULL_MAX_PAGES; ++page) {
+        memset(c, 0, sizeof(*c));
+        if (pull_page(c) != 0) { rc = -1; break; }
+        applied += c->applied;
+        seen += c->seen;
+        if (c->cursor[0] && strcmp(c->cursor, s_cursor) != 0) {
+            strcpy(s_cursor, c->cursor);
+            storage_write_file(PULL_CURSOR_PATH, s_cursor);
+        }
+        if (!c->more) break;
+    }
+    free(c);
+    if (seen) ESP_LOGI(TAG, "delta pull: %d change(s), %d applied", seen, applied);
+    return rc == 0 ? applied : -1;
+}
+
+// exponential backoff after failed uploads (and, separately, failed pulls), with "equal jitter" so devices that went offline together
+// do not retry in lockstep: the wait is uniformly random in [backoff/2, backoff]
+static uint32_t backoff_next(uint32_t backoff_ms)
+{
+    if (backoff_ms == 0) return SYNC_BACKOFF_MIN_MS;
+    return backoff_ms >= SYNC_BACKOFF_MAX_MS / 2 ? SYNC_BACKOFF_MAX_MS : backoff_ms * 2;
+}
+
+static uint32_t backoff_jitter(uint32_t backoff_ms)
+{
+    return backoff_ms / 2 + esp_random() % (backoff_ms / 2 + 1);
 }
-#else
-// If no HTTP client available, always fail so items remain queued
-static int post_event_to_server(const char *json, int len)
+
+// one round of the sync task: compact, drain the queue back to back while the server accepts everything, then
+// pull (only once our own changes are on the server). returns 0, or -1 if an upload failed (nothing is pulled then);
+// a failed pull is reported in *pull_failed only, so it has its own backoff and never holds up uploads
+static int sync_round(bool pull, bool *pull_failed)
+{
+    queue_compact();
+    int rc;
+    do {
+        rc = sync_upload_batch();
+    } while (rc > 0);
+    *pull_failed = rc == 0 && pull && sync_pull() < 0;
+    return rc;
+}
+
+static void on_got_ip(void *arg, esp_event_base_t base, int32_t id, void *data)
 {
-    (void)json; (void)len; return -1;
+    (void)arg; (void)base; (void)id; (void)data;
+    if (s_sync_task) xTaskNotify(s_sync_task, SYNC_NOTIFY_ONLINE, eSetBits);
 }
-#endif
 
+// 调度：离线时阻塞在 Wi-Fi 的 WIFI_CONNECTED_BIT 上，不做任何上传尝试；联网后立即清空积压并拉取远端变更。
+// 队列清空后睡到有新事件入队或到下次拉取（连续入队时等 SYNC_FLUSH_IDLE_MS 无新事件再发，最多攒 SYNC_FLUSH_MAX_MS），
+// 上传失败则指数退避（带抖动），退避期间新事件不会提前触发重试，但重新获得 IP 会立即重试。
+// 拉取失败单独退避（下次拉取推迟），不影响上传：服务端某一页一直取不下来时本地修改照常上传。
 static void sync_task(void *arg)
 {
     (void)arg;
+    uint32_t backoff_ms = 0;
+    uint32_t pull_backoff_ms = 0;
+    uint32_t pull_wait_ms = SYNC_POLL_INTERVAL * 1000;
+    bool pull_due = true;
+    TickType_t last_pull = 0;
     while (1) {
-        cJSON *arr = read_queue();
-        int n = cJSON_GetArraySize(arr);
-        if (n > 0) {
-            cJSON *first = cJSON_GetArrayItem(arr, 0);
-            if (first) {
-                char *s = cJSON_PrintUnformatted(first);
-                if (s) {
-                    int rc = post_event_to_server(s, strlen(s));
-                    if (rc == 0) {
-                        // pop first
-                        cJSON_DeleteItemFromArray(arr, 0);
-                        write_queue(arr);
-                        ESP_LOGI(TAG, "synced one event");
-                    } else {
-                        ESP_LOGW(TAG, "sync failed, will retry later");
-                        free(s);
-                        cJSON_Delete(arr);
-                        vTaskDelay(pdMS_TO_TICKS(SYNC_POLL_INTERVAL * 1000));
-                        continue;
-                    }
-                    free(s);
-                }
+        while (!wifi_wait_connected(SYNC_POLL_INTERVAL * 1000)) {}
+
+        // delta pull every SYNC_POLL_INTERVAL (or the pull backoff), and right after (re)connecting
+        TickType_t now = xTaskGetTickCount();
+        bool pull = pull_due || now - last_pull >= pdMS_TO_TICKS(pull_wait_ms);
+        bool pull_failed = false;
+        int rc = sync_round(pull, &pull_failed);
+        if (rc == 0 && pull) { // with a failed upload the pull did not run and stays due
+            pull_due = false;
+            last_pull = now;
+            if (pull_failed) {
+                pull_backoff_ms = backoff_next(pull_backoff_ms);
+                pull_wait_ms = backoff_jitter(pull_backoff_ms);
+                ESP_LOGW(TAG, "delta pull failed, retry in %u ms", (unsigned)pull_wait_ms);
+            } else {
+                pull_backoff_ms = 0;
+                pull_wait_ms = SYNC_POLL_INTERVAL * 1000;
+            }
+        }
+
+        uint32_t wait_ms;
+        if (rc < 0) {
+            backoff_ms = backoff_next(backoff_ms);
+            wait_ms = backoff_jitter(backoff_ms);
+            ESP_LOGW(TAG, "sync failed, retry in %u ms", (unsigned)wait_ms);
+        } else {
+            backoff_ms = 0;
+            // next delta pull, unless an enqueue comes first
+            uint32_t since_ms = (uint32_t)((xTaskGetTickCount() - last_pull) * portTICK_PERIOD_MS);
+            wait_ms = since_ms < pull_wait_ms ? pull_wait_ms - since_ms : 0;
+        }
+
+        now = xTaskGetTickCount();
+        TickType_t deadline = now + pdMS_TO_TICKS(wait_ms);
+        TickType_t flush_cap = 0;
+        while ((int32_t)(deadline - now) > 0) {
+            uint32_t bits = 0;
+            xTaskNotifyWait(0, UINT32_MAX, &bits, deadline - now);
+            now = xTaskGetTickCount();
+            if (bits & SYNC_NOTIFY_ONLINE) {
+                backoff_ms = 0;
+                pull_due = true;
+                break;
+            }
+            if ((bits & SYNC_NOTIFY_ENQUEUE) && backoff_ms == 0) {
+                // idle flush: wait for the burst to go quiet, but not longer than SYNC_FLUSH_MAX_MS
+                if (!flush_cap) flush_cap = now + pdMS_TO_TICKS(SYNC_FLUSH_MAX_MS);
+                deadline = now + pdMS_TO_TICKS(SYNC_FLUSH_IDLE_MS);
+                if ((int32_t)(deadline - flush_cap) > 0) deadline = flush_cap;
             }
         }
-        cJSON_Delete(arr);
-        vTaskDelay(pdMS_TO_TICKS(SYNC_POLL_INTERVAL * 1000));
     }
 }
 
 void sync_init(void)
 {
-    // ensure queue file exists
-    cJSON *arr = read_queue();
-    write_queue(arr);
-    cJSON_Delete(arr);
-    xTaskCreatePinnedToCore(sync_task, "sync", 8*1024, NULL, 5, NULL, 1);
+    // open the queue (and migrate the legacy file) before the task starts
+    queue_lock();
+    queue_unlock();
+    xTaskCreatePinnedToCore(sync_task, "sync", 8*1024, NULL, 5, &s_sync_task, 1);
+    // reconnects cut a running backoff short; needs the default event loop (created by wifi_init_sta)
+    if (esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &on_got_ip, NULL, NULL) != ESP_OK) {
+        ESP_LOGW(TAG, "no IP event hook, reconnects wait for the backoff");
+    }
 }
@@ -7,5 +7,7 @@
 void sync_init(void);
 // Enqueue an event: event_type (e.g., "add_item", "mark_notified"), payload is JSON string
 int sync_enqueue_event(const char *event_type, const char *payload_json);
+// Enqueue several events with a single queue write (used by inventory transactions)
+int sync_enqueue_batch(const char *const *event_types, const char *const *payloads_json, int count);
 
 #endif // _SYNC_H_
@@ -2,10 +2,35 @@
 #ifndef _SYNC_CONFIG_H_
 #define _SYNC_CONFIG_H_
 
-// Sync endpoint (replace with your backend API)
+// Sync endpoint (replace with your backend API); host tests point it at a local mock server
+#ifndef SYNC_API_URL
 #define SYNC_API_URL "https://recipe-backend-inmd.vercel.app"
+#endif
 
-// Interval for background sync attempts (seconds)
+// Interval for pulling remote changes (seconds). Uploads are driven by new events and Wi-Fi
+// reconnects instead; the sync task blocks without retrying while offline
 #define SYNC_POLL_INTERVAL 30
 
+// Delta pull: GET SYNC_API_URL SYNC_PULL_PATH?since=<cursor>&limit=SYNC_PULL_PAGE, up to SYNC_PULL_MAX_PAGES per round
+#define SYNC_PULL_PATH "/changes"
+#define SYNC_PULL_PAGE 50
+#define SYNC_PULL_MAX_PAGES 4
+// A page is received into memory before it is applied and must stay under SYNC_PULL_MAX_BYTES
+#define SYNC_PULL_MAX_BYTES (32 * 1024)
+
+// New events are flushed once enqueueing has been quiet for SYNC_FLUSH_IDLE_MS, at most SYNC_FLUSH_MAX_MS late
+#define SYNC_FLUSH_IDLE_MS 1500
+#define SYNC_FLUSH_MAX_MS 10000
+
+// Failed uploads back off exponentially (with jitter) between these bounds
+#define SYNC_BACKOFF_MIN_MS 2000
+#define SYNC_BACKOFF_MAX_MS (5 * 60 * 1000)
+
+// Batched uploads: each request carries a JSON array of up to SYNC_BATCH_MAX_EVENTS events / SYNC_BATCH_MAX_BYTES.
+// The batch size starts small and adapts to the observed round-trip time
+#define SYNC_BATCH_MIN_EVENTS 1
+#define SYNC_BATCH_MAX_EVENTS 32
+#define SYNC_BATCH_MAX_BYTES (8 * 1024)
+#define SYNC_BATCH_RTT_TARGET_MS 2000
+
 #endif // _SYNC_CONFIG_H_
@@ -19,8 +19,8 @@ void ui_inventory_init(void)
 
 // UI state
 static lv_obj_t *inv_list = NULL;
-static inventory_item_t **g_items = NULL;
-static int g_item_count = 0;
+// 持有一个库存快照的引用：条目是副本，库存增删后也不会悬空；有新版本时才替换
+static const inventory_snapshot_t *g_snap = NULL;
 // 之前示例中有分页逻辑，这里改为单页显示全部条目
 static int g_notify_threshold_days = 3; // highlight threshold
 
@@ -36,11 +36,16 @@ static void btn_next_cb(lv_event_t *e)
 // create or refresh list content from inventory
 void ui_inventory_refresh(void)
 {
-    // free previous items
-    if (g_items) { inventory_free_list(g_items); g_items = NULL; g_item_count = 0; }
-    int count = inventory_list_items(&g_items);
-    if (count < 0) { ESP_LOGW(TAG, "failed to get items"); return; }
-    g_item_count = count;
+    // the sorted list only changes on mutation; keep the held snapshot while the generation matches
+    const inventory_snapshot_t *snap = inventory_snapshot_acquire();
+    if (!snap) { ESP_LOGW(TAG, "failed to get items"); return; }
+    if (g_snap && g_snap->generation == snap->generation) {
+        inventory_snapshot_release(snap);
+    } else {
+        // release previous snapshot
+        inventory_snapshot_release(g_snap);
+        g_snap = snap;
+    }
     // update display
     ui_inventory_show();
 }
@@ -59,12 +64,13 @@ void ui_inventory_show(void)
 
     // 不再做分页，直接显示所有条目
     int start = 0;
-    int end = g_item_count;
+    int end = g_snap ? g_snap->count : 0;
 
     // create entries vertically
     int y = 0;
     for (int i = start; i < end; ++i) {
-        inventory_item_t *it = g_items[i];
+        const inventory_item_t *it = &g_snap->items[i];
+        int remaining = inventory_days_left(it); // day count drifts with the clock, recompute on every draw
         char buf[128];
         // 显示: 名称  数量单位  剩余天数  存放位置
         // 例如: 鸡蛋  1盒  5天  冷藏区
@@ -72,14 +78,14 @@ void ui_inventory_show(void)
                  it->name,
                  it->quantity,
                  it->unit,
-                 it->remaining_days,
+                 remaining,
                  it->location);
         lv_obj_t *label = lv_label_create(inv_list);
         lv_label_set_text(label, buf);
         lv_obj_set_style_text_font(label, &font_alipuhui20, LV_STATE_DEFAULT);
         lv_obj_align(label, LV_ALIGN_TOP_LEFT, 10, 10 + y*28);
         // highlight if near expiry
-        if (it->remaining_days <= g_notify_threshold_days) {
+        if (remaining <= g_notify_threshold_days) {
             lv_obj_set_style_text_color(label, lv_color_make(255, 0, 0), LV_STATE_DEFAULT);
         } else {
             lv_obj_set_style_text_color(label, lv_color_make(0, 0, 0), LV_STATE_DEFAULT);
@@ -121,11 +127,11 @@ void ui_recipe_show_text(const char *text)
 void ui_inventory_next_page(void)
 {
     // 取消分页后，该函数保留为空实现，避免旧代码调用崩溃
-    (void)g_items;
+    (void)g_snap;
 }
 
 void ui_inventory_prev_page(void)
 {
     // 取消分页后，该函数保留为空实现，避免旧代码调用崩溃
-    (void)g_items;
+    (void)g_snap;
 }
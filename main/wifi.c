@@ -7,6 +7,7 @@
 #include "nvs_flash.h"
 #include "esp_netif.h"
 #include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "freertos/event_groups.h"
 #include "esp_sntp.h"
 #include <string.h>
@@ -100,7 +101,11 @@ bool wifi_init_sta(void)
 
 bool wifi_wait_connected(int timeout_ms)
 {
-    if (!s_wifi_event_group) return false;
+    if (!s_wifi_event_group) {
+        // Wi-Fi never started: behave like a timeout so callers polling in a loop do not spin
+        vTaskDelay(pdMS_TO_TICKS(timeout_ms));
+        return false;
+    }
     EventBits_t bits = xEventGroupWaitBits(s_wifi_event_group, WIFI_CONNECTED_BIT, pdFALSE, pdFALSE, pdMS_TO_TICKS(timeout_ms));
     return (bits & WIFI_CONNECTED_BIT) != 0;
 }
@@ -5,5 +5,5 @@
 // Returns true if startup/init succeeded (does not guarantee connection unless WIFI_BLOCK_ON_START=1)
 bool wifi_init_sta(void);
 
-// Optionally block until connected (returns true if connected)
+// Block until connected or timeout_ms elapses (returns true if connected); waits on WIFI_CONNECTED_BIT
 bool wifi_wait_connected(int timeout_ms);
@@ -0,0 +1,148 @@
+// bench_inventory.c - inventory.bin snapshot vs the JSON file path: time and peak heap to save and load.
+// inventory.c is included so the benchmark can time bin_write/bin_load and json_load_items on their own,
+// without the log replay and change callbacks of inventory_load()
+#include "inventory.c"
+#include "host_port.h"
+#include <malloc.h>
+#include <time.h>
+
+#define ROUNDS 20
+
+// ---- heap accounting (the Makefile links with --wrap=malloc,calloc,realloc,free) --------
+
+void *__real_malloc(size_t n);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *p, size_t n);
+void __real_free(void *p);
+
+static size_t s_heap, s_heap_peak;
+
+static void *heap_track(void *p)
+{
+    if (p) {
+        s_heap += malloc_usable_size(p);
+        if (s_heap > s_heap_peak) s_heap_peak = s_heap;
+    }
+    return p;
+}
+
+void *__wrap_malloc(size_t n) { return heap_track(__real_malloc(n)); }
+void *__wrap_calloc(size_t n, size_t size) { return heap_track(__real_calloc(n, size)); }
+
+void *__wrap_realloc(void *p, size_t n)
+{
+    size_t old = p ? malloc_usable_size(p) : 0;
+    void *q = __real_realloc(p, n);
+    if (q || n == 0) s_heap -= old;
+    return heap_track(q);
+}
+
+void __wrap_free(void *p)
+{
+    if (p) s_heap -= malloc_usable_size(p);
+    __real_free(p);
+}
+
+// inventory.c queues sync events; the benchmark has no sync queue behind it
+int sync_enqueue_batch(const char *const *event_types, const char *const *payloads_json, int count)
+{
+    (void)event_types; (void)payloads_json; (void)count;
+    return 0;
+}
+
+// ---- workload ---------------------------------------------------------------
+
+static void fill(int n)
+{
+    static const char *const names[] = { "牛奶", "鸡蛋", "五花肉", "西兰花", "速冻水饺", "酸奶", "苹果", "豆腐" };
+    static const char *const cats[] = { "牛奶", "肉类", "蔬果", "熟食", "冷冻" };
+    static const char *const locs[] = { "中层左", "中层右", "冷冻室", "门架" };
+    inventory_txn_begin();
+    store_clear();
+    for (int i = 0; i < n; ++i) {
+        char name[48];
+        snprintf(name, sizeof(name), "%s%d", names[i % 8], i);
+        inventory_item_t it = {
+            .name = name,
+            .category = cats[i % 5],
+            .location = locs[i % 4],
+            .unit = i % 2 ? "盒" : "个",
+            .notes = i % 3 ? "" : "周末前吃完",
+            .quantity = 1 + i % 6,
+            .added_time = 1700000000 + i * 3600,
+            .last_notified_remaining_days = -1,
+        };
+        snprintf(it.item_id, sizeof(it.item_id), "%s", inventory_generate_id());
+        inventory_add_item(&it);
+    }
+    inventory_txn_commit();
+}
+
+static double now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static long file_size(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) return -1;
+    fseek(f, 0, SEEK_END);
+    long n = ftell(f);
+    fclose(f);
+    return n;
+}
+
+typedef struct {
+    double us;          // best of ROUNDS
+    size_t peak;        // heap high-water mark above the heap in use before the call
+} result_t;
+
+static void measure(result_t *r, int (*op)(const char *), const char *path, bool load, int expect)
+{
+    r->us = 1e30;
+    r->peak = 0;
+    for (int k = 0; k < ROUNDS; ++k) {
+        if (load) store_clear();
+        s_heap_peak = s_heap;
+        size_t base = s_heap;
+        double t0 = now_us();
+        int rc = op(path);
+        double us = now_us() - t0;
+        CHECK(rc >= 0);
+        if (load) CHECK(s_live_count == expect);
+        if (us < r->us) r->us = us;
+        if (s_heap_peak - base > r->peak) r->peak = s_heap_peak - base;
+    }
+}
+
+static int json_save(const char *path)
+{
+    return inventory_export_json(path);
+}
+
+int main(void)
+{
+    static const int sizes[] = { 20, 100, 500, 2000 };
+    const char *bin = "/spiffs/bench.bin", *json = "/spiffs/bench.json";
+    inventory_init();
+    printf("%6s | %-6s | %9s | %10s | %10s | %10s | %10s\n",
+           "items", "format", "file", "save us", "save peak", "load us", "load peak");
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        int n = sizes[s];
+        fill(n);
+        publish_snapshot(); // inventory_export_json reads the published snapshot
+        result_t save[2], load[2];
+        measure(&save[0], bin_write, bin, false, n);
+        measure(&save[1], json_save, json, false, n);
+        measure(&load[0], bin_load, bin, true, n);
+        measure(&load[1], json_load_items, json, true, n);
+        for (int f = 0; f < 2; ++f) {
+            printf("%6d | %-6s | %9ld | %10.0f | %10zu | %10.0f | %10zu\n", n, f ? "json" : "binary",
+                   file_size(f ? json : bin), save[f].us, save[f].peak, load[f].us, load[f].peak);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,356 @@
+// cjson_host.c - the cJSON calls used by the modules under test, for hosts without a cJSON checkout.
+// A strict recursive-descent parser into cJSON-shaped trees; like cJSON, trailing text after the value is
+// ignored and cJSON_GetObjectItem matches keys case-insensitively. The printer writes what
+// cJSON_PrintUnformatted would for the trees the modules build (objects, arrays, strings)
+#include "cJSON.h"
+#include <ctype.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+typedef struct {
+    const char *p;
+    int depth;
+} parser_t;
+
+static cJSON *parse_value(parser_t *ps);
+
+static void skip_ws(parser_t *ps)
+{
+    while (*ps->p == ' ' || *ps->p == '\t' || *ps->p == '\n' || *ps->p == '\r') ps->p++;
+}
+
+static int hex4(const char *s)
+{
+    int v = 0;
+    for (int i = 0; i < 4; i++) {
+        int c = s[i], d;
+        if (c >= '0' && c <= '9') d = c - '0';
+        else if (c >= 'a' && c <= 'f') d = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') d = c - 'A' + 10;
+        else return -1;
+        v = v * 16 + d;
+    }
+    return v;
+}
+
+static char *utf8_put(char *o, uint32_t cp)
+{
+    if (cp < 0x80) { *o++ = (char)cp; }
+    else if (cp < 0x800) { *o++ = (char)(0xC0 | cp >> 6); *o++ = (char)(0x80 | (cp & 0x3F)); }
+    else if (cp < 0x10000) {
+        *o++ = (char)(0xE0 | cp >> 12); *o++ = (char)(0x80 | ((cp >> 6) & 0x3F)); *o++ = (char)(0x80 | (cp & 0x3F));
+    } else {
+        *o++ = (char)(0xF0 | cp >> 18); *o++ = (char)(0x80 | ((cp >> 12) & 0x3F));
+        *o++ = (char)(0x80 | ((cp >> 6) & 0x3F)); *o++ = (char)(0x80 | (cp & 0x3F));
+    }
+    return o;
+}
+
+// string at ps->p (on the opening quote), unescaped into a new buffer
+static char *parse_string(parser_t *ps)
+{
+    const char *s = ps->p + 1, *e = s;
+    while (*e && *e != '"') {
+        if ((unsigned char)*e < 0x20) return NULL;
+        if (*e == '\\' && !*++e) return NULL;
+        e++;
+    }
+    if (*e != '"') return NULL;
+    char *out = malloc((size_t)(e - s) + 1), *o = out; // escapes never grow the text
+    if (!out) return NULL;
+    while (s < e) {
+        if (*s != '\\') { *o++ = *s++; continue; }
+        s++;
+        switch (*s++) {
+        case '"': *o++ = '"'; break;
+        case '\\': *o++ = '\\'; break;
+        case '/': *o++ = '/'; break;
+        case 'b': *o++ = '\b'; break;
+        case 'f': *o++ = '\f'; break;
+        case 'n': *o++ = '\n'; break;
+        case 'r': *o++ = '\r'; break;
+        case 't': *o++ = '\t'; break;
+        case 'u': {
+            if (e - s < 4) goto bad;
+            int cp = hex4(s);
+            if (cp < 0) goto bad;
+            s += 4;
+            if (cp >= 0xD800 && cp < 0xDC00) { // surrogate pair
+                if (e - s < 6 || s[0] != '\\' || s[1] != 'u') goto bad;
+                int lo = hex4(s + 2);
+                if (lo < 0xDC00 || lo > 0xDFFF) goto bad;
+                s += 6;
+                cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+            } else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+                goto bad;
+            }
+            o = utf8_put(o, (uint32_t)cp);
+            break;
+        }
+        default:
+            goto bad;
+        }
+    }
+    *o = '\0';
+    ps->p = e + 1;
+    return out;
+bad:
+    free(out);
+    return NULL;
+}
+
+static cJSON *new_item(int type)
+{
+    cJSON *it = calloc(1, sizeof(*it));
+    if (it) it->type = type;
+    return it;
+}
+
+static cJSON *parse_number(parser_t *ps)
+{
+    const char *s = ps->p;
+    if (*s == '-') s++;
+    if (!isdigit((unsigned char)*s)) return NULL;
+    char *end;
+    double v = strtod(ps->p, &end);
+    if (end == ps->p) return NULL;
+    cJSON *it = new_item(cJSON_Number);
+    if (!it) return NULL;
+    it->valuedouble = v;
+    it->valueint = v >= INT_MAX ? INT_MAX : v <= (double)INT_MIN ? INT_MIN : (int)v;
+    ps->p = end;
+    return it;
+}
+
+// elements of an array or members of an object, after the opening bracket
+static cJSON *parse_container(parser_t *ps, bool object)
+{
+    cJSON *c = new_item(object ? cJSON_Object : cJSON_Array), *last = NULL;
+    if (!c) return NULL;
+    if (++ps->depth > 1000) goto bad;
+    ps->p++;
+    skip_ws(ps);
+    if (*ps->p == (object ? '}' : ']')) { ps->p++; ps->depth--; return c; }
+    for (;;) {
+        char *key = NULL;
+        skip_ws(ps);
+        if (object) {
+            if (*ps->p != '"' || !(key = parse_string(ps))) goto bad;
+            skip_ws(ps);
+            if (*ps->p != ':') { free(key); goto bad; }
+            ps->p++;
+        }
+        cJSON *v = parse_value(ps);
+        if (!v) { free(key); goto bad; }
+        v->string = key;
+        if (last) { last->next = v; v->prev = last; } else { c->child = v; }
+        last = v;
+        skip_ws(ps);
+        if (*ps->p == ',') { ps->p++; continue; }
+        if (*ps->p != (object ? '}' : ']')) goto bad;
+        ps->p++;
+        ps->depth--;
+        return c;
+    }
+bad:
+    cJSON_Delete(c);
+    return NULL;
+}
+
+static cJSON *parse_value(parser_t *ps)
+{
+    skip_ws(ps);
+    switch (*ps->p) {
+    case '{': return parse_container(ps, true);
+    case '[': return parse_container(ps, false);
+    case '"': {
+        char *s = parse_string(ps);
+        if (!s) return NULL;
+        cJSON *it = new_item(cJSON_String);
+        if (!it) { free(s); return NULL; }
+        it->valuestring = s;
+        return it;
+    }
+    case 't': if (strncmp(ps->p, "true", 4) == 0) { ps->p += 4; return new_item(cJSON_True); } return NULL;
+    case 'f': if (strncmp(ps->p, "false", 5) == 0) { ps->p += 5; return new_item(cJSON_False); } return NULL;
+    case 'n': if (strncmp(ps->p, "null", 4) == 0) { ps->p += 4; return new_item(cJSON_NULL); } return NULL;
+    default: return parse_number(ps);
+    }
+}
+
+cJSON *cJSON_Parse(const char *value)
+{
+    if (!value) return NULL;
+    parser_t ps = { value, 0 };
+    return parse_value(&ps);
+}
+
+void cJSON_Delete(cJSON *item)
+{
+    while (item) {
+        cJSON *next = item->next;
+        cJSON_Delete(item->child);
+        free(item->valuestring);
+        free(item->string);
+        free(item);
+        item = next;
+    }
+}
+
+cJSON *cJSON_GetObjectItem(const cJSON *object, const char *name)
+{
+    if (!object || !name) return NULL;
+    for (cJSON *c = object->child; c; c = c->next) {
+        if (c->string && strcasecmp(c->string, name) == 0) return c;
+    }
+    return NULL;
+}
+
+cJSON_bool cJSON_IsNumber(const cJSON *item) { return item && (item->type & 0xFF) == cJSON_Number; }
+cJSON_bool cJSON_IsString(const cJSON *item) { return item && (item->type & 0xFF) == cJSON_String; }
+cJSON_bool cJSON_IsObject(const cJSON *item) { return item && (item->type & 0xFF) == cJSON_Object; }
+cJSON_bool cJSON_IsArray(const cJSON *item) { return item && (item->type & 0xFF) == cJSON_Array; }
+
+cJSON *cJSON_GetArrayItem(const cJSON *array, int index)
+{
+    if (index < 0) return NULL;
+    cJSON *c = array ? array->child : NULL;
+    while (c && index-- > 0) c = c->next;
+    return index < 0 ? c : NULL;
+}
+
+// ---- building and printing --------------------------------------------------
+
+cJSON *cJSON_CreateObject(void) { return new_item(cJSON_Object); }
+cJSON *cJSON_CreateArray(void) { return new_item(cJSON_Array); }
+
+cJSON *cJSON_CreateString(const char *string)
+{
+    cJSON *it = new_item(cJSON_String);
+    if (it && !(it->valuestring = strdup(string ? string : ""))) {
+        free(it);
+        return NULL;
+    }
+    return it;
+}
+
+cJSON_bool cJSON_AddItemToArray(cJSON *array, cJSON *item)
+{
+    if (!array || !item || item == array) return false;
+    cJSON *last = array->child;
+    if (!last) {
+        array->child = item;
+        return true;
+    }
+    while (last->next) last = last->next;
+    last->next = item;
+    item->prev = last;
+    return true;
+}
+
+cJSON_bool cJSON_AddItemToObject(cJSON *object, const char *string, cJSON *item)
+{
+    if (!string || !item) return false;
+    char *key = strdup(string);
+    if (!key) return false;
+    free(item->string);
+    item->string = key;
+    return cJSON_AddItemToArray(object, item);
+}
+
+cJSON *cJSON_AddStringToObject(cJSON *object, const char *name, const char *string)
+{
+    cJSON *it = cJSON_CreateString(string);
+    if (!it || !cJSON_AddItemToObject(object, name, it)) {
+        cJSON_Delete(it);
+        return NULL;
+    }
+    return it;
+}
+
+typedef struct {
+    char *buf;
+    size_t len, cap;
+    bool oom;
+} printer_t;
+
+static void put(printer_t *pr, const char *s, size_t n)
+{
+    if (pr->oom) return;
+    if (pr->len + n + 1 > pr->cap) {
+        size_t cap = pr->cap ? pr->cap : 256;
+        while (pr->len + n + 1 > cap) cap *= 2;
+        char *b = realloc(pr->buf, cap);
+        if (!b) {
+            pr->oom = true;
+            return;
+        }
+        pr->buf = b;
+        pr->cap = cap;
+    }
+    memcpy(pr->buf + pr->len, s, n);
+    pr->len += n;
+    pr->buf[pr->len] = '\0';
+}
+
+static void put_string(printer_t *pr, const char *s)
+{
+    put(pr, "\"", 1);
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        char esc[8];
+        if (c == '"' || c == '\\') { esc[0] = '\\'; esc[1] = (char)c; put(pr, esc, 2); }
+        else if (c == '\n') put(pr, "\\n", 2);
+        else if (c == '\r') put(pr, "\\r", 2);
+        else if (c == '\t') put(pr, "\\t", 2);
+        else if (c < 0x20) put(pr, esc, (size_t)snprintf(esc, sizeof(esc), "\\u%04x", c));
+        else put(pr, s, 1); // UTF-8 goes out as it is, like cJSON
+    }
+    put(pr, "\"", 1);
+}
+
+static void print_value(printer_t *pr, const cJSON *it)
+{
+    char num[32];
+    switch (it->type & 0xFF) {
+    case cJSON_False: put(pr, "false", 5); break;
+    case cJSON_True: put(pr, "true", 4); break;
+    case cJSON_Number:
+        if (it->valuedouble == (double)it->valueint) put(pr, num, (size_t)snprintf(num, sizeof(num), "%d", it->valueint));
+        else put(pr, num, (size_t)snprintf(num, sizeof(num), "%.17g", it->valuedouble));
+        break;
+    case cJSON_String: put_string(pr, it->valuestring ? it->valuestring : ""); break;
+    case cJSON_Array:
+    case cJSON_Object: {
+        bool object = (it->type & 0xFF) == cJSON_Object;
+        put(pr, object ? "{" : "[", 1);
+        for (const cJSON *c = it->child; c; c = c->next) {
+            if (object) {
+                put_string(pr, c->string ? c->string : "");
+                put(pr, ":", 1);
+            }
+            print_value(pr, c);
+            if (c->next) put(pr, ",", 1);
+        }
+        put(pr, object ? "}" : "]", 1);
+        break;
+    }
+    default: put(pr, "null", 4); break;
+    }
+}
+
+char *cJSON_PrintUnformatted(const cJSON *item)
+{
+    if (!item) return NULL;
+    printer_t pr = { 0 };
+    print_value(&pr, item);
+    if (pr.oom) {
+        free(pr.buf);
+        return NULL;
+    }
+    return pr.buf;
+}
@@ -0,0 +1,296 @@
+// esp_http_client_host.c - esp_http_client over plain TCP sockets, for host tests against mock_server.c.
+// Only http:// URLs (any URL once esp_http_client_host_redirect is set), one request per connection
+// (Connection: close), responses with Content-Length or read-until-close; chunked responses are rejected
+#define _GNU_SOURCE
+#include "esp_http_client.h"
+#include "esp_log.h"
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+static const char *TAG = "http_host";
+
+struct esp_http_client {
+    char host[64];
+    char port[8];
+    char *path;                 // path and query
+    const char *post_data;      // esp_http_client_set_post_field, sent by perform
+    int post_len;
+    http_event_handle_cb event_handler;
+    void *user_data;
+    esp_http_client_method_t method;
+    int timeout_ms;
+    char *headers;              // "Key: value\r\n" lines added with set_header
+    size_t headers_len;
+    int fd;
+    int status;
+    int64_t content_length;     // -1 = until the server closes
+    int64_t body_read;
+    bool chunked;
+    char pending[4096];         // body bytes received together with the headers
+    size_t pending_len, pending_pos;
+};
+
+static const char *s_redirect;  // "host:port", or NULL
+
+void esp_http_client_host_redirect(const char *host_port)
+{
+    s_redirect = host_port;
+}
+
+static int parse_url(esp_http_client_handle_t c, const char *url)
+{
+    char buf[512];
+    if (s_redirect && (strncmp(url, "http://", 7) == 0 || strncmp(url, "https://", 8) == 0)) {
+        const char *path = strchr(strstr(url, "://") + 3, '/');
+        snprintf(buf, sizeof(buf), "http://%s%s", s_redirect, path ? path : "/");
+        url = buf;
+    }
+    if (strncmp(url, "http://", 7) != 0) {
+        ESP_LOGE(TAG, "only http:// is supported on the host: %s", url);
+        return -1;
+    }
+    const char *h = url + 7;
+    const char *slash = strchr(h, '/');
+    const char *colon = strchr(h, ':');
+    size_t hlen = slash ? (size_t)(slash - h) : strlen(h);
+    if (colon && (!slash || colon < slash)) {
+        size_t plen = (slash ? (size_t)(slash - colon) : strlen(colon)) - 1;
+        if (plen == 0 || plen >= sizeof(c->port)) return -1;
+        memcpy(c->port, colon + 1, plen);
+        c->port[plen] = '\0';
+        hlen = (size_t)(colon - h);
+    } else {
+        strcpy(c->port, "80");
+    }
+    if (hlen == 0 || hlen >= sizeof(c->host)) return -1;
+    memcpy(c->host, h, hlen);
+    c->host[hlen] = '\0';
+    free(c->path);
+    c->path = strdup(slash ? slash : "/");
+    return c->path ? 0 : -1;
+}
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *config)
+{
+    esp_http_client_handle_t c = calloc(1, sizeof(*c));
+    if (!c) return NULL;
+    c->fd = -1;
+    c->method = config->method;
+    c->timeout_ms = config->timeout_ms > 0 ? config->timeout_ms : 5000;
+    c->event_handler = config->event_handler;
+    c->user_data = config->user_data;
+    if (!config->url || parse_url(c, config->url) != 0) {
+        free(c);
+        return NULL;
+    }
+    return c;
+}
+
+esp_err_t esp_http_client_set_url(esp_http_client_handle_t c, const char *url)
+{
+    return parse_url(c, url) == 0 ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t esp_http_client_set_method(esp_http_client_handle_t c, esp_http_client_method_t method)
+{
+    c->method = method;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t c, const char *key, const char *value)
+{
+    size_t add = strlen(key) + strlen(value) + 4;
+    char *h = realloc(c->headers, c->headers_len + add + 1);
+    if (!h) return ESP_ERR_NO_MEM;
+    c->headers = h;
+    c->headers_len += (size_t)sprintf(h + c->headers_len, "%s: %s\r\n", key, value);
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_post_field(esp_http_client_handle_t c, const char *data, int len)
+{
+    c->post_data = data;
+    c->post_len = data ? len : 0;
+    return ESP_OK;
+}
+
+static int send_all(int fd, const char *buf, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+        if (n <= 0) return -1;
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+esp_err_t esp_http_client_open(esp_http_client_handle_t c, int write_len)
+{
+    static const char *const methods[] = { "GET", "POST", "PUT", "DELETE" };
+    struct addrinfo hints = { .ai_family = AF_INET, .ai_socktype = SOCK_STREAM }, *ai = NULL;
+    if (getaddrinfo(c->host, c->port, &hints, &ai) != 0) return ESP_FAIL;
+    c->fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    struct timeval tv = { .tv_sec = c->timeout_ms / 1000, .tv_usec = (c->timeout_ms % 1000) * 1000 };
+    if (c->fd >= 0) {
+        setsockopt(c->fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        setsockopt(c->fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    }
+    int rc = c->fd >= 0 ? connect(c->fd, ai->ai_addr, ai->ai_addrlen) : -1;
+    freeaddrinfo(ai);
+    if (rc != 0) {
+        ESP_LOGE(TAG, "connect %s:%s failed", c->host, c->port);
+        esp_http_client_close(c);
+        return ESP_FAIL;
+    }
+    char req[512];
+    int n = snprintf(req, sizeof(req), "%s %s HTTP/1.1\r\nHost: %s:%s\r\nConnection: close\r\n",
+                     methods[c->method], c->path, c->host, c->port);
+    if (write_len < 0) n += snprintf(req + n, sizeof(req) - n, "Transfer-Encoding: chunked\r\n");
+    else if (write_len > 0 || c->method != HTTP_METHOD_GET) n += snprintf(req + n, sizeof(req) - n, "Content-Length: %d\r\n", write_len);
+    if (n >= (int)sizeof(req) ||
+        send_all(c->fd, req, (size_t)n) != 0 ||
+        (c->headers_len && send_all(c->fd, c->headers, c->headers_len) != 0) ||
+        send_all(c->fd, "\r\n", 2) != 0) {
+        esp_http_client_close(c);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+int esp_http_client_write(esp_http_client_handle_t c, const char *buffer, int len)
+{
+    if (c->fd < 0 || len < 0) return -1;
+    return send_all(c->fd, buffer, (size_t)len) == 0 ? len : -1;
+}
+
+int64_t esp_http_client_fetch_headers(esp_http_client_handle_t c)
+{
+    if (c->fd < 0) return ESP_FAIL;
+    char buf[sizeof(c->pending)]; // whatever follows the headers in it fits in pending
+    size_t len = 0;
+    char *end = NULL;
+    while (!end) {
+        if (len + 1 >= sizeof(buf)) return ESP_FAIL;
+        ssize_t n = recv(c->fd, buf + len, sizeof(buf) - 1 - len, 0);
+        if (n <= 0) return ESP_FAIL;
+        len += (size_t)n;
+        buf[len] = '\0';
+        end = strstr(buf, "\r\n\r\n");
+    }
+    *end = '\0';
+    if (sscanf(buf, "HTTP/1.%*d %d", &c->status) != 1) return ESP_FAIL;
+    c->content_length = -1;
+    c->chunked = false;
+    for (char *line = strstr(buf, "\r\n"); line; line = strstr(line + 2, "\r\n")) {
+        const char *h = line + 2;
+        if (strncasecmp(h, "Content-Length:", 15) == 0) c->content_length = atoll(h + 15);
+        else if (strncasecmp(h, "Transfer-Encoding:", 18) == 0 && strstr(h, "chunked")) c->chunked = true;
+    }
+    if (c->chunked) {
+        ESP_LOGE(TAG, "chunked responses are not supported on the host");
+        return ESP_FAIL;
+    }
+    c->pending_len = len - (size_t)(end + 4 - buf);
+    memcpy(c->pending, end + 4, c->pending_len);
+    c->pending_pos = 0;
+    c->body_read = 0;
+    // like IDF: an unknown length reads as 0 (and the body is read until the connection closes)
+    return c->content_length > 0 ? c->content_length : 0;
+}
+
+int esp_http_client_read(esp_http_client_handle_t c, char *buffer, int len)
+{
+    if (c->fd < 0 || len <= 0) return c->fd < 0 ? -1 : 0;
+    if (c->content_length >= 0 && c->body_read + len > c->content_length) len = (int)(c->content_length - c->body_read);
+    if (len <= 0) return 0;
+    int n;
+    if (c->pending_pos < c->pending_len) {
+        n = (int)(c->pending_len - c->pending_pos);
+        if (n > len) n = len;
+        memcpy(buffer, c->pending + c->pending_pos, (size_t)n);
+        c->pending_pos += (size_t)n;
+    } else {
+        ssize_t r = recv(c->fd, buffer, (size_t)len, 0);
+        if (r < 0) return -1;
+        n = (int)r;
+    }
+    c->body_read += n;
+    return n;
+}
+
+int esp_http_client_read_response(esp_http_client_handle_t c, char *buffer, int len)
+{
+    int total = 0;
+    while (total < len) {
+        int n = esp_http_client_read(c, buffer + total, len - total);
+        if (n < 0) return total > 0 ? total : -1;
+        if (n == 0) break;
+        total += n;
+    }
+    return total;
+}
+
+// the blocking request of IDF: body from set_post_field, response delivered as HTTP_EVENT_ON_DATA
+esp_err_t esp_http_client_perform(esp_http_client_handle_t c)
+{
+    esp_err_t err = esp_http_client_open(c, c->post_len);
+    if (err != ESP_OK) return err;
+    if ((c->post_len > 0 && esp_http_client_write(c, c->post_data, c->post_len) != c->post_len) ||
+        esp_http_client_fetch_headers(c) < 0) {
+        esp_http_client_close(c);
+        return ESP_FAIL;
+    }
+    char buf[512];
+    int n;
+    while ((n = esp_http_client_read(c, buf, sizeof(buf))) > 0) {
+        esp_http_client_event_t evt = {
+            .event_id = HTTP_EVENT_ON_DATA,
+            .client = c,
+            .data = buf,
+            .data_len = n,
+            .user_data = c->user_data,
+        };
+        if (c->event_handler) c->event_handler(&evt);
+    }
+    esp_http_client_close(c);
+    return n < 0 ? ESP_FAIL : ESP_OK;
+}
+
+int esp_http_client_get_status_code(esp_http_client_handle_t c)
+{
+    return c->status;
+}
+
+long long esp_http_client_get_content_length(esp_http_client_handle_t c)
+{
+    return c->content_length;
+}
+
+bool esp_http_client_is_chunked_response(esp_http_client_handle_t c)
+{
+    return c->chunked;
+}
+
+esp_err_t esp_http_client_close(esp_http_client_handle_t c)
+{
+    if (c->fd >= 0) close(c->fd);
+    c->fd = -1;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t c)
+{
+    if (!c) return ESP_FAIL;
+    esp_http_client_close(c);
+    free(c->path);
+    free(c->headers);
+    free(c);
+    return ESP_OK;
+}
@@ -0,0 +1,372 @@
+// esp_sr_host.c - scripted esp-sr AFE / WakeNet / MultiNet for replay_sr (see esp_sr_host.h)
+#include "esp_sr_host.h"
+#include "esp_afe_sr_iface.h"
+#include "esp_afe_sr_models.h"
+#include "esp_mn_iface.h"
+#include "esp_mn_models.h"
+#include "esp_mn_speech_commands.h"
+#include "esp_timer.h"
+#include "model_path.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    int16_t pcm[ESP_SR_HOST_CHUNK];
+    int at_ms;
+} afe_frame_t;
+
+struct esp_afe_sr_data {
+    pthread_mutex_t m;
+    pthread_cond_t c;
+    afe_frame_t *ring;
+    int size, head, count;  // head: 最旧的一帧
+    bool wakenet_on;
+    bool verify_next;       // 上一帧是 WAKENET_DETECTED
+    bool shutdown;
+    int16_t out[ESP_SR_HOST_CHUNK];
+    afe_fetch_result_t res;
+};
+
+static const esp_sr_host_script_t *s_script;
+static int s_source_ms;
+static int s_next_wake, s_next_command;     // 下一个未处理的脚本事件（按种类各自推进）
+static int s_now_ms = -1;                   // detect_Task 最近取出的帧的音频时刻，MultiNet 以它计时
+static esp_sr_host_stats_t s_stats;
+static esp_afe_sr_data_t *s_afe;
+
+void esp_sr_host_setup(const esp_sr_host_script_t *script)
+{
+    s_script = script;
+    s_next_wake = s_next_command = 0;
+    s_now_ms = -1;
+    memset(&s_stats, 0, sizeof(s_stats));
+}
+
+void esp_sr_host_set_source_ms(int ms)
+{
+    s_source_ms = ms;
+}
+
+void esp_sr_host_get_stats(esp_sr_host_stats_t *out)
+{
+    if (s_afe) pthread_mutex_lock(&s_afe->m);
+    *out = s_stats;
+    if (s_afe) pthread_mutex_unlock(&s_afe->m);
+}
+
+void esp_sr_host_shutdown(void)
+{
+    if (!s_afe) return;
+    pthread_mutex_lock(&s_afe->m);
+    s_afe->shutdown = true;
+    pthread_cond_broadcast(&s_afe->c);
+    pthread_mutex_unlock(&s_afe->m);
+}
+
+static void spin_us(int us)
+{
+    if (us <= 0) return;
+    int64_t until = esp_timer_get_time() + us;
+    while (esp_timer_get_time() < until) {
+    }
+}
+
+// 下一个 kind 类事件的下标（从 *next 起），没有时为 event_count
+static int next_event(int *next, esp_sr_host_event_kind_t kind)
+{
+    while (*next < s_script->event_count && s_script->events[*next].kind != kind) (*next)++;
+    return *next;
+}
+
+// ---- AFE --------------------------------------------------------------------
+
+static esp_afe_sr_data_t *afe_create(afe_config_t *config)
+{
+    esp_afe_sr_data_t *afe = calloc(1, sizeof(*afe));
+    if (!afe) return NULL;
+    afe->size = config->afe_ringbuf_size > 0 ? config->afe_ringbuf_size : 50;
+    afe->ring = calloc((size_t)afe->size, sizeof(afe_frame_t));
+    if (!afe->ring) {
+        free(afe);
+        return NULL;
+    }
+    pthread_mutex_init(&afe->m, NULL);
+    pthread_cond_init(&afe->c, NULL);
+    afe->wakenet_on = config->wakenet_init;
+    s_stats.ringbuf_frames = afe->size;
+    s_afe = afe;
+    return afe;
+}
+
+static int afe_chunksize(esp_afe_sr_data_t *afe)
+{
+    (void)afe;
+    return ESP_SR_HOST_CHUNK;
+}
+
+static int afe_channel_num(esp_afe_sr_data_t *afe)
+{
+    (void)afe;
+    return ESP_SR_HOST_CHANNELS;
+}
+
+static int afe_feed(esp_afe_sr_data_t *afe, const int16_t *in)
+{
+    pthread_mutex_lock(&afe->m);
+    s_stats.fed++;
+    if (afe->count == afe->size) {
+        s_stats.dropped++;
+    } else {
+        afe_frame_t *f = &afe->ring[(afe->head + afe->count) % afe->size];
+        for (int i = 0; i < ESP_SR_HOST_CHUNK; i++) f->pcm[i] = in[i * ESP_SR_HOST_CHANNELS];
+        f->at_ms = s_source_ms;
+        afe->count++;
+        if (afe->count > s_stats.backlog_max) s_stats.backlog_max = afe->count;
+        pthread_cond_signal(&afe->c);
+    }
+    pthread_mutex_unlock(&afe->m);
+    return ESP_SR_HOST_CHUNK;
+}
+
+static afe_vad_state_t frame_vad(const int16_t *pcm)
+{
+    double sum = 0;
+    for (int i = 0; i < ESP_SR_HOST_CHUNK; i++) sum += (double)pcm[i] * pcm[i];
+    return sqrt(sum / ESP_SR_HOST_CHUNK) > s_script->vad_threshold ? AFE_VAD_SPEECH : AFE_VAD_SILENCE;
+}
+
+static afe_fetch_result_t *afe_fetch(esp_afe_sr_data_t *afe)
+{
+    afe_fetch_result_t *res = &afe->res;
+    memset(res, 0, sizeof(*res));
+    res->data = afe->out;
+    res->data_size = sizeof(afe->out);
+
+    pthread_mutex_lock(&afe->m);
+    while (afe->count == 0 && !afe->shutdown) pthread_cond_wait(&afe->c, &afe->m);
+    if (afe->count == 0) { // shutdown: silence, so detect_Task gets back to its loop condition
+        pthread_mutex_unlock(&afe->m);
+        memset(afe->out, 0, sizeof(afe->out));
+        return res;
+    }
+    afe_frame_t *f = &afe->ring[afe->head];
+    memcpy(afe->out, f->pcm, sizeof(afe->out));
+    int at = f->at_ms;
+    afe->head = (afe->head + 1) % afe->size;
+    afe->count--;
+    s_stats.fetched++;
+    s_stats.last_fetched_ms = at;
+
+    // 唤醒词：帧内（或已经过去）的唤醒事件；识别关闭时说出的不算
+    if (afe->verify_next && afe->wakenet_on) {
+        res->wakeup_state = WAKENET_CHANNEL_VERIFIED;
+    }
+    afe->verify_next = false;
+    int i = next_event(&s_next_wake, ESP_SR_HOST_WAKE);
+    if (i < s_script->event_count && s_script->events[i].at_ms < at + ESP_SR_HOST_FRAME_MS) {
+        s_next_wake++;
+        if (afe->wakenet_on && res->wakeup_state == WAKENET_NO_DETECT) {
+            res->wakeup_state = WAKENET_DETECTED;
+            afe->verify_next = true;
+            s_stats.wakes++;
+        } else {
+            s_stats.wakes_ignored++;
+        }
+    }
+    pthread_mutex_unlock(&afe->m);
+
+    s_now_ms = at;
+    res->vad_state = frame_vad(afe->out);
+    res->wake_word_index = res->wakeup_state != WAKENET_NO_DETECT ? 1 : 0;
+    res->ret_value = 0;
+    spin_us(s_script->fetch_cost_us);
+    return res;
+}
+
+static int afe_enable_wakenet(esp_afe_sr_data_t *afe)
+{
+    pthread_mutex_lock(&afe->m);
+    afe->wakenet_on = true;
+    pthread_mutex_unlock(&afe->m);
+    return 1;
+}
+
+static int afe_disable_wakenet(esp_afe_sr_data_t *afe)
+{
+    pthread_mutex_lock(&afe->m);
+    afe->wakenet_on = false;
+    afe->verify_next = false;
+    pthread_mutex_unlock(&afe->m);
+    return 0;
+}
+
+static void afe_destroy(esp_afe_sr_data_t *afe)
+{
+    (void)afe; // detect_Task may still be in fetch when the replay ends; the process exits right after
+}
+
+const esp_afe_sr_iface_t ESP_AFE_SR_HANDLE = {
+    .create_from_config = afe_create,
+    .get_feed_chunksize = afe_chunksize,
+    .get_fetch_chunksize = afe_chunksize,
+    .get_channel_num = afe_channel_num,
+    .feed = afe_feed,
+    .fetch = afe_fetch,
+    .enable_wakenet = afe_enable_wakenet,
+    .disable_wakenet = afe_disable_wakenet,
+    .destroy = afe_destroy,
+};
+
+// ---- MultiNet ---------------------------------------------------------------
+
+#define MN_HOST_MAX_COMMANDS 32
+
+static struct {
+    int id;
+    char phrase[ESP_MN_MAX_PHRASE_LEN + 1];
+} s_commands[MN_HOST_MAX_COMMANDS];
+static int s_command_count;
+
+struct model_iface_data {
+    int timeout_ms;
+    int listen_start_ms;    // -1: 下一次 detect 开始计时
+    esp_mn_results_t results;
+};
+
+esp_err_t esp_mn_commands_clear(void)
+{
+    s_command_count = 0;
+    return ESP_OK;
+}
+
+esp_err_t esp_mn_commands_add(int command_id, const char *phrase)
+{
+    if (s_command_count == MN_HOST_MAX_COMMANDS) return ESP_ERR_NO_MEM;
+    s_commands[s_command_count].id = command_id;
+    snprintf(s_commands[s_command_count].phrase, sizeof(s_commands[0].phrase), "%s", phrase);
+    s_command_count++;
+    return ESP_OK;
+}
+
+esp_err_t esp_mn_commands_update(void)
+{
+    return ESP_OK;
+}
+
+static model_iface_data_t *mn_create(const char *model_name, int duration)
+{
+    (void)model_name;
+    model_iface_data_t *m = calloc(1, sizeof(*m));
+    if (!m) return NULL;
+    m->timeout_ms = duration;
+    m->listen_start_ms = -1;
+    return m;
+}
+
+static int mn_chunksize(model_iface_data_t *m)
+{
+    (void)m;
+    return ESP_SR_HOST_CHUNK;
+}
+
+static esp_mn_state_t mn_detect(model_iface_data_t *m, int16_t *samples)
+{
+    (void)samples;
+    spin_us(s_script->detect_cost_us);
+    int now = s_now_ms;
+    if (m->listen_start_ms < 0) m->listen_start_ms = now;
+    int i;
+    while ((i = next_event(&s_next_command, ESP_SR_HOST_COMMAND)) < s_script->event_count &&
+           s_script->events[i].at_ms < m->listen_start_ms) {
+        s_next_command++;
+        s_stats.commands_missed++;
+    }
+    if (i < s_script->event_count && s_script->events[i].at_ms < now + ESP_SR_HOST_FRAME_MS) {
+        s_next_command++;
+        s_stats.commands++;
+        esp_mn_results_t *r = &m->results;
+        memset(r, 0, sizeof(*r));
+        r->state = ESP_MN_STATE_DETECTED;
+        r->num = 1;
+        r->command_id[0] = s_script->events[i].command_id;
+        r->prob[0] = 0.9f;
+        for (int k = 0; k < s_command_count; k++) {
+            if (s_commands[k].id == r->command_id[0]) {
+                r->phrase_id[0] = k;
+                snprintf(r->string, sizeof(r->string), "%s", s_commands[k].phrase);
+            }
+        }
+        m->listen_start_ms = -1;
+        return ESP_MN_STATE_DETECTED;
+    }
+    if (now - m->listen_start_ms >= m->timeout_ms) {
+        memset(&m->results, 0, sizeof(m->results));
+        m->results.state = ESP_MN_STATE_TIMEOUT;
+        m->listen_start_ms = -1;
+        return ESP_MN_STATE_TIMEOUT;
+    }
+    return ESP_MN_STATE_DETECTING;
+}
+
+static esp_mn_results_t *mn_get_results(model_iface_data_t *m)
+{
+    return &m->results;
+}
+
+static void mn_clean(model_iface_data_t *m)
+{
+    m->listen_start_ms = -1;
+}
+
+static void mn_destroy(model_iface_data_t *m)
+{
+    free(m);
+}
+
+static void mn_print_commands(model_iface_data_t *m)
+{
+    (void)m;
+    for (int k = 0; k < s_command_count; k++) printf("command %d: %s\n", s_commands[k].id, s_commands[k].phrase);
+}
+
+static esp_mn_iface_t s_multinet = {
+    .create = mn_create,
+    .get_samp_chunksize = mn_chunksize,
+    .detect = mn_detect,
+    .get_results = mn_get_results,
+    .clean = mn_clean,
+    .destroy = mn_destroy,
+    .print_active_speech_commands = mn_print_commands,
+};
+
+esp_mn_iface_t *esp_mn_handle_from_name(char *model_name)
+{
+    (void)model_name;
+    return &s_multinet;
+}
+
+// ---- models -----------------------------------------------------------------
+
+static char *s_model_names[] = { "wn9_nihaoxiaozhi_tts", "mn6_cn" };
+static srmodel_list_t s_models = { s_model_names, NULL, 2 };
+
+srmodel_list_t *esp_srmodel_init(const char *partition_label)
+{
+    (void)partition_label;
+    return &s_models;
+}
+
+char *esp_srmodel_filter(srmodel_list_t *models, const char *keyword1, const char *keyword2)
+{
+    for (int i = 0; i < models->num; i++) {
+        const char *n = models->model_name[i];
+        if (keyword1 && !strstr(n, keyword1)) continue;
+        if (keyword2 && !strstr(n, keyword2)) continue;
+        return models->model_name[i];
+    }
+    return NULL;
+}
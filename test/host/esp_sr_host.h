@@ -0,0 +1,56 @@
+// esp_sr_host.h - scripted stand-ins for the esp-sr AFE / WakeNet / MultiNet that app_sr.c drives
+//   AFE：feed 把每帧的麦克风通道放进 afe_ringbuf_size 帧的环形缓冲（满了丢掉新来的帧并计数，与设备上
+//   detect_Task 跟不上时一样），fetch 取出一帧，按能量给出 vad_state，按脚本在唤醒词时刻给出
+//   WAKENET_DETECTED、下一帧 WAKENET_CHANNEL_VERIFIED；MultiNet 在命令词时刻之后的第一帧监听帧返回
+//   DETECTED，监听超过 create 时给的时长返回 TIMEOUT。脚本时间都是音频时间（ms），由喂数据的一方
+//   通过 esp_sr_host_set_source_ms 标出每帧在音频里的位置，I2S 丢帧后仍然对得上
+#ifndef _ESP_SR_HOST_H_
+#define _ESP_SR_HOST_H_
+
+#include <stdint.h>
+
+#define ESP_SR_HOST_CHUNK    512    // feed/fetch 帧长（采样），16kHz 下 32ms
+#define ESP_SR_HOST_CHANNELS 2      // feed 输入：麦克风 + 回采，取第 0 通道
+#define ESP_SR_HOST_FRAME_MS (ESP_SR_HOST_CHUNK * 1000 / 16000)
+
+typedef enum {
+    ESP_SR_HOST_WAKE,
+    ESP_SR_HOST_COMMAND,
+} esp_sr_host_event_kind_t;
+
+typedef struct {
+    int at_ms;
+    esp_sr_host_event_kind_t kind;
+    int command_id;
+} esp_sr_host_event_t;
+
+typedef struct {
+    const esp_sr_host_event_t *events;  // 按 at_ms 升序
+    int event_count;
+    int fetch_cost_us;      // 每次 fetch 在 detect_Task 上模拟的计算耗时（AEC/NS/WakeNet）
+    int detect_cost_us;     // 每次 multinet->detect 的模拟耗时
+    int vad_threshold;      // 帧 RMS 超过它算说话
+} esp_sr_host_script_t;
+
+typedef struct {
+    unsigned fed;           // 送入 AFE 的帧数
+    unsigned fetched;
+    unsigned dropped;       // 环形缓冲满而丢掉的帧
+    int backlog_max;        // 环形缓冲中积压帧数的峰值
+    int ringbuf_frames;
+    int wakes;              // 生效的唤醒词
+    int wakes_ignored;      // 唤醒词识别关闭时说出的唤醒词
+    int commands;
+    int commands_missed;    // 不在监听状态时说出的命令词
+    int last_fetched_ms;    // 最后一帧取出的音频时刻
+} esp_sr_host_stats_t;
+
+// 在 app_sr_init 之前调用；script 须在整个回放期间有效
+void esp_sr_host_setup(const esp_sr_host_script_t *script);
+// 下一次 feed 的帧在音频中的起始时刻（由 bsp_get_feed_data 的实现在返回前调用）
+void esp_sr_host_set_source_ms(int ms);
+void esp_sr_host_get_stats(esp_sr_host_stats_t *out);
+// 结束回放：fetch 不再等数据（返回静音帧），detect_Task 才能看到 task_flag 清零后退出
+void esp_sr_host_shutdown(void);
+
+#endif // _ESP_SR_HOST_H_
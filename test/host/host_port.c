@@ -0,0 +1,398 @@
+// host_port.c - host implementations of the ESP-IDF/FreeRTOS calls used by the modules under test
+#define _GNU_SOURCE
+#include "host_port.h"
+#include "esp_log.h"
+#include "esp_event.h"
+#include "esp_netif.h"
+#include "esp_random.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "mbedtls/base64.h"
+#include "esp_crt_bundle.h"
+#include "wifi.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include <dirent.h>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// ---- log / misc -------------------------------------------------------------
+
+esp_log_level_t host_log_level = ESP_LOG_WARN;
+esp_event_base_t const IP_EVENT = "IP_EVENT";
+
+__attribute__((constructor)) static void host_log_init(void)
+{
+    const char *v = getenv("HOST_LOG");
+    if (v && strcmp(v, "info") == 0) host_log_level = ESP_LOG_INFO;
+    if (v && strcmp(v, "debug") == 0) host_log_level = ESP_LOG_DEBUG;
+}
+
+void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+    (void)tag; (void)level; // per-tag levels are not modelled; HOST_LOG sets the global one
+}
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len)
+{
+    crc = ~crc;
+    while (len--) {
+        crc ^= *buf++;
+        for (int k = 0; k < 8; k++) crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+    }
+    return ~crc;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+uint32_t esp_random(void)
+{
+    return (uint32_t)random();
+}
+
+esp_err_t esp_event_handler_instance_register(esp_event_base_t base, int32_t id, esp_event_handler_t handler,
+                                              void *arg, esp_event_handler_instance_t *instance)
+{
+    (void)base; (void)id; (void)handler; (void)arg; (void)instance;
+    return ESP_OK;
+}
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code) {
+    case ESP_OK: return "ESP_OK";
+    case ESP_FAIL: return "ESP_FAIL";
+    case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_TIMEOUT: return "ESP_ERR_TIMEOUT";
+    default: return "UNKNOWN ERROR";
+    }
+}
+
+uint32_t esp_get_free_heap_size(void)
+{
+    return 8 * 1024 * 1024; // nothing to measure on the host; what a board with 8MB PSRAM starts with
+}
+
+int mbedtls_base64_encode(unsigned char *dst, size_t dlen, size_t *olen, const unsigned char *src, size_t slen)
+{
+    static const char enc[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t need = (slen + 2) / 3 * 4;
+    *olen = need + 1;
+    if (dlen < need + 1) return MBEDTLS_ERR_BASE64_BUFFER_TOO_SMALL;
+    unsigned char *o = dst;
+    for (size_t i = 0; i < slen; i += 3) {
+        uint32_t v = (uint32_t)src[i] << 16;
+        if (i + 1 < slen) v |= (uint32_t)src[i + 1] << 8;
+        if (i + 2 < slen) v |= src[i + 2];
+        *o++ = (unsigned char)enc[v >> 18 & 63];
+        *o++ = (unsigned char)enc[v >> 12 & 63];
+        *o++ = i + 1 < slen ? (unsigned char)enc[v >> 6 & 63] : '=';
+        *o++ = i + 2 < slen ? (unsigned char)enc[v & 63] : '=';
+    }
+    *o = '\0';
+    *olen = need;
+    return 0;
+}
+
+esp_err_t esp_crt_bundle_attach(void *conf)
+{
+    (void)conf;
+    return ESP_OK;
+}
+
+bool wifi_wait_connected(int timeout_ms)
+{
+    (void)timeout_ms;
+    return true;
+}
+
+// ---- FreeRTOS ---------------------------------------------------------------
+
+static pthread_mutex_t s_critical = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+
+void host_critical_enter(void) { pthread_mutex_lock(&s_critical); }
+void host_critical_exit(void) { pthread_mutex_unlock(&s_critical); }
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(esp_timer_get_time() / 1000);
+}
+
+// a task: a detached pthread plus its notification value. Threads not started by xTaskCreatePinnedToCore
+// (main, the mock server) get one the first time they ask for their handle
+struct host_task {
+    pthread_mutex_t m;
+    pthread_cond_t c;
+    uint32_t value;
+    bool pending;           // notified since the last take/wait
+    TaskFunction_t fn;
+    void *arg;
+    struct host_task *next; // every task ever made, so none look leaked at exit
+};
+
+static __thread struct host_task *s_self;
+static struct host_task *s_tasks;
+
+static struct host_task *task_new(TaskFunction_t fn, void *arg)
+{
+    struct host_task *t = calloc(1, sizeof(*t));
+    if (!t) return NULL;
+    pthread_mutex_init(&t->m, NULL);
+    pthread_cond_init(&t->c, NULL);
+    t->fn = fn;
+    t->arg = arg;
+    host_critical_enter();
+    t->next = s_tasks;
+    s_tasks = t;
+    host_critical_exit();
+    return t;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    if (!s_self) s_self = task_new(NULL, NULL);
+    return s_self;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    usleep((useconds_t)ticks * 1000);
+}
+
+static void *task_main(void *p)
+{
+    s_self = p;
+    s_self->fn(s_self->arg);
+    return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack, void *arg,
+                                   UBaseType_t prio, TaskHandle_t *out, BaseType_t core)
+{
+    (void)name; (void)stack; (void)prio; (void)core;
+    struct host_task *t = task_new(fn, arg);
+    pthread_t th;
+    pthread_attr_t a;
+    pthread_attr_init(&a);
+    pthread_attr_setdetachstate(&a, PTHREAD_CREATE_DETACHED);
+    if (out) *out = t; // before the task runs: it may be notified right away
+    bool ok = t && pthread_create(&th, &a, task_main, t) == 0;
+    pthread_attr_destroy(&a);
+    if (!ok && out) *out = NULL;
+    return ok ? pdPASS : pdFAIL;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    configASSERT(task == NULL);
+    pthread_exit(NULL);
+}
+
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action)
+{
+    struct host_task *t = task;
+    pthread_mutex_lock(&t->m);
+    switch (action) {
+    case eSetBits: t->value |= value; break;
+    case eIncrement: t->value++; break;
+    case eSetValueWithOverwrite: t->value = value; break;
+    case eNoAction: break;
+    }
+    t->pending = true;
+    pthread_cond_signal(&t->c);
+    pthread_mutex_unlock(&t->m);
+    return pdPASS;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    return xTaskNotify(task, 0, eIncrement);
+}
+
+// wait on the calling task's notification; false on timeout. Called with t->m held
+static bool notify_wait(struct host_task *t, TickType_t wait)
+{
+    if (wait == portMAX_DELAY) {
+        while (!t->pending) pthread_cond_wait(&t->c, &t->m);
+        return true;
+    }
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += wait / 1000;
+    ts.tv_nsec += (long)(wait % 1000) * 1000000;
+    if (ts.tv_nsec >= 1000000000) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+    while (!t->pending) {
+        if (pthread_cond_timedwait(&t->c, &t->m, &ts) != 0) return t->pending;
+    }
+    return true;
+}
+
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t *value, TickType_t wait)
+{
+    struct host_task *t = xTaskGetCurrentTaskHandle();
+    pthread_mutex_lock(&t->m);
+    if (!t->pending) t->value &= ~clear_on_entry;
+    bool got = notify_wait(t, wait);
+    if (value) *value = t->value;
+    if (got) {
+        t->value &= ~clear_on_exit;
+        t->pending = false;
+    }
+    pthread_mutex_unlock(&t->m);
+    return got ? pdTRUE : pdFALSE;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t wait)
+{
+    struct host_task *t = xTaskGetCurrentTaskHandle();
+    pthread_mutex_lock(&t->m);
+    if (t->value == 0) notify_wait(t, wait);
+    uint32_t v = t->value;
+    if (v) t->value = clear_on_exit ? 0 : v - 1;
+    t->pending = t->value != 0;
+    pthread_mutex_unlock(&t->m);
+    return v;
+}
+
+struct host_sem {
+    pthread_mutex_t m;
+};
+
+static SemaphoreHandle_t sem_new(void)
+{
+    struct host_sem *s = malloc(sizeof(*s));
+    if (!s) return NULL;
+    pthread_mutexattr_t a;
+    pthread_mutexattr_init(&a);
+    pthread_mutexattr_settype(&a, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&s->m, &a);
+    pthread_mutexattr_destroy(&a);
+    return s;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) { return sem_new(); }
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex(void) { return sem_new(); }
+
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t *buf)
+{
+    buf->impl = sem_new();
+    return buf->impl;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t wait)
+{
+    (void)wait;
+    return pthread_mutex_lock(&sem->m) == 0 ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    return pthread_mutex_unlock(&sem->m) == 0 ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t sem, TickType_t wait) { return xSemaphoreTake(sem, wait); }
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t sem) { return xSemaphoreGive(sem); }
+
+// ---- /spiffs redirect -------------------------------------------------------
+
+FILE *__real_fopen(const char *path, const char *mode);
+int __real_remove(const char *path);
+int __real_rename(const char *from, const char *to);
+DIR *__real_opendir(const char *path);
+
+static char s_root[64];
+
+static void spiffs_cleanup(void)
+{
+    host_spiffs_reset();
+    rmdir(s_root);
+}
+
+static const char *spiffs_root(void)
+{
+    if (!s_root[0]) {
+        strcpy(s_root, "/tmp/host_spiffs.XXXXXX");
+        if (!mkdtemp(s_root)) {
+            perror("mkdtemp");
+            exit(1);
+        }
+        atexit(spiffs_cleanup);
+    }
+    return s_root;
+}
+
+// "/spiffs/x" -> "<root>/x"; other paths are used as they are
+static const char *map_path(const char *path, char *buf, size_t size)
+{
+    if (strncmp(path, "/spiffs", 7) != 0 || (path[7] != '/' && path[7] != '\0')) return path;
+    snprintf(buf, size, "%s%s", spiffs_root(), path + 7);
+    return buf;
+}
+
+FILE *__wrap_fopen(const char *path, const char *mode)
+{
+    char buf[256];
+    return __real_fopen(map_path(path, buf, sizeof(buf)), mode);
+}
+
+int __wrap_remove(const char *path)
+{
+    char buf[256];
+    return __real_remove(map_path(path, buf, sizeof(buf)));
+}
+
+int __wrap_rename(const char *from, const char *to)
+{
+    char a[256], b[256];
+    return __real_rename(map_path(from, a, sizeof(a)), map_path(to, b, sizeof(b)));
+}
+
+DIR *__wrap_opendir(const char *path)
+{
+    char buf[256];
+    return __real_opendir(map_path(path, buf, sizeof(buf)));
+}
+
+static int spiffs_walk(const char *prefix, bool unlink_files)
+{
+    DIR *d = __real_opendir(spiffs_root());
+    if (!d) return 0;
+    int n = 0;
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL) {
+        if (e->d_name[0] == '.') continue;
+        if (prefix && strncmp(e->d_name, prefix, strlen(prefix)) != 0) continue;
+        n++;
+        if (unlink_files) {
+            char path[512];
+            snprintf(path, sizeof(path), "%s/%s", s_root, e->d_name);
+            unlink(path);
+        }
+    }
+    closedir(d);
+    return n;
+}
+
+void host_spiffs_reset(void)
+{
+    spiffs_walk(NULL, true);
+}
+
+int host_spiffs_count(const char *prefix)
+{
+    return spiffs_walk(prefix, false);
+}
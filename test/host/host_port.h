@@ -0,0 +1,22 @@
+// host_port.h - host-only helpers behind the stand-in ESP-IDF/FreeRTOS headers in stubs/
+//   /spiffs/... 路径被重定向到一个临时目录（链接时 --wrap 掉 fopen/remove/rename/opendir），
+//   每个测试二进制一个目录，退出时删除
+#ifndef _HOST_PORT_H_
+#define _HOST_PORT_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// delete every file under the redirected /spiffs (a fresh "flash")
+void host_spiffs_reset(void);
+// number of files under the redirected /spiffs whose name starts with prefix
+int host_spiffs_count(const char *prefix);
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+            exit(1); \
+        } \
+    } while (0)
+
+#endif // _HOST_PORT_H_
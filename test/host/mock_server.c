@@ -0,0 +1,135 @@
+// mock_server.c - single-threaded HTTP/1.1 server on 127.0.0.1 for host tests
+#define _GNU_SOURCE
+#include "mock_server.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define MOCK_MAX_REQUEST (1024 * 1024)   // a streamed 6.5 s recording is ~280KB of base64
+#define MOCK_MAX_RESPONSE (64 * 1024)
+
+static int s_listen = -1;
+static pthread_t s_thread;
+static mock_handler_t s_handler;
+static void *s_ctx;
+
+// Transfer-Encoding: chunked body at p (len bytes so far): returns the decoded length, or -1 while the
+// terminating chunk has not arrived yet. With decode set the body is decoded in place
+static long dechunk(char *p, size_t len, bool decode)
+{
+    size_t in = 0, out = 0;
+    while (1) {
+        char *eol = memmem(p + in, len - in, "\r\n", 2);
+        if (!eol) return -1;
+        size_t n = strtoul(p + in, NULL, 16);
+        size_t data = (size_t)(eol + 2 - p);
+        if (data + n + 2 > len) return -1;
+        if (n == 0) return (long)out;
+        if (decode) memmove(p + out, p + data, n);
+        out += n;
+        in = data + n + 2;
+    }
+}
+
+static void serve(int fd)
+{
+    char *req = malloc(MOCK_MAX_REQUEST + 1);
+    char *resp = malloc(MOCK_MAX_RESPONSE);
+    if (!req || !resp) goto out;
+    size_t len = 0;
+    char *hdr_end = NULL;
+    long body_len = 0;
+    bool chunked = false;
+    while (1) {
+        if (len >= MOCK_MAX_REQUEST) goto out;
+        ssize_t n = recv(fd, req + len, MOCK_MAX_REQUEST - len, 0);
+        if (n <= 0) goto out;
+        len += (size_t)n;
+        req[len] = '\0';
+        if (!hdr_end && (hdr_end = strstr(req, "\r\n\r\n")) != NULL) {
+            for (char *h = strstr(req, "\r\n"); h && h < hdr_end; h = strstr(h + 2, "\r\n")) {
+                if (strncasecmp(h + 2, "Content-Length:", 15) == 0) body_len = atol(h + 17);
+                if (strncasecmp(h + 2, "Transfer-Encoding: chunked", 26) == 0) chunked = true;
+            }
+        }
+        if (!hdr_end) continue;
+        size_t have = len - (size_t)(hdr_end + 4 - req);
+        if (chunked) {
+            // only a body ending like the last chunk can be complete; check it all before decoding
+            if (have >= 5 && memcmp(req + len - 5, "0\r\n\r\n", 5) == 0 && dechunk(hdr_end + 4, have, false) >= 0) {
+                body_len = dechunk(hdr_end + 4, have, true);
+                break;
+            }
+        } else if (have >= (size_t)body_len) {
+            break;
+        }
+    }
+    char method[8], path[1024];
+    if (sscanf(req, "%7s %1023s", method, path) != 2) goto out;
+    mock_request_t r = {
+        .method = method,
+        .path = path,
+        .body = hdr_end + 4,
+        .body_len = (size_t)body_len,
+    };
+    ((char *)r.body)[body_len] = '\0';
+    resp[0] = '\0';
+    int status = s_handler(&r, resp, MOCK_MAX_RESPONSE, s_ctx);
+    char head[160];
+    int hn = snprintf(head, sizeof(head),
+                      "HTTP/1.1 %d MOCK\r\nContent-Type: application/json\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n",
+                      status, strlen(resp));
+    send(fd, head, (size_t)hn, MSG_NOSIGNAL);
+    send(fd, resp, strlen(resp), MSG_NOSIGNAL);
+out:
+    free(req);
+    free(resp);
+    close(fd);
+}
+
+static void *server_main(void *arg)
+{
+    (void)arg;
+    while (1) {
+        int fd = accept(s_listen, NULL, NULL);
+        if (fd < 0) break; // mock_server_stop shut the socket down
+        serve(fd);
+    }
+    return NULL;
+}
+
+int mock_server_start(int port, mock_handler_t handler, void *ctx)
+{
+    s_handler = handler;
+    s_ctx = ctx;
+    s_listen = socket(AF_INET, SOCK_STREAM, 0);
+    if (s_listen < 0) return -1;
+    int on = 1;
+    setsockopt(s_listen, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons((uint16_t)port) };
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(s_listen, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(s_listen, 4) != 0 ||
+        pthread_create(&s_thread, NULL, server_main, NULL) != 0) {
+        perror("mock_server_start");
+        close(s_listen);
+        s_listen = -1;
+        return -1;
+    }
+    return 0;
+}
+
+void mock_server_stop(void)
+{
+    if (s_listen < 0) return;
+    shutdown(s_listen, SHUT_RDWR);
+    pthread_join(s_thread, NULL);
+    close(s_listen);
+    s_listen = -1;
+}
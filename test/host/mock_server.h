@@ -0,0 +1,23 @@
+// mock_server.h - single-threaded HTTP/1.1 server on 127.0.0.1 for host tests
+//   每个连接处理一个请求后关闭；请求体按 Content-Length 或 chunked 读取（交给 handler 的是解码后的请求体）。
+//   handler 在服务线程里运行
+#ifndef _MOCK_SERVER_H_
+#define _MOCK_SERVER_H_
+
+#include <stddef.h>
+
+typedef struct {
+    const char *method;
+    const char *path;       // path and query string
+    const char *body;       // NUL-terminated
+    size_t body_len;
+} mock_request_t;
+
+// writes the response body (NUL-terminated, at most size - 1 bytes) and returns the HTTP status
+typedef int (*mock_handler_t)(const mock_request_t *req, char *resp, size_t size, void *ctx);
+
+// listen on 127.0.0.1:port; returns 0, or -1 if the port cannot be bound
+int mock_server_start(int port, mock_handler_t handler, void *ctx);
+void mock_server_stop(void);
+
+#endif // _MOCK_SERVER_H_
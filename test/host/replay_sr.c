@@ -0,0 +1,426 @@
+// replay_sr.c - drives app_sr.c's feed_Task / detect_Task / process_audio_task from a WAV file.
+// The AFE / WakeNet / MultiNet are the scripted stand-ins of esp_sr_host.c, the real cloud_asr.c and
+// cloud_llm.c talk to mock_server.c, and the real inventory store writes to the redirected /spiffs.
+// The microphone is paced like the I2S DMA (16kHz, 6 x 240-sample buffers; a reader that falls
+// further behind loses the oldest buffers, as on_recv_q_ovf counts on the device).
+// Prints the cmd_trace line of every command, then a report of per-stage latency, high-water marks
+// and drops; exits non-zero if the pipeline did not drain or a request to the mock was malformed.
+//
+//   replay_sr [-s speed] script.txt [audio.wav]
+//
+// Script lines (times are audio ms; '#' starts a comment):
+//   wake <ms>                 wake word (WAKENET_DETECTED, then CHANNEL_VERIFIED on the next frame)
+//   command <ms> <id>         command word, detected on the first listening frame from <ms> on
+//   speech <ms> <len>         without a WAV, the audio is synthesized: noise here, a low floor elsewhere
+//   asr <text>                what the mock ASR answers, one line per request, in order
+//   llm <content>             message.content of the mock LLM answers, one line per request, in order
+//   asr_delay / llm_delay / ui_delay / prompt_delay <ms>   time those stages take
+//   fetch_cost / detect_cost <us>                          CPU time of one AFE fetch / MultiNet detect
+//   vad_threshold <rms>       frame RMS above which the AFE reports speech (default 500)
+// app_sr.c and cmd_trace.c are included so the report can read their statics
+#include "app_sr.c"
+#include "cmd_trace.c"
+#include "esp_sr_host.h"
+#include "host_port.h"
+#include "mock_server.h"
+#include "esp_http_client.h"
+#include "cJSON.h"
+#include <math.h>
+#include <unistd.h>
+
+#define REPLAY_MAX_EVENTS  256
+#define REPLAY_MAX_REPLIES 64
+#define REPLAY_TAIL_MS     1000     // synthesized audio runs this long past the last scripted time
+#define REPLAY_DRAIN_MS    60000    // wall time the pipeline may take to settle after the audio
+#define I2S_DMA_BUF        240      // samples per DMA buffer (I2S_CHANNEL_DEFAULT_CONFIG)
+#define I2S_DMA_BUFS       6
+
+#define STR_(x) #x
+#define STR(x) STR_(x)
+
+// ---- script -----------------------------------------------------------------
+
+static esp_sr_host_event_t s_events[REPLAY_MAX_EVENTS];
+static esp_sr_host_script_t s_script = { .events = s_events, .vad_threshold = 500 };
+static struct { int at, len; } s_speech[REPLAY_MAX_EVENTS];
+static int s_speech_count;
+static char *s_asr_text[REPLAY_MAX_REPLIES], *s_llm_text[REPLAY_MAX_REPLIES];
+static int s_asr_count, s_llm_count;
+static int s_asr_delay, s_llm_delay, s_ui_delay, s_prompt_delay;
+static int s_script_end_ms;
+
+static int event_cmp(const void *a, const void *b)
+{
+    const esp_sr_host_event_t *x = a, *y = b;
+    return x->at_ms - y->at_ms;
+}
+
+static void script_end(int ms)
+{
+    if (ms > s_script_end_ms) s_script_end_ms = ms;
+}
+
+static int load_script(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    char line[4096];
+    int lineno = 0;
+    while (fgets(line, sizeof(line), f)) {
+        lineno++;
+        line[strcspn(line, "\r\n")] = '\0';
+        char *p = line + strspn(line, " \t");
+        if (*p == '\0' || *p == '#') continue;
+        char key[32];
+        int a = 0, b = 0, n = 0;
+        if (sscanf(p, "%31s %n", key, &n) != 1) continue;
+        char *rest = p + n;
+        bool ok = true;
+        if (strcmp(key, "asr") == 0 || strcmp(key, "llm") == 0) {
+            bool asr = key[0] == 'a';
+            int *count = asr ? &s_asr_count : &s_llm_count;
+            ok = *count < REPLAY_MAX_REPLIES;
+            if (ok) (asr ? s_asr_text : s_llm_text)[(*count)++] = strdup(rest);
+        } else {
+            char *hash = strchr(rest, '#');
+            if (hash) *hash = '\0';
+            int got = sscanf(rest, "%d %d", &a, &b);
+            if (strcmp(key, "wake") == 0 && got >= 1 && s_script.event_count < REPLAY_MAX_EVENTS) {
+                s_events[s_script.event_count++] = (esp_sr_host_event_t){ a, ESP_SR_HOST_WAKE, 0 };
+                script_end(a);
+            } else if (strcmp(key, "command") == 0 && got == 2 && s_script.event_count < REPLAY_MAX_EVENTS) {
+                s_events[s_script.event_count++] = (esp_sr_host_event_t){ a, ESP_SR_HOST_COMMAND, b };
+                script_end(a);
+            } else if (strcmp(key, "speech") == 0 && got == 2 && s_speech_count < REPLAY_MAX_EVENTS) {
+                s_speech[s_speech_count].at = a;
+                s_speech[s_speech_count++].len = b;
+                script_end(a + b);
+            } else if (got == 1 && strcmp(key, "asr_delay") == 0) s_asr_delay = a;
+            else if (got == 1 && strcmp(key, "llm_delay") == 0) s_llm_delay = a;
+            else if (got == 1 && strcmp(key, "ui_delay") == 0) s_ui_delay = a;
+            else if (got == 1 && strcmp(key, "prompt_delay") == 0) s_prompt_delay = a;
+            else if (got == 1 && strcmp(key, "fetch_cost") == 0) s_script.fetch_cost_us = a;
+            else if (got == 1 && strcmp(key, "detect_cost") == 0) s_script.detect_cost_us = a;
+            else if (got == 1 && strcmp(key, "vad_threshold") == 0) s_script.vad_threshold = a;
+            else ok = false;
+        }
+        if (!ok) {
+            fprintf(stderr, "%s:%d: cannot use \"%s\"\n", path, lineno, p);
+            fclose(f);
+            return -1;
+        }
+    }
+    fclose(f);
+    qsort(s_events, (size_t)s_script.event_count, sizeof(s_events[0]), event_cmp);
+    return 0;
+}
+
+// ---- audio ------------------------------------------------------------------
+
+static int16_t *s_audio;
+static size_t s_audio_len;      // samples
+
+static uint32_t le32(const uint8_t *p) { return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24; }
+static uint16_t le16(const uint8_t *p) { return (uint16_t)(p[0] | p[1] << 8); }
+
+// 16-bit PCM at 16kHz; the first channel is the microphone
+static int load_wav(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    uint8_t hdr[12], ck[8];
+    int channels = 0;
+    int rc = -1;
+    if (fread(hdr, 1, 12, f) != 12 || memcmp(hdr, "RIFF", 4) != 0 || memcmp(hdr + 8, "WAVE", 4) != 0) goto out;
+    while (fread(ck, 1, 8, f) == 8) {
+        uint32_t size = le32(ck + 4);
+        if (memcmp(ck, "fmt ", 4) == 0) {
+            uint8_t fmt[16];
+            if (size < 16 || fread(fmt, 1, 16, f) != 16) goto out;
+            channels = le16(fmt + 2);
+            if (le16(fmt) != 1 || le32(fmt + 4) != RECORD_SAMPLE_RATE || le16(fmt + 14) != 16 || channels < 1) {
+                fprintf(stderr, "%s: need 16-bit PCM at %d Hz\n", path, RECORD_SAMPLE_RATE);
+                goto out;
+            }
+            fseek(f, (long)(size - 16 + (size & 1)), SEEK_CUR);
+        } else if (memcmp(ck, "data", 4) == 0 && channels) {
+            size_t frames = size / (2u * (unsigned)channels);
+            int16_t *raw = malloc(size);
+            s_audio = malloc(frames * sizeof(int16_t));
+            if (!raw || !s_audio || fread(raw, 1, size, f) != size) {
+                free(raw);
+                goto out;
+            }
+            for (size_t i = 0; i < frames; i++) s_audio[i] = raw[i * (size_t)channels];
+            free(raw);
+            s_audio_len = frames;
+            rc = 0;
+            break;
+        } else {
+            fseek(f, (long)(size + (size & 1)), SEEK_CUR);
+        }
+    }
+out:
+    if (rc != 0) fprintf(stderr, "%s: not a usable WAV file\n", path);
+    fclose(f);
+    return rc;
+}
+
+// noise for the speech segments, a quiet floor elsewhere; the same audio every run
+static int synth_audio(void)
+{
+    s_audio_len = (size_t)(s_script_end_ms + REPLAY_TAIL_MS) * (RECORD_SAMPLE_RATE / 1000);
+    s_audio = malloc(s_audio_len * sizeof(int16_t));
+    if (!s_audio) return -1;
+    uint32_t seed = 1;
+    for (size_t i = 0; i < s_audio_len; i++) {
+        int ms = (int)(i / (RECORD_SAMPLE_RATE / 1000));
+        int amp = 30;
+        for (int k = 0; k < s_speech_count; k++) {
+            if (ms >= s_speech[k].at && ms < s_speech[k].at + s_speech[k].len) amp = 6000;
+        }
+        seed = seed * 1664525u + 1013904223u;
+        s_audio[i] = (int16_t)((int)(seed >> 16) % (2 * amp + 1) - amp);
+    }
+    return 0;
+}
+
+// ---- board: the microphone ----------------------------------------------------
+
+static double s_speed = 1.0;
+static int64_t s_feed_t0;
+static size_t s_feed_pos;       // next sample to hand out
+static uint32_t s_i2s_overflows;
+
+int bsp_get_feed_channel(void)
+{
+    return ESP_SR_HOST_CHANNELS;
+}
+
+// blocks until the chunk has been "recorded"; past the end of the audio the microphone hears silence
+esp_err_t bsp_get_feed_data(bool is_get_raw_channel, int16_t *buffer, int buffer_len)
+{
+    (void)is_get_raw_channel;
+    int frames = buffer_len / (int)(sizeof(int16_t) * ESP_SR_HOST_CHANNELS);
+    int64_t now = esp_timer_get_time();
+    if (s_feed_t0 == 0) s_feed_t0 = now;
+    double us_per_sample = 1e6 / RECORD_SAMPLE_RATE / s_speed;
+    // samples already in the DMA ring; what is older than the ring has been overwritten
+    size_t avail = (size_t)((double)(now - s_feed_t0) / us_per_sample);
+    if (avail > s_feed_pos + I2S_DMA_BUF * I2S_DMA_BUFS) {
+        size_t lost = avail - (s_feed_pos + I2S_DMA_BUF * I2S_DMA_BUFS);
+        lost = (lost + I2S_DMA_BUF - 1) / I2S_DMA_BUF * I2S_DMA_BUF;
+        s_i2s_overflows += (uint32_t)(lost / I2S_DMA_BUF);
+        s_feed_pos += lost;
+    }
+    int64_t ready = s_feed_t0 + (int64_t)((double)(s_feed_pos + (size_t)frames) * us_per_sample);
+    if (ready > now) usleep((useconds_t)(ready - now));
+    for (int i = 0; i < frames; i++) {
+        size_t k = s_feed_pos + (size_t)i;
+        buffer[i * ESP_SR_HOST_CHANNELS] = k < s_audio_len ? s_audio[k] : 0;
+        for (int c = 1; c < ESP_SR_HOST_CHANNELS; c++) buffer[i * ESP_SR_HOST_CHANNELS + c] = 0; // no playback
+    }
+    esp_sr_host_set_source_ms((int)(s_feed_pos * 1000 / RECORD_SAMPLE_RATE));
+    s_feed_pos += (size_t)frames;
+    return ESP_OK;
+}
+
+uint32_t bsp_get_feed_overflows(void)
+{
+    return s_i2s_overflows;
+}
+
+// ---- UI, prompts and sync: nothing behind them but the scripted time they take ----------
+
+void ai_gui_in(void) {}
+void ai_gui_out(void) {}
+void ai_volume_up(void) {}
+void ai_volume_down(void) {}
+void ui_inventory_refresh(void) { vTaskDelay(pdMS_TO_TICKS(s_ui_delay)); }
+void ui_recipe_show_text(const char *text) { (void)text; }
+void ui_play_prompt_add(void) { vTaskDelay(pdMS_TO_TICKS(s_prompt_delay)); }
+void ui_play_prompt_remove(void) { vTaskDelay(pdMS_TO_TICKS(s_prompt_delay)); }
+void ui_play_prompt_show(void) { vTaskDelay(pdMS_TO_TICKS(s_prompt_delay)); }
+
+int sync_enqueue_batch(const char *const *event_types, const char *const *payloads_json, int count)
+{
+    (void)event_types; (void)payloads_json; (void)count;
+    return 0;
+}
+
+// ---- mock cloud -----------------------------------------------------------------
+
+static int s_asr_requests, s_asr_next, s_llm_requests, s_llm_next, s_mock_errors;
+static long s_asr_audio_bytes;
+
+static int reply_json(cJSON *root, char *resp, size_t size)
+{
+    char *s = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    if (!s || strlen(s) >= size) {
+        free(s);
+        return 500;
+    }
+    strcpy(resp, s);
+    free(s);
+    return 200;
+}
+
+// {"format":"pcm",...,"speech":"<base64>","len":N}: the audio must be all there
+static int mock_asr(const mock_request_t *req, char *resp, size_t size)
+{
+    s_asr_requests++;
+    cJSON *body = cJSON_Parse(req->body);
+    cJSON *speech = cJSON_GetObjectItem(body, "speech");
+    cJSON *len = cJSON_GetObjectItem(body, "len");
+    size_t b64 = speech && cJSON_IsString(speech) ? strlen(speech->valuestring) : 0;
+    size_t pad = b64 >= 2 ? (speech->valuestring[b64 - 1] == '=') + (speech->valuestring[b64 - 2] == '=') : 0;
+    long bytes = (long)(b64 / 4 * 3 - pad);
+    bool ok = cJSON_IsNumber(len) && b64 % 4 == 0 && bytes == len->valueint;
+    cJSON_Delete(body);
+    if (!ok) {
+        fprintf(stderr, "mock asr: malformed request (%zu bytes of base64)\n", b64);
+        s_mock_errors++;
+        snprintf(resp, size, "{\"err_no\":3300,\"err_msg\":\"speech param error\"}");
+        return 200;
+    }
+    s_asr_audio_bytes += bytes;
+    usleep((useconds_t)s_asr_delay * 1000);
+    if (s_asr_next == s_asr_count) {
+        snprintf(resp, size, "{\"err_no\":3301,\"err_msg\":\"speech quality error\"}");
+        return 200;
+    }
+    cJSON *root = cJSON_CreateObject();
+    cJSON *result = cJSON_CreateArray();
+    cJSON_AddStringToObject(root, "err_msg", "success.");
+    cJSON_AddItemToObject(root, "result", result);
+    cJSON_AddItemToArray(result, cJSON_CreateString(s_asr_text[s_asr_next++]));
+    return reply_json(root, resp, size);
+}
+
+static int mock_llm(const mock_request_t *req, char *resp, size_t size)
+{
+    (void)req;
+    s_llm_requests++;
+    usleep((useconds_t)s_llm_delay * 1000);
+    cJSON *root = cJSON_CreateObject();
+    cJSON *choices = cJSON_CreateArray();
+    cJSON *choice = cJSON_CreateObject();
+    cJSON *message = cJSON_CreateObject();
+    cJSON_AddStringToObject(message, "role", "assistant");
+    cJSON_AddStringToObject(message, "content", s_llm_next < s_llm_count ? s_llm_text[s_llm_next++] : "[]");
+    cJSON_AddItemToObject(choice, "message", message);
+    cJSON_AddItemToArray(choices, choice);
+    cJSON_AddItemToObject(root, "choices", choices);
+    return reply_json(root, resp, size);
+}
+
+static int mock_handler(const mock_request_t *req, char *resp, size_t size, void *ctx)
+{
+    (void)ctx;
+    if (strncmp(req->path, "/oauth/2.0/token", 16) == 0) {
+        snprintf(resp, size, "{\"access_token\":\"mock-token\",\"expires_in\":2592000}");
+        return 200;
+    }
+    if (strcmp(req->path, "/server_api") == 0) return mock_asr(req, resp, size);
+    if (strcmp(req->path, "/v2/chat/completions") == 0) return mock_llm(req, resp, size);
+    s_mock_errors++;
+    fprintf(stderr, "mock: unexpected %s %s\n", req->method, req->path);
+    return 404;
+}
+
+// ---- report -----------------------------------------------------------------
+
+static void report(const char *script, const char *wav)
+{
+    trace_rec_t recs[CMD_TRACE_RING_SIZE];
+    int count = copy_ring(recs);
+    printf("\n== replay %s (%s, %.1f s) at %.1fx\n", script, wav ? wav : "synthesized",
+           (double)s_audio_len / RECORD_SAMPLE_RATE, s_speed);
+    printf("-- latency (ms) over the last %d command(s)\n", count);
+    printf("   %-12s %4s %6s %6s %6s\n", "stage", "n", "p50", "p95", "max");
+    int32_t v[CMD_TRACE_RING_SIZE];
+    for (int s = 0; s <= CMD_TRACE_STAGE_COUNT; s++) {
+        int n = 0;
+        for (int i = 0; i < count; i++) {
+            int32_t d = s < CMD_TRACE_STAGE_COUNT ? recs[i].dur_us[s] : recs[i].total_us;
+            if (d >= 0) v[n++] = d;
+        }
+        if (n == 0) continue;
+        int32_t p50 = percentile(v, n, 50), p95 = percentile(v, n, 95); // sorts v
+        printf("   %-12s %4d %6d %6d %6d\n", s < CMD_TRACE_STAGE_COUNT ? s_stage_names[s] : "total", n,
+               (int)(p50 / 1000), (int)(p95 / 1000), (int)(v[n - 1] / 1000));
+    }
+
+    esp_sr_host_stats_t sr;
+    esp_sr_host_get_stats(&sr);
+    printf("-- high-water\n");
+    printf("   afe ring        %d/%d frames (%d ms)\n", sr.backlog_max, sr.ringbuf_frames,
+           sr.backlog_max * ESP_SR_HOST_FRAME_MS);
+    printf("   afe lag         %d ms (fed - fetched)\n", SAMPLES_TO_MS(atomic_load(&s_stats.lag_max)));
+    printf("   record buffers  %d/%d\n", atomic_load(&s_stats.inflight_max), RECORD_POOL_SIZE);
+    printf("   capture         %d ms of %d ms\n", RECORD_BYTES_TO_MS(atomic_load(&s_stats.capture_max)),
+           RECORD_BYTES_TO_MS(RECORD_BUFFER_SIZE));
+    printf("-- drops\n");
+    printf("   i2s overflows   %u DMA buffers (%d ms)\n", (unsigned)s_i2s_overflows,
+           (int)(s_i2s_overflows * I2S_DMA_BUF * 1000 / RECORD_SAMPLE_RATE));
+    printf("   afe ring full   %u frames (%d ms)\n", sr.dropped, (int)sr.dropped * ESP_SR_HOST_FRAME_MS);
+    printf("   no buffer       %u recordings\n", atomic_load(&s_stats.no_buffer));
+    printf("   truncated       %u recordings\n", atomic_load(&s_stats.truncated));
+    printf("   wake words      %d heard, %d while not listening for one\n", sr.wakes, sr.wakes_ignored);
+    printf("   commands        %d heard, %d while not listening for one\n", sr.commands, sr.commands_missed);
+    printf("-- cloud\n");
+    printf("   asr             %d requests, %ld bytes of audio, %d/%d scripted answers used\n",
+           s_asr_requests, s_asr_audio_bytes, s_asr_next, s_asr_count);
+    printf("   llm             %d requests, %d/%d scripted answers used\n", s_llm_requests, s_llm_next, s_llm_count);
+    printf("   inventory       %d items\n", inventory_count());
+}
+
+int main(int argc, char **argv)
+{
+    int opt;
+    while ((opt = getopt(argc, argv, "s:")) != -1) {
+        if (opt == 's' && atof(optarg) > 0) s_speed = atof(optarg);
+        else optind = argc + 1;
+    }
+    if (optind >= argc || argc - optind > 2) {
+        fprintf(stderr, "usage: %s [-s speed] script.txt [audio.wav]\n", argv[0]);
+        return 2;
+    }
+    const char *script = argv[optind], *wav = argv[optind + 1];
+    if (load_script(script) != 0) return 2;
+    if (wav ? load_wav(wav) != 0 : synth_audio() != 0) return 2;
+    int audio_ms = (int)(s_audio_len * 1000 / RECORD_SAMPLE_RATE);
+
+    host_spiffs_reset();
+    inventory_init();
+    CHECK(mock_server_start(MOCK_PORT, mock_handler, NULL) == 0);
+    esp_http_client_host_redirect("127.0.0.1:" STR(MOCK_PORT));
+    esp_sr_host_setup(&s_script);
+    app_sr_init();
+
+    // all of the audio through the AFE, then every recording recognised and the front end waiting
+    int64_t deadline = esp_timer_get_time() + (int64_t)(audio_ms / s_speed + REPLAY_DRAIN_MS) * 1000;
+    esp_sr_host_stats_t sr;
+    bool drained = false;
+    while (!drained && esp_timer_get_time() < deadline) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+        esp_sr_host_get_stats(&sr);
+        drained = sr.last_fetched_ms + ESP_SR_HOST_FRAME_MS >= audio_ms && app_sr_get_state() == SR_STATE_IDLE &&
+                  atomic_load(&s_captures_inflight) == 0;
+    }
+    task_flag = 0;
+    esp_sr_host_shutdown();
+    vTaskDelay(pdMS_TO_TICKS(100)); // feed_Task and detect_Task leave their loops
+
+    report(script, wav);
+    mock_server_stop();
+    if (!drained) fprintf(stderr, "replay: the pipeline did not settle within %d ms after the audio\n", REPLAY_DRAIN_MS);
+    return drained && s_mock_errors == 0 ? 0 : 1;
+}
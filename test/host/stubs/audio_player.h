@@ -0,0 +1,2 @@
+// host stand-in for audio_player.h: prompts are played by the UI stand-ins of the test that needs them
+#pragma once
@@ -0,0 +1,46 @@
+// host stand-in for cJSON.h, used only when no real cJSON is found (see CJSON_DIR in the Makefile).
+// Same struct layout, type bits and calls as cJSON for what the modules under test use; cjson_host.c
+// implements them with a complete JSON parser and printer, so the inventory mutation log really is replayed
+// and the cloud request bodies really are built
+#pragma once
+#include <stdbool.h>
+
+#define cJSON_Invalid (0)
+#define cJSON_False  (1 << 0)
+#define cJSON_True   (1 << 1)
+#define cJSON_NULL   (1 << 2)
+#define cJSON_Number (1 << 3)
+#define cJSON_String (1 << 4)
+#define cJSON_Array  (1 << 5)
+#define cJSON_Object (1 << 6)
+
+typedef int cJSON_bool;
+
+typedef struct cJSON {
+    struct cJSON *next, *prev, *child;
+    int type;
+    char *valuestring;
+    int valueint;
+    double valuedouble;
+    char *string;
+} cJSON;
+
+cJSON *cJSON_Parse(const char *value);
+void cJSON_Delete(cJSON *item);
+cJSON *cJSON_GetObjectItem(const cJSON *object, const char *name);
+cJSON_bool cJSON_IsNumber(const cJSON *item);
+cJSON_bool cJSON_IsString(const cJSON *item);
+cJSON_bool cJSON_IsObject(const cJSON *item);
+cJSON_bool cJSON_IsArray(const cJSON *item);
+cJSON *cJSON_GetArrayItem(const cJSON *array, int index);
+
+cJSON *cJSON_CreateObject(void);
+cJSON *cJSON_CreateArray(void);
+cJSON *cJSON_CreateString(const char *string);
+cJSON *cJSON_AddStringToObject(cJSON *object, const char *name, const char *string);
+cJSON_bool cJSON_AddItemToObject(cJSON *object, const char *string, cJSON *item);
+cJSON_bool cJSON_AddItemToArray(cJSON *array, cJSON *item);
+char *cJSON_PrintUnformatted(const cJSON *item);
+
+#define cJSON_ArrayForEach(element, array) \
+    for (element = (array) != NULL ? (array)->child : NULL; element != NULL; element = element->next)
@@ -0,0 +1,7 @@
+// host stand-in for driver/i2s_std.h: only the type esp32_s3_szp.h declares functions with
+#pragma once
+
+typedef enum {
+    I2S_SLOT_MODE_MONO = 1,
+    I2S_SLOT_MODE_STEREO = 2,
+} i2s_slot_mode_t;
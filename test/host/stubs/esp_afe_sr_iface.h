@@ -0,0 +1,54 @@
+// host stand-in for esp-sr's esp_afe_sr_iface.h: the part of the AFE interface app_sr.c uses.
+// The implementation (esp_sr_host.c) plays back a script instead of running the models
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_wn_iface.h"
+
+typedef enum {
+    AFE_VAD_SILENCE = 0,
+    AFE_VAD_SPEECH = 1,
+} afe_vad_state_t;
+
+typedef struct {
+    int16_t *data;              // one fetch chunk of processed (single channel) audio
+    int data_size;              // bytes
+    wakenet_state_t wakeup_state;
+    int wake_word_index;
+    int wakenet_model_index;
+    afe_vad_state_t vad_state;
+    int trigger_channel_id;
+    int ret_value;              // ESP_OK / ESP_FAIL
+} afe_fetch_result_t;
+
+typedef struct {
+    bool aec_init;
+    bool se_init;
+    bool vad_init;
+    bool wakenet_init;
+    char *wakenet_model_name;
+    int afe_ringbuf_size;       // frames the AFE buffers between feed and fetch
+} afe_config_t;
+
+#define AFE_CONFIG_DEFAULT() { \
+    .aec_init = true, \
+    .se_init = true, \
+    .vad_init = true, \
+    .wakenet_init = true, \
+    .wakenet_model_name = NULL, \
+    .afe_ringbuf_size = 50, \
+}
+
+typedef struct esp_afe_sr_data esp_afe_sr_data_t;
+
+typedef struct {
+    esp_afe_sr_data_t *(*create_from_config)(afe_config_t *config);
+    int (*get_feed_chunksize)(esp_afe_sr_data_t *afe);
+    int (*get_fetch_chunksize)(esp_afe_sr_data_t *afe);
+    int (*get_channel_num)(esp_afe_sr_data_t *afe);
+    int (*feed)(esp_afe_sr_data_t *afe, const int16_t *in);
+    afe_fetch_result_t *(*fetch)(esp_afe_sr_data_t *afe);
+    int (*enable_wakenet)(esp_afe_sr_data_t *afe);
+    int (*disable_wakenet)(esp_afe_sr_data_t *afe);
+    void (*destroy)(esp_afe_sr_data_t *afe);
+} esp_afe_sr_iface_t;
@@ -0,0 +1,5 @@
+// host stand-in for esp-sr's esp_afe_sr_models.h
+#pragma once
+#include "esp_afe_sr_iface.h"
+
+extern const esp_afe_sr_iface_t ESP_AFE_SR_HANDLE;
@@ -0,0 +1,2 @@
+// host stand-in for esp_codec_dev_defaults.h: included by esp32_s3_szp.h, nothing in it is used on the host
+#pragma once
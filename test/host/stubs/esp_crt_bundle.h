@@ -0,0 +1,5 @@
+// host stand-in for esp_crt_bundle.h; the host HTTP client only speaks plain http
+#pragma once
+#include "esp_err.h"
+
+esp_err_t esp_crt_bundle_attach(void *conf);
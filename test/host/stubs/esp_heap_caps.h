@@ -0,0 +1,17 @@
+// host stand-in for esp_heap_caps.h: every capability is plain malloc
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define MALLOC_CAP_8BIT     (1 << 2)
+#define MALLOC_CAP_DMA      (1 << 3)
+#define MALLOC_CAP_SPIRAM   (1 << 10)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+
+#define heap_caps_malloc(size, caps)        ((void)(caps), malloc(size))
+#define heap_caps_calloc(n, size, caps)     ((void)(caps), calloc(n, size))
+#define heap_caps_realloc(p, size, caps)    ((void)(caps), realloc(p, size))
+
+// esp_system.h on the device; reached through other IDF headers there
+uint32_t esp_get_free_heap_size(void);
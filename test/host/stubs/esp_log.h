@@ -0,0 +1,24 @@
+// host stand-in for esp_log.h: logs go to stderr, warnings and errors only unless HOST_LOG=info
+#pragma once
+#include <stdio.h>
+
+typedef enum {
+    ESP_LOG_NONE,
+    ESP_LOG_ERROR,
+    ESP_LOG_WARN,
+    ESP_LOG_INFO,
+    ESP_LOG_DEBUG,
+    ESP_LOG_VERBOSE,
+} esp_log_level_t;
+
+extern esp_log_level_t host_log_level;
+void esp_log_level_set(const char *tag, esp_log_level_t level);
+
+#define HOST_LOG(level, letter, tag, fmt, ...) do { \
+        if (host_log_level >= (level)) fprintf(stderr, letter " (%s) " fmt "\n", tag, ##__VA_ARGS__); \
+    } while (0)
+#define ESP_LOGE(tag, fmt, ...) HOST_LOG(ESP_LOG_ERROR, "E", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) HOST_LOG(ESP_LOG_WARN, "W", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) HOST_LOG(ESP_LOG_INFO, "I", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...) HOST_LOG(ESP_LOG_DEBUG, "D", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGV(tag, fmt, ...) HOST_LOG(ESP_LOG_VERBOSE, "V", tag, fmt, ##__VA_ARGS__)
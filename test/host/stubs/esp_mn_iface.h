@@ -0,0 +1,33 @@
+// host stand-in for esp-sr's esp_mn_iface.h: the part of the MultiNet interface app_sr.c uses
+#pragma once
+#include <stdint.h>
+
+#define ESP_MN_RESULT_MAX_NUM 5
+#define ESP_MN_MAX_PHRASE_LEN 63
+
+typedef enum {
+    ESP_MN_STATE_DETECTING = 0,
+    ESP_MN_STATE_DETECTED = 1,
+    ESP_MN_STATE_TIMEOUT = 2,
+} esp_mn_state_t;
+
+typedef struct {
+    esp_mn_state_t state;
+    int num;
+    int command_id[ESP_MN_RESULT_MAX_NUM];
+    int phrase_id[ESP_MN_RESULT_MAX_NUM];
+    float prob[ESP_MN_RESULT_MAX_NUM];
+    char string[256];
+} esp_mn_results_t;
+
+typedef struct model_iface_data model_iface_data_t;
+
+typedef struct {
+    model_iface_data_t *(*create)(const char *model_name, int duration);
+    int (*get_samp_chunksize)(model_iface_data_t *model);
+    esp_mn_state_t (*detect)(model_iface_data_t *model, int16_t *samples);
+    esp_mn_results_t *(*get_results)(model_iface_data_t *model);
+    void (*clean)(model_iface_data_t *model);
+    void (*destroy)(model_iface_data_t *model);
+    void (*print_active_speech_commands)(model_iface_data_t *model);
+} esp_mn_iface_t;
@@ -0,0 +1,8 @@
+// host stand-in for esp-sr's esp_mn_models.h
+#pragma once
+#include "esp_mn_iface.h"
+
+#define ESP_MN_PREFIX  "mn"
+#define ESP_MN_CHINESE "cn"
+
+esp_mn_iface_t *esp_mn_handle_from_name(char *model_name);
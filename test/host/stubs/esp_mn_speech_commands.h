@@ -0,0 +1,7 @@
+// host stand-in for esp-sr's esp_mn_speech_commands.h
+#pragma once
+#include "esp_err.h"
+
+esp_err_t esp_mn_commands_clear(void);
+esp_err_t esp_mn_commands_add(int command_id, const char *phrase);
+esp_err_t esp_mn_commands_update(void);
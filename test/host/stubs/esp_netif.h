@@ -0,0 +1,10 @@
+// host stand-in for esp_netif.h
+#pragma once
+#include "esp_event.h"
+
+extern esp_event_base_t const IP_EVENT;
+
+enum {
+    IP_EVENT_STA_GOT_IP,
+    IP_EVENT_STA_LOST_IP,
+};
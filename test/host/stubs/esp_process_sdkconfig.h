@@ -0,0 +1,2 @@
+// host stand-in for esp-sr's esp_process_sdkconfig.h (command words come from esp_mn_commands_add)
+#pragma once
@@ -0,0 +1,5 @@
+// host stand-in for esp_random.h
+#pragma once
+#include <stdint.h>
+
+uint32_t esp_random(void);
@@ -0,0 +1,2 @@
+// host stand-in for esp_task_wdt.h: there is no task watchdog on the host
+#pragma once
@@ -0,0 +1,5 @@
+// host stand-in for esp_timer.h: microseconds since start-up (CLOCK_MONOTONIC)
+#pragma once
+#include <stdint.h>
+
+int64_t esp_timer_get_time(void);
@@ -0,0 +1,8 @@
+// host stand-in for esp-sr's esp_wn_iface.h (the wake word states app_sr.c reads)
+#pragma once
+
+typedef enum {
+    WAKENET_NO_DETECT = 0,
+    WAKENET_CHANNEL_VERIFIED = -1,
+    WAKENET_DETECTED = 1,
+} wakenet_state_t;
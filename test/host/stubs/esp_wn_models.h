@@ -0,0 +1,4 @@
+// host stand-in for esp-sr's esp_wn_models.h
+#pragma once
+
+#define ESP_WN_PREFIX "wn"
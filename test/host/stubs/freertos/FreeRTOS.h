@@ -0,0 +1,26 @@
+// host stand-in for freertos/FreeRTOS.h: 1 tick = 1 ms; critical sections share one process-wide lock
+#pragma once
+#include <assert.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_heap_caps.h"   // as portmacro.h does on the device
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef int portMUX_TYPE;
+
+#define pdTRUE  1
+#define pdFALSE 0
+#define pdPASS  pdTRUE
+#define pdFAIL  pdFALSE
+#define portMAX_DELAY         ((TickType_t)0xffffffffu)
+#define portTICK_PERIOD_MS    1
+#define pdMS_TO_TICKS(ms)     ((TickType_t)(ms))
+#define portMUX_INITIALIZER_UNLOCKED 0
+#define configASSERT(x)       do { if (!(x)) __builtin_trap(); } while (0)
+
+void host_critical_enter(void);
+void host_critical_exit(void);
+#define portENTER_CRITICAL(mux) do { (void)(mux); host_critical_enter(); } while (0)
+#define portEXIT_CRITICAL(mux)  do { (void)(mux); host_critical_exit(); } while (0)
@@ -0,0 +1,7 @@
+// host stand-in for mbedtls/base64.h (implemented in host_port.c)
+#pragma once
+#include <stddef.h>
+
+#define MBEDTLS_ERR_BASE64_BUFFER_TOO_SMALL -0x002A
+
+int mbedtls_base64_encode(unsigned char *dst, size_t dlen, size_t *olen, const unsigned char *src, size_t slen);
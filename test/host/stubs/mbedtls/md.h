@@ -0,0 +1,2 @@
+// host stand-in for mbedtls/md.h (included by cloud_llm.c, nothing in it is called)
+#pragma once
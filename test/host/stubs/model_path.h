@@ -0,0 +1,11 @@
+// host stand-in for esp-sr's model_path.h: one fake model of each kind (see esp_sr_host.c)
+#pragma once
+
+typedef struct {
+    char **model_name;
+    char **model_info;
+    int num;
+} srmodel_list_t;
+
+srmodel_list_t *esp_srmodel_init(const char *partition_label);
+char *esp_srmodel_filter(srmodel_list_t *models, const char *keyword1, const char *keyword2);
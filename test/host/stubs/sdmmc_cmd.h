@@ -0,0 +1,2 @@
+// host stand-in for sdmmc_cmd.h: included by esp32_s3_szp.h, nothing in it is used on the host
+#pragma once
@@ -0,0 +1,42 @@
+// test_feed_deinterleave.c - the packed feed_deinterleave against the per-sample reference loop
+#include "feed_deinterleave.h"
+#include "host_port.h"
+#include <stdint.h>
+#include <string.h>
+
+#define MAX_FRAMES 67
+#define GUARD 8 // samples after the buffer that must stay untouched
+
+static void check_frames(int frames, int offset)
+{
+    // offset in samples: 1 puts the buffer on a 2-byte (not 4-byte) boundary
+    static int16_t want_mem[4 * MAX_FRAMES + GUARD + 2] __attribute__((aligned(4)));
+    static int16_t got_mem[4 * MAX_FRAMES + GUARD + 2] __attribute__((aligned(4)));
+    int16_t *want = want_mem + offset, *got = got_mem + offset;
+    int n = 4 * frames + GUARD;
+    for (int i = 0; i < n; i++) want[i] = got[i] = (int16_t)(0x8000 + i * 2654435761u % 65536); // high bits set too
+
+    feed_deinterleave_scalar(want, 0, frames);
+    feed_deinterleave(got, frames);
+    if (memcmp(want, got, n * sizeof(int16_t)) != 0) {
+        fprintf(stderr, "frames=%d offset=%d differs from the reference\n", frames, offset);
+        exit(1);
+    }
+    // the layout itself: frame i of [ref, mic1, mic2, mic3] becomes [mic1, mic3, ref]
+    for (int i = 0; i < n; i++) want_mem[offset + i] = (int16_t)(0x8000 + i * 2654435761u % 65536);
+    for (int i = 0; i < frames; i++) {
+        CHECK(got[3 * i + 0] == want[4 * i + 1]);
+        CHECK(got[3 * i + 1] == want[4 * i + 3]);
+        CHECK(got[3 * i + 2] == want[4 * i + 0]);
+    }
+}
+
+int main(void)
+{
+    for (int frames = 0; frames <= MAX_FRAMES; frames++) {
+        check_frames(frames, 0);
+        check_frames(frames, 1);
+    }
+    printf("test_feed_deinterleave: ok\n");
+    return 0;
+}
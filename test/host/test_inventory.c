@@ -0,0 +1,289 @@
+// test_inventory.c - the inventory store on flash: mutation-log replay, the inventory.bin round trip,
+// torn or corrupt files, and running out of memory while loading.
+// inventory.c is included so the tests can "reboot" (drop the in-memory store and load it again)
+#include "inventory.c"
+#include "host_port.h"
+#include <unistd.h>
+
+// ---- allocation failure injection (the Makefile links with --wrap=malloc,calloc,realloc) -------
+
+void *__real_malloc(size_t n);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *p, size_t n);
+
+static int s_fail_in; // the s_fail_in-th allocation from now fails (once); 0 = off
+
+static bool alloc_fails(void)
+{
+    return s_fail_in > 0 && --s_fail_in == 0;
+}
+
+void *__wrap_malloc(size_t n) { return alloc_fails() ? NULL : __real_malloc(n); }
+void *__wrap_calloc(size_t n, size_t size) { return alloc_fails() ? NULL : __real_calloc(n, size); }
+void *__wrap_realloc(void *p, size_t n) { return alloc_fails() ? NULL : __real_realloc(p, n); }
+
+// inventory.c queues sync events; there is no sync queue behind these tests
+int sync_enqueue_batch(const char *const *event_types, const char *const *payloads_json, int count)
+{
+    (void)event_types; (void)payloads_json; (void)count;
+    return 0;
+}
+
+// ---- helpers ----------------------------------------------------------------
+
+// power cycle: forget everything in memory and load from flash, as inventory_init does at boot
+static void reboot(void)
+{
+    store_clear();
+    txn_log_reset();
+    s_log_records = 0;
+    s_load_incomplete = false;
+    inventory_load();
+}
+
+static void fresh(void)
+{
+    host_spiffs_reset();
+    reboot();
+}
+
+static void add(const char *id, const char *name, const char *category, int qty)
+{
+    inventory_item_t it = {
+        .name = name,
+        .category = category,
+        .unit = "盒",
+        .location = "中层左",
+        .notes = "note \"quoted\"\n",
+        .quantity = qty,
+        .added_time = 1700000000,
+    };
+    snprintf(it.item_id, sizeof(it.item_id), "%s", id);
+    CHECK(inventory_add_item(&it) == 0);
+}
+
+// every stored field of every item, in store order
+static char *dump(void)
+{
+    size_t cap = 256 + (size_t)s_live_count * 512, len = 0;
+    char *s = malloc(cap);
+    CHECK(s);
+    s[0] = '\0';
+    for (int i = 0; i < s_live_count; ++i) {
+        const inventory_item_t *it = &s_live[i]->item;
+        len += (size_t)snprintf(s + len, cap - len, "%s|%s|%s|%s|%s|%s|%s|q%d|d%d|n%d|a%lld|e%lld|v%u|u%lld\n",
+                                it->item_id, it->name, it->category, it->unit, it->location, it->notes, it->photo_url,
+                                it->quantity, it->default_shelf_life_days, it->last_notified_remaining_days,
+                                (long long)it->added_time, (long long)it->calculated_expiry_date,
+                                (unsigned)it->version, (long long)it->updated_time);
+    }
+    return s;
+}
+
+static const inventory_item_t *get(const char *id)
+{
+    return find_by_id(id);
+}
+
+static char *read_all(const char *path, long *len)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    fseek(f, 0, SEEK_END);
+    *len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *b = malloc((size_t)*len + 1);
+    CHECK(b && fread(b, 1, (size_t)*len, f) == (size_t)*len);
+    fclose(f);
+    return b;
+}
+
+static void write_all(const char *path, const char *b, long len)
+{
+    FILE *f = fopen(path, "wb");
+    CHECK(f && fwrite(b, 1, (size_t)len, f) == (size_t)len);
+    fclose(f);
+}
+
+static bool exists(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (f) fclose(f);
+    return f != NULL;
+}
+
+// a little of everything the log records: add, update (quantity, notification), remote merge, delete
+static void mutate(void)
+{
+    add("A", "牛奶", "牛奶", 2);
+    add("B", "鸡蛋", "蔬果", 6);
+    add("C", "五花肉", "肉类", 1);
+    CHECK(inventory_remove_item("鸡蛋", 2) == 0);
+    inventory_mark_notified(get("A"), 3);
+    inventory_item_t remote = { .name = "五花肉", .category = "肉类", .quantity = 4, .version = 7,
+                                .updated_time = 1700001234, .added_time = 1700000000 };
+    strcpy(remote.item_id, "C");
+    CHECK(inventory_apply_remote(&remote, false) == 1);
+    add("D", "豆腐", "熟食", 1);
+    CHECK(inventory_remove_item("豆腐", 1) == 0);
+}
+
+// ---- tests ------------------------------------------------------------------
+
+static void test_log_replay(void)
+{
+    fresh();
+    mutate();
+    CHECK(!exists(INV_BIN_PATH) && exists(INV_LOG_PATH)); // everything so far lives in the log only
+    char *before = dump();
+    reboot();
+    char *after = dump();
+    CHECK(strcmp(before, after) == 0);
+    CHECK(s_live_count == 3 && !get("D"));
+    CHECK(get("B")->quantity == 4 && get("A")->last_notified_remaining_days == 3);
+    CHECK(get("C")->version == 7 && get("C")->updated_time == 1700001234 && get("C")->quantity == 4);
+    free(before);
+    free(after);
+}
+
+static void test_snapshot_round_trip(void)
+{
+    fresh();
+    mutate();
+    char *before = dump();
+    inventory_save();
+    CHECK(exists(INV_BIN_PATH) && !exists(INV_LOG_PATH));
+    reboot();
+    char *after = dump();
+    CHECK(strcmp(before, after) == 0); // including version and updated_time from the record extension
+    CHECK(get("C")->version == 7 && get("C")->updated_time == 1700001234);
+
+    // snapshot + log on top of it
+    add("E", "酸奶", "牛奶", 3);
+    free(before);
+    before = dump();
+    reboot();
+    free(after);
+    after = dump();
+    CHECK(strcmp(before, after) == 0);
+    free(before);
+    free(after);
+}
+
+static void test_torn_log_tail(void)
+{
+    fresh();
+    add("A", "牛奶", "牛奶", 2);
+    inventory_save();
+    add("B", "鸡蛋", "蔬果", 6);
+    add("C", "五花肉", "肉类", 1);
+    // power cut in the middle of appending the last record
+    long len;
+    char *log = read_all(INV_LOG_PATH, &len);
+    CHECK(log && len > 10 && log[len - 1] == '\n');
+    write_all(INV_LOG_PATH, log, len - 10);
+    free(log);
+
+    reboot();
+    CHECK(get("A") && get("B") && !get("C"));
+    // the next append must start on a line of its own, not behind the torn record
+    add("D", "豆腐", "熟食", 1);
+    reboot();
+    CHECK(get("A") && get("B") && get("D") && s_live_count == 3);
+}
+
+static void test_damaged_snapshot(void)
+{
+    fresh();
+    for (int i = 0; i < 5; ++i) {
+        char id[16], name[16];
+        snprintf(id, sizeof(id), "i%d", i);
+        snprintf(name, sizeof(name), "item%d", i);
+        add(id, name, "蔬果", i + 1);
+    }
+    inventory_save();
+    long len;
+    char *good = read_all(INV_BIN_PATH, &len);
+    CHECK(good);
+
+    // one flipped byte inside a record: only that record is dropped
+    const inv_bin_header_t *hdr = (const inv_bin_header_t *)good;
+    char *bad = malloc((size_t)len);
+    memcpy(bad, good, (size_t)len);
+    bad[sizeof(inv_bin_header_t) + hdr->record_size * 2 + 4] ^= 0x5a;
+    write_all(INV_BIN_PATH, bad, len);
+    reboot();
+    CHECK(s_live_count == 4);
+
+    // cut short (the string table is gone): not usable, the write-then-rename tmp copy is used instead
+    write_all(INV_BIN_PATH, good, len / 2);
+    write_all(INV_BIN_TMP_PATH, good, len);
+    reboot();
+    CHECK(s_live_count == 5);
+
+    // and with no other copy the store starts empty rather than half-loaded
+    write_all(INV_BIN_PATH, good, len / 2);
+    remove(INV_BIN_TMP_PATH);
+    reboot();
+    CHECK(s_live_count == 0);
+    free(bad);
+    free(good);
+}
+
+static void test_out_of_memory_keeps_snapshot(void)
+{
+    fresh();
+    for (int i = 0; i < 40; ++i) {
+        char id[16], name[16];
+        snprintf(id, sizeof(id), "m%d", i);
+        snprintf(name, sizeof(name), "item%d", i);
+        add(id, name, i % 2 ? "肉类" : "蔬果", 1);
+    }
+    inventory_save();
+    long len;
+    char *good = read_all(INV_BIN_PATH, &len);
+    CHECK(good);
+
+    // fail each allocation of the load in turn
+    int incomplete = 0;
+    for (int k = 1; k < 200; ++k) {
+        write_all(INV_BIN_PATH, good, len);
+        remove(INV_LOG_PATH);
+        s_fail_in = k;
+        reboot();
+        bool hit = s_fail_in == 0;
+        s_fail_in = 0;
+        if (!hit) break; // the whole load needed fewer than k allocations
+        if (!s_load_incomplete) {
+            CHECK(s_live_count == 40);
+            continue;
+        }
+        incomplete++;
+        CHECK(s_live_count < 40);
+        // changes still reach the log, and nothing replaces the good snapshot
+        add("new", "新条目", "蔬果", 1);
+        inventory_save();
+        long n;
+        char *now = read_all(INV_BIN_PATH, &n);
+        CHECK(now && n == len && memcmp(now, good, (size_t)len) == 0);
+        free(now);
+        CHECK(exists(INV_LOG_PATH));
+        // with memory back, the next boot has everything
+        reboot();
+        CHECK(!s_load_incomplete && s_live_count == 41 && get("new"));
+    }
+    CHECK(incomplete > 0);
+    free(good);
+}
+
+int main(void)
+{
+    inventory_init();
+    test_log_replay();
+    test_snapshot_round_trip();
+    test_torn_log_tail();
+    test_damaged_snapshot();
+    test_out_of_memory_keeps_snapshot();
+    printf("test_inventory: ok\n");
+    return 0;
+}
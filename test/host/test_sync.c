@@ -0,0 +1,358 @@
+// test_sync.c - sync queue uploads against mock_server.c (the Makefile points SYNC_API_URL at it).
+// sync.c is included so the tests can drive its static upload step the way sync_task does
+#include "sync.c"
+#include "host_port.h"
+#include "mock_server.h"
+
+#define MAX_EVENTS 128
+
+typedef struct {
+    int requests;
+    int fail_first;             // answer 503 to this many requests
+    int partial_ack;            // acknowledge only this many events of the next larger batch (0 = off)
+    int max_batch;
+    char accepted[MAX_EVENTS][32]; // item_ids the server acknowledged, in order
+    int n_accepted;
+    int fail_page;              // answer 500 to GET /changes for this page (1-based, 0 = off)
+    char pulls[8][128];         // paths of the GET /changes requests, in order
+    int n_pulls;
+    char order[64];             // 'P' per upload, 'G' per pull request
+    int max_limit;              // pages requested with a larger limit= come back over SYNC_PULL_MAX_BYTES (0 = off)
+} server_t;
+
+static server_t s_srv;
+
+// item_ids of the events in a JSON array body, in order
+static int body_ids(const char *body, char ids[][32], int max)
+{
+    int n = 0;
+    for (const char *p = strstr(body, "\"item_id\":\""); p && n < max; p = strstr(p, "\"item_id\":\"")) {
+        p += 11;
+        size_t len = strcspn(p, "\"");
+        if (len >= 32) len = 31;
+        memcpy(ids[n], p, len);
+        ids[n++][len] = '\0';
+    }
+    return n;
+}
+
+// two pages of remote changes; the second one is reached through the cursor of the first
+static int on_changes(server_t *s, const char *path, char *resp, size_t size)
+{
+    if (strncmp(path, SYNC_PULL_PATH "?", strlen(SYNC_PULL_PATH) + 1) != 0) return 404;
+    if (s->n_pulls < 8) snprintf(s->pulls[s->n_pulls++], sizeof(s->pulls[0]), "%s", path);
+    bool second = strstr(path, "since=c%2F1&") != NULL;
+    if (s->fail_page == (second ? 2 : 1)) return 500;
+    const char *limit = strstr(path, "limit=");
+    if (s->max_limit && limit && atoi(limit + 6) > s->max_limit) {
+        // one oversized change (e.g. long notes); the body no longer fits the device's page buffer
+        int n = snprintf(resp, size, "{\"cursor\":\"x\",\"more\":false,\"changes\":[{\"notes\":\"");
+        memset(resp + n, 'x', SYNC_PULL_MAX_BYTES);
+        strcpy(resp + n + SYNC_PULL_MAX_BYTES, "\"}]}");
+        return 200;
+    }
+    if (!second) {
+        snprintf(resp, size, "{\"cursor\":\"c/1\",\"more\":true,\"changes\":["
+                 "{\"item_id\":\"A\",\"version\":1,\"updated_time\":100,\"name\":\"milk\",\"quantity\":2},"
+                 "{\"item_id\":\"B\",\"version\":1,\"updated_time\":100,\"name\":\"eggs\",\"quantity\":6},"
+                 "{\"item_id\":\"C\",\"version\":1,\"updated_time\":100,\"name\":\"pork\",\"quantity\":1}]}");
+    } else {
+        snprintf(resp, size, "{\"cursor\":\"c2\",\"more\":false,\"changes\":["
+                 "{\"item_id\":\"B\",\"version\":2,\"updated_time\":200,\"deleted\":true},"
+                 "{\"item_id\":\"C\",\"version\":5,\"updated_time\":300,\"name\":\"pork\",\"quantity\":9}]}");
+    }
+    return 200;
+}
+
+static int on_request(const mock_request_t *req, char *resp, size_t size, void *ctx)
+{
+    server_t *s = ctx;
+    s->requests++;
+    size_t o = strlen(s->order);
+    if (o + 1 < sizeof(s->order)) s->order[o] = req->method[0];
+    if (strcmp(req->method, "GET") == 0) return on_changes(s, req->path, resp, size);
+    if (strcmp(req->method, "POST") != 0) return 404;
+    if (s->requests <= s->fail_first) {
+        snprintf(resp, size, "{\"error\":\"unavailable\"}");
+        return 503;
+    }
+    char ids[SYNC_BATCH_MAX_EVENTS][32];
+    int n = body_ids(req->body, ids, SYNC_BATCH_MAX_EVENTS);
+    if (n > s->max_batch) s->max_batch = n;
+    int acked = n;
+    if (s->partial_ack && n > s->partial_ack) {
+        acked = s->partial_ack;
+        s->partial_ack = 0;
+    }
+    for (int i = 0; i < acked && s->n_accepted < MAX_EVENTS; ++i) strcpy(s->accepted[s->n_accepted++], ids[i]);
+    snprintf(resp, size, "{\"acked\":%d}", acked);
+    return 200;
+}
+
+// fresh flash and a fresh queue, as after first boot
+static void reset(void)
+{
+    host_spiffs_reset();
+    memset(&s_srv, 0, sizeof(s_srv));
+    s_q.ready = false;
+    ring_clear();
+    s_batch_limit = SYNC_BATCH_MIN_EVENTS;
+    s_pull_limit = SYNC_PULL_PAGE;
+}
+
+static void enqueue(const char *type, const char *id)
+{
+    char payload[96];
+    snprintf(payload, sizeof(payload), "{\"item_id\":\"%s\",\"name\":\"n-%s\",\"quantity\":1}", id, id);
+    CHECK(sync_enqueue_event(type, payload) == 0);
+}
+
+// upload until the queue is empty, the way sync_task does between backoffs; returns the failed rounds
+static int drain(void)
+{
+    int failures = 0;
+    for (int round = 0; round < 200; ++round) {
+        int rc = sync_upload_batch();
+        if (rc == 0) return failures;
+        if (rc < 0) failures++;
+    }
+    CHECK(!"queue did not drain");
+    return failures;
+}
+
+static void test_drain_in_batches(void)
+{
+    reset();
+    s_srv.fail_first = 2;
+    s_srv.partial_ack = 3;
+    char id[16];
+    for (int i = 0; i < 40; ++i) {
+        snprintf(id, sizeof(id), "id%02d", i);
+        enqueue("add_item", id);
+    }
+    CHECK(drain() == 2);
+    CHECK(s_srv.n_accepted == 40);
+    for (int i = 0; i < 40; ++i) {
+        snprintf(id, sizeof(id), "id%02d", i);
+        CHECK(strcmp(s_srv.accepted[i], id) == 0);
+    }
+    CHECK(s_srv.max_batch > SYNC_BATCH_MIN_EVENTS);
+    CHECK(s_srv.max_batch <= SYNC_BATCH_MAX_EVENTS);
+    CHECK(sync_upload_batch() == 0);
+    CHECK(host_spiffs_count(SYNC_SEG_PREFIX) == 0);
+}
+
+static void test_queue_survives_restart(void)
+{
+    reset();
+    s_srv.fail_first = 1000;
+    char id[16];
+    for (int i = 0; i < 5; ++i) {
+        snprintf(id, sizeof(id), "r%d", i);
+        enqueue("add_item", id);
+    }
+    CHECK(sync_upload_batch() < 0);
+    CHECK(s_srv.n_accepted == 0);
+
+    // power cycle: the in-memory ring is gone, the queue is reopened from flash
+    s_q.ready = false;
+    ring_clear();
+    s_srv.fail_first = 0;
+    CHECK(drain() == 0);
+    CHECK(s_srv.n_accepted == 5);
+    for (int i = 0; i < 5; ++i) {
+        snprintf(id, sizeof(id), "r%d", i);
+        CHECK(strcmp(s_srv.accepted[i], id) == 0);
+    }
+}
+
+// events folded away after the last sent one are acknowledged with it, not resent on their own
+static void test_fold_acks_trailing_events(void)
+{
+    reset();
+    s_batch_limit = SYNC_BATCH_MAX_EVENTS;
+    enqueue("add_item", "X");
+    enqueue("remove_item", "X");
+    enqueue("notified", "X"); // moot after the remove: folded away at the end of the batch
+    CHECK(sync_upload_batch() == 1);
+    CHECK(sync_upload_batch() == 0);
+    CHECK(s_srv.requests == 1);
+    CHECK(s_srv.n_accepted == 1 && strcmp(s_srv.accepted[0], "X") == 0);
+    CHECK(host_spiffs_count(SYNC_SEG_PREFIX) == 0);
+
+    // in the middle of a partially acknowledged batch
+    reset();
+    s_batch_limit = SYNC_BATCH_MAX_EVENTS;
+    s_srv.partial_ack = 1;
+    enqueue("add_item", "X");
+    enqueue("remove_item", "X");
+    enqueue("notified", "X");
+    enqueue("add_item", "Y");
+    CHECK(sync_upload_batch() == 1); // [remove X, add Y], acked through the notified
+    CHECK(sync_upload_batch() == 1); // [add Y]
+    CHECK(sync_upload_batch() == 0);
+    CHECK(s_srv.requests == 2);
+    CHECK(s_srv.n_accepted == 2);
+    CHECK(strcmp(s_srv.accepted[0], "X") == 0 && strcmp(s_srv.accepted[1], "Y") == 0);
+}
+
+static int s_changes;
+
+static void on_change(void)
+{
+    s_changes++;
+}
+
+static bool find_qty(const inventory_item_t *it, void *ctx)
+{
+    int *q = ctx;
+    if (strcmp(it->item_id, "C") == 0) *q = it->quantity;
+    return true;
+}
+
+static void test_pull_pages_apply_atomically(void)
+{
+    inventory_clear_all();
+    reset(); // drops the sync events of the clear
+    s_cursor[0] = '\0';
+    s_cursor_loaded = false;
+    s_changes = 0;
+
+    // the second page fails: the first one is applied and its cursor kept
+    s_srv.fail_page = 2;
+    CHECK(sync_pull() < 0);
+    CHECK(s_changes == 1); // three changes, one transaction
+    CHECK(inventory_count() == 3);
+    char *cursor = storage_read_file(PULL_CURSOR_PATH);
+    CHECK(cursor && strcmp(cursor, "c/1") == 0);
+    free(cursor);
+
+    // the retry resumes from the saved cursor
+    s_srv.fail_page = 0;
+    s_cursor_loaded = false;
+    s_changes = 0;
+    CHECK(sync_pull() == 2);
+    CHECK(s_changes == 1);
+    CHECK(inventory_count() == 2);
+    int qty = 0;
+    inventory_foreach_by_expiry(0, find_qty, &qty);
+    CHECK(qty == 9);
+    CHECK(s_srv.n_pulls == 3);
+    CHECK(strstr(s_srv.pulls[0], "since=&limit=") != NULL);
+    CHECK(strstr(s_srv.pulls[2], "since=c%2F1&limit=") != NULL);
+    cursor = storage_read_file(PULL_CURSOR_PATH);
+    CHECK(cursor && strcmp(cursor, "c2") == 0);
+    free(cursor);
+}
+
+static void test_pull_shrinks_oversized_pages(void)
+{
+    inventory_clear_all();
+    reset();
+    s_cursor[0] = '\0';
+    s_cursor_loaded = false;
+
+    // pages requested with more than 10 changes do not fit: the limit is halved until they do
+    s_srv.max_limit = 10;
+    CHECK(sync_pull() > 0);
+    CHECK(inventory_count() == 2);
+    char *cursor = storage_read_file(PULL_CURSOR_PATH);
+    CHECK(cursor && strcmp(cursor, "c2") == 0);
+    free(cursor);
+    CHECK(strstr(s_srv.pulls[0], "limit=50") && strstr(s_srv.pulls[1], "limit=25") &&
+          strstr(s_srv.pulls[2], "limit=12") && strstr(s_srv.pulls[3], "limit=6"));
+    CHECK(s_pull_limit <= 2 * 10);
+}
+
+static void test_failed_pull_does_not_block_uploads(void)
+{
+    inventory_clear_all();
+    reset();
+    s_cursor[0] = '\0';
+    s_cursor_loaded = false;
+
+    // the pull fails; the round still uploads and only the pull is reported as failed
+    s_srv.fail_page = 1;
+    enqueue("add_item", "u1");
+    bool pull_failed = false;
+    CHECK(sync_round(true, &pull_failed) == 0);
+    CHECK(pull_failed);
+    CHECK(s_srv.n_accepted == 1);
+
+    // a page too large even at limit=1 fails the pull the same way, without retrying forever
+    s_srv.fail_page = 0;
+    s_srv.max_limit = -1; // every limit is too large
+    s_srv.n_pulls = 0;
+    enqueue("add_item", "u2");
+    CHECK(sync_round(true, &pull_failed) == 0);
+    CHECK(pull_failed);
+    CHECK(s_srv.n_accepted == 2);
+    CHECK(s_pull_limit == 1);
+    CHECK(s_srv.n_pulls == 6); // limit=50, 25, 12, 6, 3, 1, then give up
+    CHECK(sync_upload_batch() == 0);
+}
+
+static void test_round_uploads_before_pulling(void)
+{
+    inventory_clear_all();
+    reset(); // drops the sync events of the clear
+    s_cursor[0] = '\0';
+    s_cursor_loaded = false;
+
+    // server down: the round fails and does not pull over unsent local changes
+    s_srv.fail_first = 1000;
+    enqueue("add_item", "x1");
+    enqueue("add_item", "x2");
+    bool pull_failed = false;
+    CHECK(sync_round(true, &pull_failed) < 0);
+    CHECK(!pull_failed);
+    CHECK(strchr(s_srv.order, 'G') == NULL);
+
+    // back up: the queue drains first, then both pages are pulled
+    s_srv.fail_first = 0;
+    memset(s_srv.order, 0, sizeof(s_srv.order));
+    CHECK(sync_round(true, &pull_failed) == 0);
+    CHECK(!pull_failed);
+    CHECK(s_srv.n_accepted == 2);
+    CHECK(strncmp(s_srv.order, "P", 1) == 0);
+    CHECK(strcmp(strchr(s_srv.order, 'G'), "GG") == 0);
+    CHECK(sync_upload_batch() == 0);
+
+    // no pull due: uploads only
+    memset(s_srv.order, 0, sizeof(s_srv.order));
+    enqueue("add_item", "x3");
+    CHECK(sync_round(false, &pull_failed) == 0);
+    CHECK(strcmp(s_srv.order, "P") == 0);
+}
+
+static void test_backoff_bounds(void)
+{
+    uint32_t b = 0;
+    for (int i = 0; i < 20; ++i) {
+        b = backoff_next(b);
+        CHECK(b >= SYNC_BACKOFF_MIN_MS && b <= SYNC_BACKOFF_MAX_MS);
+        for (int k = 0; k < 50; ++k) {
+            uint32_t w = backoff_jitter(b);
+            CHECK(w >= b / 2 && w <= b);
+        }
+    }
+    CHECK(b == SYNC_BACKOFF_MAX_MS);
+}
+
+int main(void)
+{
+    inventory_init();
+    inventory_set_change_cb(on_change);
+    CHECK(mock_server_start(MOCK_PORT, on_request, &s_srv) == 0);
+    test_drain_in_batches();
+    test_queue_survives_restart();
+    test_fold_acks_trailing_events();
+    test_pull_pages_apply_atomically();
+    test_pull_shrinks_oversized_pages();
+    test_failed_pull_does_not_block_uploads();
+    test_round_uploads_before_pulling();
+    test_backoff_bounds();
+    mock_server_stop();
+    printf("test_sync: ok\n");
+    return 0;
+}